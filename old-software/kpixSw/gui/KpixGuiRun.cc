@@ -273,6 +273,7 @@ void KpixGuiRun::run() {
    struct timeval     curTime, prvTime, acqTime;
    KpixHistogram      **histR0;
    KpixHistogram      **histR1;
+   KpixHistogramPool  *histPool;
    TH1F               *plot[32];
    TH1F               *cHist;
    KpixCalibRead      *calData;
@@ -348,6 +349,9 @@ void KpixGuiRun::run() {
       histR0 = (KpixHistogram **) malloc(sizeof(KpixHistogram *) * (asicCnt-1) * 4096);
       histR1 = (KpixHistogram **) malloc(sizeof(KpixHistogram *) * (asicCnt-1) * 4096);
       if ( histR0 == NULL || histR1 == NULL ) throw(string("KpixGuiRun::run -> Malloc Error"));
+
+      // Preallocated bins for the first histograms filled, the rest grow dynamically
+      histPool = new KpixHistogramPool(KPIX_GUI_RUN_POOL);
       for (x=0; x< (asicCnt-1); x++) {
          for (y=0; y< 4096; y++) {
             histR0[x*4096+y] = NULL;
@@ -356,8 +360,9 @@ void KpixGuiRun::run() {
       }
    }
    else {
-      histR0 = NULL;
-      histR1 = NULL;
+      histR0   = NULL;
+      histR1   = NULL;
+      histPool = NULL;
    }
 
    try {
@@ -645,10 +650,16 @@ void KpixGuiRun::run() {
 
                      // Fill full run histogram
                      if ( range == 0 ) {
-                        if ( histR0[idx] == NULL ) histR0[idx] = new KpixHistogram();
+                        if ( histR0[idx] == NULL ) {
+                           histR0[idx] = new KpixHistogram();
+                           histR0[idx]->setPool(histPool);
+                        }
                         histR0[idx]->fill(sample->getSampleValue());
                      } else {
-                        if ( histR1[idx] == NULL ) histR1[idx] = new KpixHistogram();
+                        if ( histR1[idx] == NULL ) {
+                           histR1[idx] = new KpixHistogram();
+                           histR1[idx]->setPool(histPool);
+                        }
                         histR1[idx]->fill(sample->getSampleValue());
                      }
                   }
@@ -916,6 +927,7 @@ void KpixGuiRun::run() {
          }
          free(histR0);
          free(histR1);
+         delete histPool;
 
          // Set Directory
          kpixRunWrite->setDir("/");
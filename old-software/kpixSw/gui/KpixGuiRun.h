@@ -22,6 +22,9 @@
 #include "KpixGuiRunForm.h"
 #include <qthread.h>
 
+// Number of run histograms with preallocated bins, 64MB
+#define KPIX_GUI_RUN_POOL 2048
+
 // Forward Declarations
 class KpixAsic;
 class KpixFpga;
@@ -69,6 +69,7 @@
 #include <iomanip>
 #include <sstream>
 #include <string>
+#include <vector>
 #include <unistd.h>
 #include <stdlib.h>
 #include <math.h>
@@ -122,7 +123,8 @@ void KpixAsic::sendCommand ( unsigned char command, bool bcast ) {
 
 
 // Private method to write register value to Kpix
-void KpixAsic::regWrite ( unsigned char address ) {
+// Pass register address and broadcast flag
+void KpixAsic::regWrite ( unsigned char address, bool bcast ) {
 
 #ifdef ONLINE_EN
    unsigned short frameData[4];
@@ -140,7 +142,7 @@ void KpixAsic::regWrite ( unsigned char address ) {
       if ( enDebug ) cout << "KpixAsic::regWrite -> Kpix Address=0x" << setw(4) << setfill('0') 
            << hex << kpixAddress << ", Write '" << regGetName(address) << "' (0x"
          << hex << setw(2) << setfill('0') << (int)address << ") Data=0x" 
-         << setw(8) << setfill('0') << hex << (int)regData[address] << "\n";
+         << setw(8) << setfill('0') << hex << (int)regData[address] << ", Bcast=" << bcast << "\n";
 
       // Format command, word 0
       frameData[0]  = (address & 0x007F);
@@ -149,6 +151,8 @@ void KpixAsic::regWrite ( unsigned char address ) {
       frameData[0] |= ((kpixAddress << 9)  & 0x0600); // Assign lower 2-bits of kpixAddress
       frameData[0] |= ((kpixAddress << 10) & 0xF000); // Assign upper 4-bits of kpixAddress
 
+      if ( bcast ) frameData[0] |= 0x0800;
+
       // word 1 & 2
       frameData[1] = (regData[address] & 0xFFFF);
       frameData[2] = ((regData[address] >> 16) & 0xFFFF);
@@ -164,6 +168,32 @@ void KpixAsic::regWrite ( unsigned char address ) {
 }
 
 
+// Private method to write register value to a set of Kpix devices
+// Uses a single broadcast write when all devices share the link, width and value
+void KpixAsic::regWriteAll ( KpixAsic **asic, unsigned int count, unsigned char address ) {
+
+   unsigned int x;
+   bool         bcast;
+
+   // Check for valid address
+   if ( address >= 0x80 ) throw string("KpixAsic::regWriteAll -> Address out of range");
+
+   // Compare against first device
+   bcast = ( count > 1 );
+   for (x=0; x < count && bcast; x++) {
+      if ( asic[x]->sidLink != asic[0]->sidLink || ! asic[x]->regWriteable[address] ||
+           asic[x]->regWidth[address] != asic[0]->regWidth[address] ||
+           asic[x]->regData[address]  != asic[0]->regData[address] ) bcast = false;
+   }
+
+   // Write once or to each device
+   if ( bcast ) asic[0]->regWrite(address,true);
+   else for (x=0; x < count; x++) {
+      if ( asic[x]->regWriteable[address] ) asic[x]->regWrite(address,false);
+   }
+}
+
+
 // Private method to read register value from Kpix
 void KpixAsic::regRead ( unsigned char address ) {
 
@@ -2973,6 +3003,44 @@ void KpixAsic::setDefaults ( unsigned int clkPeriod, bool writeEn ) {
 }
 
 
+// Write configuration to a set of KPIX devices
+// Pass device list, device count and verify flag
+void KpixAsic::writeConfigAll ( KpixAsic **asic, unsigned int count, bool verifyEn ) {
+
+   unsigned int  x;
+   unsigned int  address;
+   vector<bool>  pwrOn(count,false);
+
+   // Force power on for Kpix 9 during DAC writes
+   for (x=0; x < count; x++) {
+      pwrOn[x] = ( asic[x]->kpixVersion == 9 && ! asic[x]->getCntrlDisPwrCycle(false) );
+      if ( pwrOn[x] ) asic[x]->regData[0x30] |= 0x01000000;
+   }
+   regWriteAll(asic,count,0x30);
+
+   // Write registers, control register last
+   for (address=0; address < 0x80; address++) {
+      if ( address != 0x30 ) regWriteAll(asic,count,address);
+   }
+   for (x=0; x < count; x++) {
+      if ( pwrOn[x] ) asic[x]->regData[0x30] &= 0xFEFFFFFF;
+   }
+   regWriteAll(asic,count,0x30);
+
+   // Verify each device
+   if ( verifyEn ) {
+      for (x=0; x < count; x++) {
+         if ( (asic[x]->clkPeriod & 0x80000000) == 0 ) {
+            for (address=0; address < 0x80; address++) {
+               asic[x]->regVerify(address);
+               asic[x]->regVerify(address);
+            }
+         }
+      }
+   }
+}
+
+
 // Read from all registers will debug enabled to display all of the current settings
 void KpixAsic::dumpSettings () {
 
@@ -114,9 +114,9 @@ class KpixAsic : public TObject {
       void sendCommand ( unsigned char command, bool bcast );
 
       //! Private method to write register value to Kpix
-		/*!
+		/*! Pass optional broadcast flag, default=false
 		*/
-      void regWrite (unsigned char address);
+      void regWrite (unsigned char address, bool bcast = false);
 
       //! Private method to read register value from Kpix
 		/*!
@@ -128,6 +128,12 @@ class KpixAsic : public TObject {
 		*/
       void regVerify (unsigned char address);
 
+      //! Private method to write register value to a set of Kpix devices
+		/*! A single broadcast write is used when all devices share the link,
+		    the register width and the register value.
+		*/
+      static void regWriteAll ( KpixAsic **asic, unsigned int count, unsigned char address );
+
       //! Private method to write timing settings for versions 0-7
 		/*!
 		*/
@@ -995,6 +1001,18 @@ class KpixAsic : public TObject {
       */ 
       void setDefaults ( unsigned int clkPeriod, bool writeEn = true );
 
+      //! Write KPIX configuration to a set of devices
+		/*! Writes all writable registers from the stored settings. Registers
+		holding the same value in every device are written once with a broadcast
+		write, the others are written to each device. Every device is then
+		verified separately unless verifyEn is false. The list must contain every
+		KPIX attached to the link since broadcast writes reach all of them.
+      Eg: 
+		for (x=0; x < kpixCount; x++) kpixAsic[x]->setDefaults(CLOCK_PERIOD,false);
+		KpixAsic::writeConfigAll(kpixAsic,kpixCount);
+      */ 
+      static void writeConfigAll ( KpixAsic **asic, unsigned int count, bool verifyEn = true );
+
       //! Get Channel Count
 		/* Returns the number of channels in the KPIXs
       Eg: 
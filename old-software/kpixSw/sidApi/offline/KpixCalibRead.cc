@@ -24,6 +24,8 @@
 #include <sstream>
 #include <string>
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <TH1F.h>
@@ -46,145 +48,148 @@ ClassImp(KpixCalibRead)
 
 /*****************************************************************************************************************/
 
-// Private function to add ASIC to the KpixCalibReadAsicStruct linked list or return an existing entry
-KpixCalibReadAsicStruct * KpixCalibRead::addAsic ( KpixCalibReadGainStruct *currGain, int kpixID ) {
-
-   // Add asic to the head if list is empty
-   if ( currGain->asicHead == NULL ) {
-      currGain->asicHead = new KpixCalibReadAsicStruct;
-      memset(currGain->asicHead,0,sizeof(KpixCalibReadAsicStruct));
-      currGain->asicHead->kpixID = kpixID;
-      currGain->asicHead->nextAsic = NULL;
-      currGain->asicTail = currGain->asicHead;
-      return (currGain->asicHead);
-   }
-   else {
-      KpixCalibReadAsicStruct *temp;
-      if ( (temp = findAsic (currGain, kpixID)) == NULL ) {
-         KpixCalibReadAsicStruct *newAsic = new KpixCalibReadAsicStruct;
-         memset(newAsic,0,sizeof(KpixCalibReadAsicStruct));
-         newAsic->kpixID = kpixID;
-         newAsic->nextAsic = NULL;
-         currGain->asicTail->nextAsic = newAsic; //Add the new asic to the tail
-         currGain->asicTail = newAsic;
-         return (newAsic);
-      }
-      else { //Asic already exists in the list
-         return (temp);
-      }
-   }
+// Xml value tags
+enum KpixCalibReadVar {
+   VarNone, VarFitGain, VarFitGainErr, VarFitIntercept, VarFitInterceptErr, VarFitRms,
+   VarHistMean, VarHistMeanErr, VarHistSigma, VarHistSigmaErr, VarHistRms
+};
+
+// Flags for values read from root file plots
+#define KPIX_CALIB_LOAD_FIT  0x1
+#define KPIX_CALIB_LOAD_RMS  0x2
+#define KPIX_CALIB_LOAD_HIST 0x4
+
+// Private function to init variables
+void KpixCalibRead::init ( ) {
+   currAsic     = NULL;
+   currDir      = -1;
+   currGain     = 0;
+   currBucket   = 0;
+   currChannel  = 0;
+   currVar      = VarNone;
+   lastDir      = -1;
+   asicHashSize = 64;
+   asicHash     = new KpixCalibReadAsicStruct * [asicHashSize];
+   memset(asicHash,0,asicHashSize*sizeof(KpixCalibReadAsicStruct *));
+   dirList.clear();
+   asicList.clear();
+   xmlDataExists = false;
 }
 
-// Private function to find ASIC in the KpixCalibReadAsicStruct linked list
-KpixCalibReadAsicStruct *KpixCalibRead::findAsic ( KpixCalibReadGainStruct *currGain, int kpixID ) {
-   
-   KpixCalibReadAsicStruct *temp = currGain->asicHead;
+// Private function to compute hash table slot
+unsigned int KpixCalibRead::asicSlot ( int dirID, int gainID, int kpixID ) {
+   unsigned int hash;
 
-   while ( temp != NULL ) {
-      if ( temp->kpixID == kpixID )
-         return temp; // Found the ASIC, return the pointer
-      temp = temp->nextAsic;
-   }
-
-   return (NULL); // Not found, return NULL
+   hash = ((unsigned int)kpixID * 2654435761U) ^ ((unsigned int)gainID * 40503U) ^ ((unsigned int)dirID << 24);
+   hash ^= hash >> 15;
+   return(hash & (asicHashSize-1));
 }
 
-// Private function to add Gain to the KpixCalibReadAsicStruct linked list or return an existing entry
-KpixCalibReadGainStruct *KpixCalibRead::addGain ( KpixCalibReadDir *currDir, int gainID ) {
-
-   // Add gain to the head if list is empty
-   if ( currDir->gainHead == NULL ) {
-      currDir->gainHead = new KpixCalibReadGainStruct;
-      memset(currDir->gainHead,0,sizeof(KpixCalibReadGainStruct));
-      currDir->gainHead->gainID = gainID;
-      currDir->gainHead->nextGain = NULL;
-      currDir->gainHead->asicHead = NULL;
-      currDir->gainHead->asicTail = NULL;
-      currDir->gainTail = currDir->gainHead;
-      return (currDir->gainHead);
+// Private function to add ASIC to the table or return an existing entry
+KpixCalibReadAsicStruct * KpixCalibRead::addAsic ( int dirID, int gainID, int kpixID ) {
+   KpixCalibReadAsicStruct *newAsic;
+   unsigned int            x;
+   unsigned int            slot;
+
+   if ( (newAsic = findAsic ( dirID, gainID, kpixID )) != NULL ) return(newAsic);
+
+   newAsic = new KpixCalibReadAsicStruct;
+   memset(newAsic,0,sizeof(KpixCalibReadAsicStruct));
+   newAsic->dirID  = dirID;
+   newAsic->gainID = gainID;
+   newAsic->kpixID = kpixID;
+   asicList.push_back(newAsic);
+
+   // Grow table to keep it at most half full
+   if ( asicList.size() * 2 > asicHashSize ) {
+      delete[] asicHash;
+      asicHashSize *= 2;
+      asicHash = new KpixCalibReadAsicStruct * [asicHashSize];
+      memset(asicHash,0,asicHashSize*sizeof(KpixCalibReadAsicStruct *));
+
+      for (x=0; x < asicList.size(); x++) {
+         slot = asicSlot(asicList[x]->dirID,asicList[x]->gainID,asicList[x]->kpixID);
+         while ( asicHash[slot] != NULL ) slot = (slot + 1) & (asicHashSize-1);
+         asicHash[slot] = asicList[x];
+      }
    }
    else {
-      KpixCalibReadGainStruct *temp;
-      if( (temp = findGain (currDir, gainID)) == NULL ) {
-         KpixCalibReadGainStruct *newGain = new KpixCalibReadGainStruct;
-         memset(newGain,0,sizeof(KpixCalibReadGainStruct));
-         newGain->gainID = gainID;
-         newGain->nextGain = NULL;
-         newGain->asicHead = NULL;
-         newGain->asicTail = NULL;
-         currDir->gainTail->nextGain = newGain; //Add the new Gain to the tail
-         currDir->gainTail = newGain;
-         return (newGain);
-      }
-      else { //Gain already exists in the list
-         return (temp);
-      }
+      slot = asicSlot(dirID,gainID,kpixID);
+      while ( asicHash[slot] != NULL ) slot = (slot + 1) & (asicHashSize-1);
+      asicHash[slot] = newAsic;
    }
+   return(newAsic);
 }
 
-// Private function to find Gain in the KpixCalibReadGainStruct linked list
-KpixCalibReadGainStruct *KpixCalibRead::findGain ( KpixCalibReadDir *currDir, int gainID ) {
-   
-   KpixCalibReadGainStruct *temp = currDir->gainHead;
+// Private function to find ASIC in the table
+KpixCalibReadAsicStruct *KpixCalibRead::findAsic ( int dirID, int gainID, int kpixID ) {
+   KpixCalibReadAsicStruct *temp;
+   unsigned int            slot;
 
-   while ( temp != NULL ) {
-      if ( temp->gainID == gainID )
-         return temp; // Found the Gain, return the pointer
-      temp = temp->nextGain;
+   slot = asicSlot(dirID,gainID,kpixID);
+   while ( (temp = asicHash[slot]) != NULL ) {
+      if ( temp->kpixID == kpixID && temp->gainID == gainID && temp->dirID == dirID )
+         return temp; // Found the ASIC, return the pointer
+      slot = (slot + 1) & (asicHashSize-1);
    }
-
    return (NULL); // Not found, return NULL
 }
 
-// Private function to add Directory to the KpixCalibReadDir linked list or return an existing entry
-KpixCalibReadDir *KpixCalibRead::addDir ( std::string dirName) {
-
-   // Add Dir to the head if list is empty
-   if ( dirHead == NULL ) {
-      dirHead = new KpixCalibReadDir;
-      dirHead->dirName = dirName;
-      dirHead->nextDir = NULL;
-      dirHead->gainHead = NULL;
-      dirHead->gainTail = NULL;
-      dirTail = dirHead;
-      return (dirHead);
-   }
-   else {
-      KpixCalibReadDir *temp;
-      if( (temp = findDir ( dirName )) == NULL ) {
-         KpixCalibReadDir *newDir = new KpixCalibReadDir;
-         newDir->dirName = dirName;
-         newDir->nextDir = NULL;
-         newDir->gainHead = NULL;
-         newDir->gainTail = NULL;
-         dirTail->nextDir = newDir; //Add the new Dir to the tail
-         dirTail = newDir;
-         return (newDir);
-      }
-      else { //Dir already exists in the list
-         return (temp);
+// Private function to add Directory or return an existing index
+int KpixCalibRead::addDir ( const std::string &dirName ) {
+   int temp;
+
+   if ( (temp = findDir ( dirName )) >= 0 ) return(temp);
+   dirList.push_back(dirName);
+   lastDir = dirList.size()-1;
+   return(lastDir);
+}
+
+// Private function to find Directory index, the last match is checked first
+int KpixCalibRead::findDir ( const std::string &dirName ) {
+   unsigned int x;
+
+   if ( lastDir >= 0 && dirList[lastDir] == dirName ) return(lastDir);
+
+   for (x=0; x < dirList.size(); x++) {
+      if ( dirList[x] == dirName ) {
+         lastDir = x;
+         return(x);
       }
    }
+   return (-1); // Not found
 }
 
-// Private function to find Dir in the KpixCalibReadDir linked list
-KpixCalibReadDir *KpixCalibRead::findDir ( std::string dirName ) {
-   
-   KpixCalibReadDir *temp = dirHead;
+// Private function to find the entry for a lookup. Entries are created when
+// no xml data exists so that values read from root file plots are kept.
+KpixCalibReadAsicStruct *KpixCalibRead::findEntry ( const std::string &dir, int gain, int kpix, int channel, int bucket ) {
+   int dirID;
 
-   while ( temp != NULL ) {
-      if ( temp->dirName.compare( dirName ) == 0 )
-         return temp; // Found the dir, return the pointer
-      temp = temp->nextDir;
-   }
+   if ( channel < 0 || channel > 1023 || bucket < 0 || bucket > 3 ) return(NULL);
 
-   return (NULL); // Not found, return NULL
+   if ( xmlDataExists ) {
+      if ( (dirID = findDir ( dir )) < 0 ) return(NULL);
+      return(findAsic ( dirID, gain, kpix ));
+   }
+   else return(addAsic ( addDir ( dir ), gain, kpix ));
 }
 
 void KpixCalibRead::OnStartElement ( const char *name, const TList *attributes ) {
 
    TXMLAttr *attr;
-   strcpy (currVar, name ); // Store the variable
+
+   // Store the variable
+   if      ( !strcmp(name, "fitGain") )         currVar = VarFitGain;
+   else if ( !strcmp(name, "fitGainErr") )      currVar = VarFitGainErr;
+   else if ( !strcmp(name, "fitIntercept") )    currVar = VarFitIntercept;
+   else if ( !strcmp(name, "fitInterceptErr") ) currVar = VarFitInterceptErr;
+   else if ( !strcmp(name, "fitRms") )          currVar = VarFitRms;
+   else if ( !strcmp(name, "histMean") )        currVar = VarHistMean;
+   else if ( !strcmp(name, "histMeanErr") )     currVar = VarHistMeanErr;
+   else if ( !strcmp(name, "histSigma") )       currVar = VarHistSigma;
+   else if ( !strcmp(name, "histSigmaErr") )    currVar = VarHistSigmaErr;
+   else if ( !strcmp(name, "histRms") )         currVar = VarHistRms;
+   else currVar = VarNone;
    
    TIter next (attributes);
    while ((attr = (TXMLAttr*) next())) {
@@ -192,9 +197,9 @@ void KpixCalibRead::OnStartElement ( const char *name, const TList *attributes )
       if ( !strcmp(name, "type") ) 
          { currDir = addDir ( attr->GetValue () ); } // Handle the directory
       else if ( !strcmp(name, "gain") )
-         { currGain = addGain ( currDir, atoi( attr->GetValue() )); } // Handle the Gain type
-      else if ( !strcmp(name, "asic") ) 
-         { currAsic = addAsic ( currGain, atoi( attr->GetValue() )); } // Handle the asic
+         { currGain = atoi( attr->GetValue() ); } // Handle the Gain type
+      else if ( !strcmp(name, "asic") && currDir >= 0 ) 
+         { currAsic = addAsic ( currDir, currGain, atoi( attr->GetValue() )); } // Handle the asic
       else if ( !strcmp(name, "channel") ) 
          { currChannel = atoi( attr->GetValue () ); } // Store the channel value
       else if ( !strcmp(name, "bucket") ) 
@@ -202,30 +207,32 @@ void KpixCalibRead::OnStartElement ( const char *name, const TList *attributes )
    }
 }
 
-void KpixCalibRead::OnEndElement ( const char *name ) { } // Not using this feature
+// Text following the end of a value is not part of it
+void KpixCalibRead::OnEndElement ( const char *name ) {
+   currVar = VarNone;
+}
 
 void KpixCalibRead::OnCharacters ( const char *characters ) {
+   double value;
+
+   if ( currVar == VarNone || currAsic == NULL ) return;
+   if ( currChannel < 0 || currChannel > 1023 || currBucket < 0 || currBucket > 3 ) return;
+
    if ( strcmp(characters, "\n") ) { // Ignores carriage returns
-      if ( !strcmp(currVar, "fitGain") )
-         { currAsic->fitGain[currChannel][currBucket] = atof( characters ); }
-      else if ( !strcmp(currVar, "fitGainErr") )
-         { currAsic->fitGainErr[currChannel][currBucket] = atof( characters ); }
-      else if ( !strcmp(currVar, "fitIntercept") )
-         { currAsic->fitIntercept[currChannel][currBucket] = atof( characters ); }
-      else if ( !strcmp(currVar, "fitInterceptErr") )
-         { currAsic->fitInterceptErr[currChannel][currBucket] = atof( characters ); }
-      else if ( !strcmp(currVar, "fitRms") )
-         { currAsic->fitRms[currChannel][currBucket] = atof( characters ); }
-      else if ( !strcmp(currVar, "histMean") )
-         { currAsic->histMean[currChannel][currBucket] = atof( characters ); }
-      else if ( !strcmp(currVar, "histMeanErr") )
-         { currAsic->histMeanErr[currChannel][currBucket] = atof( characters ); }
-      else if ( !strcmp(currVar, "histSigma") )
-         { currAsic->histSigma[currChannel][currBucket] = atof( characters ); }
-      else if ( !strcmp(currVar, "histSigmaErr") )
-         { currAsic->histSigmaErr[currChannel][currBucket] = atof( characters ); }
-      else if ( !strcmp(currVar, "histRms") )
-         { currAsic->histRms[currChannel][currBucket] = atof( characters ); }
+      value = atof( characters );
+      switch ( currVar ) {
+         case VarFitGain:         currAsic->fitGain[currChannel][currBucket]         = value; break;
+         case VarFitGainErr:      currAsic->fitGainErr[currChannel][currBucket]      = value; break;
+         case VarFitIntercept:    currAsic->fitIntercept[currChannel][currBucket]    = value; break;
+         case VarFitInterceptErr: currAsic->fitInterceptErr[currChannel][currBucket] = value; break;
+         case VarFitRms:          currAsic->fitRms[currChannel][currBucket]          = value; break;
+         case VarHistMean:        currAsic->histMean[currChannel][currBucket]        = value; break;
+         case VarHistMeanErr:     currAsic->histMeanErr[currChannel][currBucket]     = value; break;
+         case VarHistSigma:       currAsic->histSigma[currChannel][currBucket]       = value; break;
+         case VarHistSigmaErr:    currAsic->histSigmaErr[currChannel][currBucket]    = value; break;
+         case VarHistRms:         currAsic->histRms[currChannel][currBucket]         = value; break;
+         default: break;
+      }
    }
 }
 
@@ -245,19 +252,18 @@ void KpixCalibRead::ParseXml ( ) {
 // Private functin to create plot name
 string KpixCalibRead::genPlotName ( int gain, int kpix, int channel, int bucket, string prefix, int range ) {
 
-   stringstream tempName;
+   char        tempName[64];
+   const char *gainName;
 
    // Generate name
-   tempName.str("");
-   tempName << prefix << "_";
-   if ( gain == 0 ) tempName << "norm_s";
-   if ( gain == 1 ) tempName << "double_s";
-   if ( gain == 2 ) tempName << "low_s";
-   tempName << dec << setw(4) << setfill('0') << kpix << "_c";
-   tempName << dec << setw(4) << setfill('0') << channel << "_b";
-   tempName << dec << setw(1) << bucket;
-   if ( range >= 0 ) tempName << "_r" << dec << setw(1) << range;
-   return(tempName.str());
+   if      ( gain == 0 ) gainName = "norm_s";
+   else if ( gain == 1 ) gainName = "double_s";
+   else if ( gain == 2 ) gainName = "low_s";
+   else gainName = "";
+
+   if ( range >= 0 ) snprintf(tempName,64,"_%s%04d_c%04d_b%d_r%d",gainName,kpix,channel,bucket,range);
+   else snprintf(tempName,64,"_%s%04d_c%04d_b%d",gainName,kpix,channel,bucket);
+   return(prefix + tempName);
 }
 
 
@@ -285,13 +291,7 @@ string KpixCalibRead::genPlotTitle ( int gain, int kpix, int channel, int bucket
 KpixCalibRead::KpixCalibRead ( string calibFile, bool debug ) {
 
    //Assigning default values
-   currAsic = NULL;
-   currGain = NULL;
-   currDir = NULL;
-   currBucket = currChannel = 0;
-   currVar[0] = '\0';
-   dirHead = NULL;
-   dirTail = NULL;
+   init ();
 
    this->kpixRunRead = new KpixRunRead(calibFile, debug);
    ParseXml ();
@@ -302,6 +302,7 @@ KpixCalibRead::KpixCalibRead ( string calibFile, bool debug ) {
 // Calib Data Class Constructor
 // Pass already open run read class
 KpixCalibRead::KpixCalibRead ( KpixRunRead *kpixRunRead ) {
+   init ();
    this->kpixRunRead = kpixRunRead;
    ParseXml ();
    delRunRead = false;
@@ -310,29 +311,13 @@ KpixCalibRead::KpixCalibRead ( KpixRunRead *kpixRunRead ) {
 
 // Deconstructor
 KpixCalibRead::~KpixCalibRead () {
+   unsigned int x;
+
    if ( delRunRead ) delete kpixRunRead;
 
-   if ( dirHead != NULL ) {
-      if ( dirHead->gainHead != NULL ) {
-         if ( dirHead->gainHead->asicHead != NULL ) {
-            while ( dirHead->gainHead->asicHead != NULL ) {
-               dirHead->gainHead->asicTail = dirHead->gainHead->asicHead;
-               dirHead->gainHead->asicHead = dirHead->gainHead->asicHead->nextAsic;
-               delete (dirHead->gainHead->asicTail);
-            }
-         }
-         while ( dirHead->gainHead != NULL ) {
-            dirHead->gainTail = dirHead->gainHead;
-            dirHead->gainHead = dirHead->gainHead->nextGain;
-            delete (dirHead->gainTail);
-         }
-      }
-      while ( dirHead != NULL ) {
-         dirTail = dirHead;
-         dirHead = dirHead->nextDir;
-         delete (dirTail);
-      }
-   }
+   for (x=0; x < asicList.size(); x++) delete asicList[x];
+   asicList.clear();
+   delete[] asicHash;
 }
 
  
@@ -416,9 +401,10 @@ TGraph *KpixCalibRead::getGraphFilt ( string dir, int gain, int kpix, int channe
 
 // Get Calibration Graph Fit Results If They Exist
 bool KpixCalibRead::getCalibData ( double *fitGain, double *fitIntercept,
-                                   string dir, int gain, int kpix, int channel, int bucket,
+                                   const string &dir, int gain, int kpix, int channel, int bucket,
                                    double *fitGainErr, double *fitInterceptErr ) {
 
+   KpixCalibReadAsicStruct *entry;
    TGraph *gr = NULL;
    string name;
 
@@ -426,29 +412,12 @@ bool KpixCalibRead::getCalibData ( double *fitGain, double *fitIntercept,
    *fitGain      = 0;
    *fitIntercept = 0;
 
-   // Check if XML data exists
-   KpixCalibReadDir *currDir;
-   KpixCalibReadGainStruct *currGain;
-   KpixCalibReadAsicStruct *currAsic;
+   if ( (entry = findEntry ( dir, gain, kpix, channel, bucket )) == NULL ) return(false);
 
-   currDir = findDir ( dir );
-
-   if ( currDir != NULL ) {
-      currGain = findGain ( currDir, gain );
-      
-      if ( currGain != NULL ) {
-         currAsic = findAsic ( currGain, kpix );
-       
-         if ( currAsic != NULL ) {
-            *fitGain = currAsic->fitGain[channel][bucket];
-            *fitIntercept = currAsic->fitIntercept[channel][bucket];
-            if ( fitGainErr      != NULL ) *fitGainErr      = currAsic->fitGainErr[channel][bucket];
-            if ( fitInterceptErr != NULL ) *fitInterceptErr = currAsic->fitInterceptErr[channel][bucket];
-         }
-      }
-   }
+   // Without xml data the values are read from the root file once
+   if ( !xmlDataExists && (entry->loaded[channel][bucket] & KPIX_CALIB_LOAD_FIT) == 0 ) {
+      entry->loaded[channel][bucket] |= KPIX_CALIB_LOAD_FIT;
 
-   if ( !xmlDataExists ) {
       // First try filtered gain
       name = "/" + dir + "/" + genPlotName(gain,kpix,channel,bucket,"calib_filt",(gain==2)?1:0);
       kpixRunRead->treeFile->GetObject(name.c_str(),gr);
@@ -461,13 +430,18 @@ bool KpixCalibRead::getCalibData ( double *fitGain, double *fitIntercept,
 
       // Get gain value
       if ( gr != NULL && gr->GetFunction("pol1") != NULL ) {
-         *fitGain = gr->GetFunction("pol1")->GetParameter(1);
-         *fitIntercept = gr->GetFunction("pol1")->GetParameter(0);
-         if ( fitGainErr      != NULL ) *fitGainErr      = gr->GetFunction("pol1")->GetParError(1);
-         if ( fitInterceptErr != NULL ) *fitInterceptErr = gr->GetFunction("pol1")->GetParError(0);
+         entry->fitGain[channel][bucket]         = gr->GetFunction("pol1")->GetParameter(1);
+         entry->fitIntercept[channel][bucket]    = gr->GetFunction("pol1")->GetParameter(0);
+         entry->fitGainErr[channel][bucket]      = gr->GetFunction("pol1")->GetParError(1);
+         entry->fitInterceptErr[channel][bucket] = gr->GetFunction("pol1")->GetParError(0);
       }
+      if ( gr != NULL ) delete gr;
    }
-   if ( gr != NULL ) delete gr;
+
+   *fitGain = entry->fitGain[channel][bucket];
+   *fitIntercept = entry->fitIntercept[channel][bucket];
+   if ( fitGainErr      != NULL ) *fitGainErr      = entry->fitGainErr[channel][bucket];
+   if ( fitInterceptErr != NULL ) *fitInterceptErr = entry->fitInterceptErr[channel][bucket];
 
    // Return Value
    if ( *fitGain == 0 || *fitIntercept == 0 ) return(false);
@@ -476,45 +450,34 @@ bool KpixCalibRead::getCalibData ( double *fitGain, double *fitIntercept,
 
 
 // Get Calibration Graph Fit RMS Value
-bool KpixCalibRead::getCalibRms ( double *rms, string dir, int gain, int kpix, int channel, int bucket) {
+bool KpixCalibRead::getCalibRms ( double *rms, const string &dir, int gain, int kpix, int channel, int bucket) {
 
-   TGraph *gr;
+   KpixCalibReadAsicStruct *entry;
+   TGraph *gr = NULL;
    string name;
 
    // Default
    *rms = 0;
 
-   // Check if XML data exists
-   KpixCalibReadDir *currDir;
-   KpixCalibReadGainStruct *currGain;
-   KpixCalibReadAsicStruct *currAsic;
-
-   currDir = findDir ( dir );
+   if ( (entry = findEntry ( dir, gain, kpix, channel, bucket )) == NULL ) return(false);
 
-   if ( currDir != NULL ) {
-      currGain = findGain ( currDir, gain );
-      
-      if ( currGain != NULL ) {
-         currAsic = findAsic ( currGain, kpix );
-       
-         if ( currAsic != NULL ) {
-            *rms = currAsic->fitRms[channel][bucket];
-         }
-      }
-   }
+   // Without xml data the value is read from the root file once
+   if ( !xmlDataExists && (entry->loaded[channel][bucket] & KPIX_CALIB_LOAD_RMS) == 0 ) {
+      entry->loaded[channel][bucket] |= KPIX_CALIB_LOAD_RMS;
 
-   if ( !xmlDataExists ) {
       // Get RMS
       name = "/" + dir + "/" + genPlotName(gain,kpix,channel,bucket,"calib_resid",(gain==2)?1:0);
       kpixRunRead->treeFile->GetObject(name.c_str(),gr);
 
       // Get value
       if ( gr != NULL ) {
-         *rms = gr->GetRMS(2);
+         entry->fitRms[channel][bucket] = gr->GetRMS(2);
          delete gr;
       }
    }
 
+   *rms = entry->fitRms[channel][bucket];
+
    // Return Value
    if ( *rms == 0 ) return(false);
    else return(true);
@@ -523,54 +486,44 @@ bool KpixCalibRead::getCalibRms ( double *rms, string dir, int gain, int kpix, i
 
 // Get Histogram Graph Fit Results If They Exist
 bool KpixCalibRead::getHistData ( double *fitMean, double *fitSigma, double *fitRms, 
-                                  string dir, int gain, int kpix, int channel, int bucket,
+                                  const string &dir, int gain, int kpix, int channel, int bucket,
                                   double *fitMeanErr, double *fitSigmaErr ) {
 
+   KpixCalibReadAsicStruct *entry;
    TH1F *hist = NULL;
+   string name;
 
    // Defaults
    *fitMean  = 0;
    *fitSigma = 0;
+   *fitRms   = 0;
 
-   // Check if XML data exists
-   KpixCalibReadDir *currDir;
-   KpixCalibReadGainStruct *currGain;
-   KpixCalibReadAsicStruct *currAsic;
+   if ( (entry = findEntry ( dir, gain, kpix, channel, bucket )) == NULL ) return(false);
 
-   currDir = findDir ( dir );
-
-   if ( currDir != NULL ) {
-      currGain = findGain ( currDir, gain );
-      
-      if ( currGain != NULL ) {
-         currAsic = findAsic ( currGain, kpix );
-       
-         if ( currAsic != NULL ) {
-            *fitMean = currAsic->histMean[channel][bucket];
-            *fitSigma = currAsic->histSigma[channel][bucket];
-            *fitRms = currAsic->histRms[channel][bucket];
-            if ( fitMeanErr  != NULL ) *fitMeanErr  = currAsic->histMeanErr[channel][bucket];
-            if ( fitSigmaErr != NULL ) *fitSigmaErr = currAsic->histSigmaErr[channel][bucket];
-         }
-      }
-   }
+   // Without xml data the values are read from the root file once
+   if ( !xmlDataExists && (entry->loaded[channel][bucket] & KPIX_CALIB_LOAD_HIST) == 0 ) {
+      entry->loaded[channel][bucket] |= KPIX_CALIB_LOAD_HIST;
 
-   if ( !xmlDataExists ) {
       // Get Plot
-      string name = "/" + dir + "/" + genPlotName(gain,kpix,channel,bucket,"dist_value");
+      name = "/" + dir + "/" + genPlotName(gain,kpix,channel,bucket,"dist_value");
       kpixRunRead->treeFile->GetObject(name.c_str(),hist);
 
       // Get Values
       if ( hist != NULL && hist->GetFunction("gaus") != NULL ) {
-         *fitMean = hist->GetFunction("gaus")->GetParameter(1);
-         *fitSigma = hist->GetFunction("gaus")->GetParameter(2);
-         *fitRms = hist->GetRMS();
-         if ( fitMeanErr  != NULL ) *fitMeanErr  = hist->GetFunction("gaus")->GetParError(1);
-         if ( fitSigmaErr != NULL ) *fitSigmaErr = hist->GetFunction("gaus")->GetParError(2);
+         entry->histMean[channel][bucket]     = hist->GetFunction("gaus")->GetParameter(1);
+         entry->histSigma[channel][bucket]    = hist->GetFunction("gaus")->GetParameter(2);
+         entry->histRms[channel][bucket]      = hist->GetRMS();
+         entry->histMeanErr[channel][bucket]  = hist->GetFunction("gaus")->GetParError(1);
+         entry->histSigmaErr[channel][bucket] = hist->GetFunction("gaus")->GetParError(2);
       }
+      if ( hist != NULL ) delete hist;
    }
 
-   if ( hist != NULL ) delete hist;
+   *fitMean = entry->histMean[channel][bucket];
+   *fitSigma = entry->histSigma[channel][bucket];
+   *fitRms = entry->histRms[channel][bucket];
+   if ( fitMeanErr  != NULL ) *fitMeanErr  = entry->histMeanErr[channel][bucket];
+   if ( fitSigmaErr != NULL ) *fitSigmaErr = entry->histSigmaErr[channel][bucket];
 
    // Return Value
    if ( *fitMean == 0 || *fitSigma == 0 ) return(false);
@@ -24,6 +24,7 @@
 #define __KPIX_CALIB_READ_H__
 
 #include <string>
+#include <vector>
 #include <TSAXParser.h>
 #include "../online/KpixRunWrite.h"
 
@@ -35,8 +36,6 @@ class TGraph;
 class TH1;
 class TH1F;
 class KpixCalibReadAsicStruct;
-class KpixCalibReadGainStruct;
-class KpixCalibReadDir;
 
 
 
@@ -56,39 +55,13 @@ class KpixCalibReadAsicStruct {
       double histMeanErr [1024][4]; 
       double histRms [1024][4]; 
 
-      // Asic Serial #
-      int kpixID;
-
-      // Self-pointing pointer for linked list
-      class KpixCalibReadAsicStruct *nextAsic;
-};
-
-// Structure for different gain modes
-class KpixCalibReadGainStruct {
+      // Values already read from root file plots, used when no xml data exists
+      unsigned char loaded [1024][4];
 
-      public:
-      // Head & Tail pointer to the Calibration Data structure
-      KpixCalibReadAsicStruct *asicHead, *asicTail;
-
-      // Asic Serial #
+      // Directory index, gain & Asic Serial #
+      int dirID;
       int gainID;
-    
-      // Self-pointing pointer for linked list
-      class KpixCalibReadGainStruct *nextGain;
-};
-
-// Structure for directories
-class KpixCalibReadDir {
-    
-      public:
-      // Head & Tail pointer to the Gain structure
-      KpixCalibReadGainStruct *gainHead, *gainTail;
-
-      // Directory Name
-      std::string dirName;
-
-      // Self-pointing pointer for linked list
-      class KpixCalibReadDir *nextDir;
+      int kpixID;
 };
 
 
@@ -102,31 +75,41 @@ class KpixCalibRead : public TSAXParser{
 
       // Pointers & variables to hold the current xml tags
       KpixCalibReadAsicStruct *currAsic;
-      KpixCalibReadGainStruct *currGain;
-      KpixCalibReadDir *currDir;
+      int currDir, currGain;
       int currBucket, currChannel;
-      char currVar[15];
-      
-      // Head & Tail pointer for the KpixCalibReadDir linked list
-      KpixCalibReadDir *dirHead, *dirTail;
+      int currVar;
+
+      // Directory names, position is the directory index
+      std::vector<std::string> dirList;
+      int lastDir;
+
+      // All ASIC entries
+      std::vector<KpixCalibReadAsicStruct *> asicList;
+
+      // Open addressed hash table of ASIC entries keyed by directory, gain & serial
+      KpixCalibReadAsicStruct **asicHash;
+      unsigned int asicHashSize;
+
+      //! Function to init variables
+      void init ( );
 
-      //! Function to add an asic to linked list
-      KpixCalibReadAsicStruct *addAsic ( KpixCalibReadGainStruct *currGain, int kpixID );
+      //! Function to compute hash table slot
+      unsigned int asicSlot ( int dirID, int gainID, int kpixID );
 
-      //! Function to find an asic to linked list
-      KpixCalibReadAsicStruct *findAsic ( KpixCalibReadGainStruct *currGain, int kpixID );
+      //! Function to add an asic to the table or return an existing entry
+      KpixCalibReadAsicStruct *addAsic ( int dirID, int gainID, int kpixID );
 
-      //! Function to add a Gain to linked list
-      KpixCalibReadGainStruct *addGain ( KpixCalibReadDir *currDir, int gainID );
+      //! Function to find an asic in the table
+      KpixCalibReadAsicStruct *findAsic ( int dirID, int gainID, int kpixID );
 
-      //! Function to find a Gain to linked list
-      KpixCalibReadGainStruct *findGain ( KpixCalibReadDir *currDir, int gainID );
+      //! Function to add a Dir or return an existing index
+      int addDir ( const std::string &dirName );
 
-      //! Function to add a Dir to linked list
-      KpixCalibReadDir *addDir ( std::string dirName );
+      //! Function to find a Dir, returns -1 if not found
+      int findDir ( const std::string &dirName );
 
-      //! Function to find a Dir to linked list
-      KpixCalibReadDir *findDir ( std::string dirName );
+      //! Function to find the entry for a lookup, created when reading from root file plots
+      KpixCalibReadAsicStruct *findEntry ( const std::string &dir, int gain, int kpix, int channel, int bucket );
 
    public:
 
@@ -182,16 +165,16 @@ class KpixCalibRead : public TSAXParser{
 
       //! Get Calibration Graph Fit Results If They Exist
       bool getCalibData ( double *fitGain, double *fitIntercept, 
-                          std::string dir, int gain, int kpix, int channel, int bucket,
+                          const std::string &dir, int gain, int kpix, int channel, int bucket,
                           double *fitGainErr=NULL, double *fitInterceptErr=NULL );
 
       //! Get Calibration Graph Fit RMS Value
       bool getCalibRms  ( double *rms, 
-                          std::string dir, int gain, int kpix, int channel, int bucket);
+                          const std::string &dir, int gain, int kpix, int channel, int bucket);
 
       //! Get Histogram Graph Fit Results If They Exist
       bool getHistData ( double *mean, double *sigma, double *rms,
-                         std::string dir, int gain, int kpix, int channel, int bucket,
+                         const std::string &dir, int gain, int kpix, int channel, int bucket,
                          double *meanErr=NULL, double *sigmaErr=NULL);
 
       //! Copy calibration data to a new root file
@@ -39,6 +39,8 @@ KpixConfigXml::KpixConfigXml () {
    fpga        = NULL;
    asic        = NULL;
    asicCnt     = 0;
+   asicSet     = NULL;
+   asicAll     = false;
    xmlWriteEn  = 0;
    clkPrd      = 0;
 }
@@ -98,16 +100,23 @@ void KpixConfigXml::OnEndElement ( const char *name ) {
          if ( currAsic == -1 || asic[x]->getAddress() == currAsic ) {
             asic[x]->setTiming ( clkPrd, rstOnTime, rstOffTime, leakageNullOff, offsetNullOff,
                                  threshOff, trigInhibitOff, pwrUpOn, deselSequence, bunchClkDly, 
-                                 digitizationDly, bunchClockCount,true,xmlWriteEn,0);
-            asic[x]->setCalibTime ( calCount, cal0Delay, cal1Delay, cal2Delay, cal3Delay, xmlWriteEn);
-            asic[x]->setDacThreshRangeA ( rstThreshA, trigThreshA, xmlWriteEn);
-            asic[x]->setDacThreshRangeB ( rstThreshB, trigThreshB, xmlWriteEn);
-            asic[x]->setChannelModeArray ( modes, xmlWriteEn );
+                                 digitizationDly, bunchClockCount,true,false,0);
+            asic[x]->setCalibTime ( calCount, cal0Delay, cal1Delay, cal2Delay, cal3Delay, false);
+            asic[x]->setDacThreshRangeA ( rstThreshA, trigThreshA, false);
+            asic[x]->setDacThreshRangeB ( rstThreshB, trigThreshB, false);
+            asic[x]->setChannelModeArray ( modes, false );
          }
       }
+      setAsic ( currAsic );
       currAsic = -1;
    }
    else if ( !strcmp(name, "kpixChanMode") ) currChannel = -1;
+
+   // ASIC settings reach all devices, except pixel polarity inside a single asic element
+   else if ( !strncmp(name, "cfg", 3) || !strncmp(name, "cntrl", 5) || !strncmp(name, "dac", 3) ) {
+      if ( !strcmp(name, "cntrlPosPixel") ) setAsic ( currAsic );
+      else setAsic ( -1 );
+   }
    strcpy (currVar, "" );
 } 
 
@@ -163,69 +172,69 @@ void KpixConfigXml::OnCharacters ( const char *value ) {
 
       // ASIC defaults
       else if ( !strcmp(currVar, "cfgTestData") )
-         for(x=0; x<asicCnt; x++) asic[x]->setCfgTestData( atoi(value), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setCfgTestData( atoi(value), false );
       else if ( !strcmp(currVar, "cfgAutoReadDis") )
-         for(x=0; x<asicCnt; x++) asic[x]->setCfgAutoReadDis ( atoi(value), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setCfgAutoReadDis ( atoi(value), false );
       else if ( !strcmp(currVar, "cfgForceTemp") )
-         for(x=0; x<asicCnt; x++) asic[x]->setCfgForceTemp ( atoi(value), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setCfgForceTemp ( atoi(value), false );
       else if ( !strcmp(currVar, "cfgDisableTemp") )
-         for(x=0; x<asicCnt; x++) asic[x]->setCfgDisableTemp ( atoi(value), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setCfgDisableTemp ( atoi(value), false );
       else if ( !strcmp(currVar, "cfgAutoStatus") )
-         for(x=0; x<asicCnt; x++) asic[x]->setCfgAutoStatus ( atoi(value), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setCfgAutoStatus ( atoi(value), false );
       else if ( !strcmp(currVar, "cntrlCalibHigh") )
-         for(x=0; x<asicCnt; x++) asic[x]->setCntrlCalibHigh ( atoi(value), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setCntrlCalibHigh ( atoi(value), false );
       else if ( !strcmp(currVar, "cntrlCalDacInt") )
-         for(x=0; x<asicCnt; x++) asic[x]->setCntrlCalDacInt ( atoi(value), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setCntrlCalDacInt ( atoi(value), false );
       else if ( !strcmp(currVar, "cntrlForceLowGain") )
-         for(x=0; x<asicCnt; x++) asic[x]->setCntrlForceLowGain ( atoi(value), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setCntrlForceLowGain ( atoi(value), false );
       else if ( !strcmp(currVar, "cntrlLeakNullDis") )
-         for(x=0; x<asicCnt; x++) asic[x]->setCntrlLeakNullDis ( atoi(value), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setCntrlLeakNullDis ( atoi(value), false );
       else if ( !strcmp(currVar, "cntrlDoubleGain") )
-         for(x=0; x<asicCnt; x++) asic[x]->setCntrlDoubleGain ( atoi(value), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setCntrlDoubleGain ( atoi(value), false );
       else if ( !strcmp(currVar, "cntrlNearNeighbor") )
-         for(x=0; x<asicCnt; x++) asic[x]->setCntrlNearNeighbor ( atoi(value), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setCntrlNearNeighbor ( atoi(value), false );
 
       else if ( !strcmp(currVar, "cntrlPosPixel") ) {
          for(x=0; x<asicCnt; x++) {
             if ( currAsic == -1 || asic[x]->getAddress() == currAsic ) 
-               asic[x]->setCntrlPosPixel ( atoi(value), xmlWriteEn );
+               asic[x]->setCntrlPosPixel ( atoi(value), false );
          }
       }
 
       else if ( !strcmp(currVar, "cntrlDisPerRst") )
-         for(x=0; x<asicCnt; x++) asic[x]->setCntrlDisPerRst ( atoi(value), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setCntrlDisPerRst ( atoi(value), false );
       else if ( !strcmp(currVar, "cntrlEnDcRst") )
-         for(x=0; x<asicCnt; x++) asic[x]->setCntrlEnDcRst ( atoi(value), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setCntrlEnDcRst ( atoi(value), false );
       else if ( !strcmp(currVar, "cntrlCalSrc") )
-         for(x=0; x<asicCnt; x++) asic[x]->setCntrlCalSrc ( (KpixAsic::KpixCalTrigSrc)(atoi(value)), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setCntrlCalSrc ( (KpixAsic::KpixCalTrigSrc)(atoi(value)), false );
       else if ( !strcmp(currVar, "cntrlTrigSrc") )
-         for(x=0; x<asicCnt; x++) asic[x]->setCntrlTrigSrc ( (KpixAsic::KpixCalTrigSrc)(atoi(value)), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setCntrlTrigSrc ( (KpixAsic::KpixCalTrigSrc)(atoi(value)), false );
       else if ( !strcmp(currVar, "cntrlShortIntEn") )
-         for(x=0; x<asicCnt; x++) asic[x]->setCntrlShortIntEn ( atoi(value), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setCntrlShortIntEn ( atoi(value), false );
       else if ( !strcmp(currVar, "cntrlDisPwrCycle") )
-         for(x=0; x<asicCnt; x++) asic[x]->setCntrlDisPwrCycle ( atoi(value), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setCntrlDisPwrCycle ( atoi(value), false );
       else if ( !strcmp(currVar, "cntrlFeCurr") )
-         for(x=0; x<asicCnt; x++) asic[x]->setCntrlFeCurr ( (KpixAsic::KpixFeCurr)(atoi(value)), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setCntrlFeCurr ( (KpixAsic::KpixFeCurr)(atoi(value)), false );
       else if ( !strcmp(currVar, "cntrlDiffTime") )
-         for(x=0; x<asicCnt; x++) asic[x]->setCntrlDiffTime ( (KpixAsic::KpixDiffTime)(atoi(value)), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setCntrlDiffTime ( (KpixAsic::KpixDiffTime)(atoi(value)), false );
       else if ( !strcmp(currVar, "cntrlTrigDisable") )
-         for(x=0; x<asicCnt; x++) asic[x]->setCntrlTrigDisable ( atoi(value), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setCntrlTrigDisable ( atoi(value), false );
       else if ( !strcmp(currVar, "cntrlMonSrc") )
-         for(x=0; x<asicCnt; x++) asic[x]->setCntrlMonSrc ( (KpixAsic::KpixMonSrc)(atoi(value)), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setCntrlMonSrc ( (KpixAsic::KpixMonSrc)(atoi(value)), false );
       else if ( !strcmp(currVar, "cntrlHoldTime") )
-         for(x=0; x<asicCnt; x++) asic[x]->setCntrlHoldTime ( (KpixAsic::KpixHoldTime)(atoi(value)), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setCntrlHoldTime ( (KpixAsic::KpixHoldTime)(atoi(value)), false );
       else if ( !strcmp(currVar, "dacCalib") )
-         for(x=0; x<asicCnt; x++) asic[x]->setDacCalib ( (unsigned char)atoi(value), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setDacCalib ( (unsigned char)atoi(value), false );
       else if ( !strcmp(currVar, "dacRampThresh") )
-         for(x=0; x<asicCnt; x++) asic[x]->setDacRampThresh ( (unsigned char)atoi(value), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setDacRampThresh ( (unsigned char)atoi(value), false );
       else if ( !strcmp(currVar, "dacRangeThresh") )
-         for(x=0; x<asicCnt; x++) asic[x]->setDacRangeThresh ( (unsigned char)atoi(value), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setDacRangeThresh ( (unsigned char)atoi(value), false );
       else if ( !strcmp(currVar, "dacDefaultAnalog") )
-         for(x=0; x<asicCnt; x++) asic[x]->setDacDefaultAnalog ( (unsigned char)atoi(value), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setDacDefaultAnalog ( (unsigned char)atoi(value), false );
       else if ( !strcmp(currVar, "dacEventThreshRef") )
-         for(x=0; x<asicCnt; x++) asic[x]->setDacEventThreshRef ( (unsigned char)atoi(value), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setDacEventThreshRef ( (unsigned char)atoi(value), false );
       else if ( !strcmp(currVar, "dacShaperBias") )
-         for(x=0; x<asicCnt; x++) asic[x]->setDacShaperBias ( (unsigned char)atoi(value), xmlWriteEn );
+         for(x=0; x<asicCnt; x++) asic[x]->setDacShaperBias ( (unsigned char)atoi(value), false );
 
       // Store timings for later
       else if ( !strcmp(currVar, "rstOnTime") ) rstOnTime = atoi(value);
@@ -267,7 +276,7 @@ void KpixConfigXml::readConfig ( char *xmlFile, KpixFpga *kpixFpga, KpixAsic **k
    asic = kpixAsic;
    asicCnt = asicCount;
    xmlWriteEn = writeEn;
-   ParseFile ( xmlFile );
+   parseAsic ( xmlFile );
 }
 void KpixConfigXml::readConfig ( char *xmlFile, KpixFpga *kpixFpga, int writeEn ) {
    fpga = kpixFpga;
@@ -281,7 +290,46 @@ void KpixConfigXml::readConfig ( char *xmlFile, KpixAsic **kpixAsic, unsigned in
    asic = kpixAsic;
    asicCnt = asicCount;
    xmlWriteEn = writeEn;
-   ParseFile ( xmlFile );
+   parseAsic ( xmlFile );
+}
+
+// Mark ASIC devices set by the xml file, -1 marks all
+void KpixConfigXml::setAsic ( int id ) {
+   unsigned int x;
+
+   if ( asicSet == NULL ) return;
+   if ( id == -1 ) asicAll = true;
+   else for (x=0; x < asicCnt; x++) {
+      if ( asic[x]->getAddress() == id ) asicSet[x] = true;
+   }
+}
+
+// Parse the xml file, then write the ASIC devices it has set values for
+void KpixConfigXml::parseAsic ( char *xmlFile ) {
+   unsigned int x;
+
+   asicSet = new bool[asicCnt];
+   asicAll = false;
+   for (x=0; x < asicCnt; x++) asicSet[x] = false;
+
+   try {
+      ParseFile ( xmlFile );
+
+      // ASIC settings are stored while parsing and written together. Broadcast
+      // writes reach every device, so only a full set is written at once.
+      if ( xmlWriteEn ) {
+         if ( asicAll ) KpixAsic::writeConfigAll ( asic, asicCnt );
+         else for (x=0; x < asicCnt; x++) {
+            if ( asicSet[x] ) KpixAsic::writeConfigAll ( &(asic[x]), 1 );
+         }
+      }
+   } catch ( string error ) {
+      delete[] asicSet;
+      asicSet = NULL;
+      throw;
+   }
+   delete[] asicSet;
+   asicSet = NULL;
 }
 
 void KpixConfigXml::writeConfig ( char *xmlFile, KpixFpga *fpga, KpixAsic **asic, unsigned int asicCount, bool readEn ) {
@@ -41,6 +41,16 @@ class KpixConfigXml : public TSAXParser {
       KpixAsic     **asic;  //! Root: Don't stream
       unsigned int asicCnt;
 
+      // ASIC devices the xml file has set values for, written by readConfig
+      bool         *asicSet; //! Root: Don't stream
+      bool         asicAll;
+
+      // Mark ASIC devices set by the xml file, -1 marks all
+      void setAsic ( int id );
+
+      // Parse the xml file, then write the ASIC devices it has set values for
+      void parseAsic ( char *xmlFile );
+
    public:
    
       // Constructor
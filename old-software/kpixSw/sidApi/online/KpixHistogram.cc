@@ -22,18 +22,74 @@
 using namespace std;
 
 
+// Pool Constructor
+KpixHistogramPool::KpixHistogramPool ( unsigned int count ) {
+   data   = (unsigned int *) calloc(count * KPIX_HISTOGRAM_BINS, sizeof(unsigned int));
+   slices = (data == NULL) ? 0 : count;
+   next   = 0;
+}
+
+
+// Pool DeConstructor
+KpixHistogramPool::~KpixHistogramPool ( ) {
+   if ( data != NULL ) free(data);
+}
+
+
+// Get a zeroed slice
+unsigned int *KpixHistogramPool::alloc() {
+   if ( next >= slices ) return(NULL);
+   return(&(data[(next++) * KPIX_HISTOGRAM_BINS]));
+}
+
+
+// Get number of slices in use
+unsigned int KpixHistogramPool::used() { return(next); }
+
+
+// Get number of slices in pool
+unsigned int KpixHistogramPool::capacity() { return(slices); }
+
+
 // Constructor
 KpixHistogram::KpixHistogram () {
    data       = NULL;
    entries    = 0;
    min        = 0;
    max        = 0;
+   pool       = NULL;
+   fixed      = false;
 }
 
 
 // DeConstructor
 KpixHistogram::~KpixHistogram ( ) { 
-   if ( data != NULL ) free(data);
+   if ( data != NULL && ! fixed ) free(data);
+}
+
+
+// Set bin pool
+void KpixHistogram::setPool(KpixHistogramPool *pool) {
+   if ( data == NULL ) this->pool = pool;
+}
+
+
+// Move fixed range slice contents to dynamic storage
+void KpixHistogram::release() {
+   unsigned int *newData;
+   unsigned int x;
+
+   newData = NULL;
+   if ( entries > 0 ) {
+      newData = (unsigned int *) malloc(entries * sizeof(unsigned int));
+      if ( newData == NULL ) throw(string("KpixHistogram::release -> Malloc Error"));
+      for (x=0; x < entries; x++) newData[x] = data[min+x];
+   }
+
+   // Slice stays with the pool until it is deleted
+   data  = newData;
+   fixed = false;
+   pool  = NULL;
 }
 
 
@@ -43,6 +99,29 @@ void KpixHistogram::fill(unsigned int value) {
    unsigned int newEntries;
    unsigned int x,diff;
 
+   // Take slice from pool on first entry
+   if ( data == NULL && pool != NULL && value < KPIX_HISTOGRAM_BINS ) {
+      data = pool->alloc();
+      if ( data != NULL ) fixed = true;
+      else pool = NULL;
+   }
+
+   // Fixed range, value indexes the slice directly
+   if ( fixed ) {
+      if ( value < KPIX_HISTOGRAM_BINS ) {
+         data[value]++;
+         if ( entries == 0 ) {
+            min = value;
+            max = value;
+         }
+         else if ( value < min ) min = value;
+         else if ( value > max ) max = value;
+         entries = max - min + 1;
+         return;
+      }
+      release();
+   }
+
    // First entry is added
    if ( data == NULL ) {
       data = (unsigned int *) malloc(sizeof(unsigned int));
@@ -108,6 +187,6 @@ unsigned int KpixHistogram::value(unsigned int bin) {
 
 // Get Bin Count
 unsigned int KpixHistogram::count(unsigned int bin) { 
-   if ( bin < entries ) return(data[bin]);
+   if ( bin < entries ) return(fixed ? data[min+bin] : data[bin]);
    else return(0);
 }
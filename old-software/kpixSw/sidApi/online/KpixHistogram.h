@@ -21,9 +21,56 @@
 
 /** \ingroup online */
 
+//! Number of bins in a fixed range histogram, covers 13-bit sample values
+#define KPIX_HISTOGRAM_BINS 8192
+
+//! This class holds preallocated bins shared by fixed range histograms.
+/*!
+ * Bins for count histograms are allocated in a single block when the pool
+ * is created. Each histogram takes one slice of KPIX_HISTOGRAM_BINS bins on
+ * its first fill and keeps it for the lifetime of the pool. The pool must
+ * outlive the histograms which use it.
+ *
+ * The same class is in kpixSw_3.00/onlineGui/KpixHistogram.h. The two
+ * trees are built separately and already carry their own KpixHistogram, so
+ * a fix to one copy must be made to the other as well.
+ */
+class KpixHistogramPool {
+
+      // Bin storage
+      unsigned int *data;
 
-//! This class is used to update KPIX histogram information.
+      // Number of slices
+      unsigned int slices;
+
+      // Next free slice
+      unsigned int next;
+
+   public:
+
+      //! Constructor, allocates count histograms worth of bins
+      KpixHistogramPool ( unsigned int count );
+
+      //! DeConstructor
+      ~KpixHistogramPool ( );
+
+      //! Get a zeroed slice, returns NULL if the pool is exhausted
+      unsigned int *alloc();
+
+      //! Get number of slices in use
+      unsigned int used();
 
+      //! Get number of slices in pool
+      unsigned int capacity();
+};
+
+
+//! This class is used to update KPIX histogram information.
+/*!
+ * Histograms with a pool set take a fixed range slice from the pool on the
+ * first fill and each fill is a single increment. Histograms without a pool,
+ * or whose pool is exhausted, grow dynamically as values are added.
+ */
 class KpixHistogram {
 
       // Histogram contents
@@ -36,6 +83,15 @@ class KpixHistogram {
       unsigned int min;
       unsigned int max;
 
+      // Bin pool
+      KpixHistogramPool *pool;
+
+      // Data is a fixed range slice indexed by value
+      bool fixed;
+
+      // Move fixed range slice contents to dynamic storage
+      void release();
+
    public:
 
       //! Constructor
@@ -44,6 +100,9 @@ class KpixHistogram {
       //! Constructor
       ~KpixHistogram ( );
 
+      //! Set bin pool, must be called before the first fill
+      void setPool(KpixHistogramPool *pool);
+
       //! Add an entry
       void fill(unsigned int value);
 
@@ -164,6 +164,12 @@ ConFpga::ConFpga ( uint destination, uint index, uint kpixCount, Device *parent
    getVariable("KpixRxRaw")->setDescription("Receive every sample regardless of validity");
    getVariable("KpixRxRaw")->setTrueFalse();
 
+   addVariable(new Variable("KpixBroadcast", Variable::Configuration));
+   getVariable("KpixBroadcast")->setDescription("Broadcast kpix registers with the same value in every kpix, requires firmware decoding the broadcast header bit");
+   getVariable("KpixBroadcast")->setTrueFalse();
+   getVariable("KpixBroadcast")->setHidden(true);
+   bcastLink_ = false;
+
    //Timestamp Config Register
    addRegister(new Register("TimestampConfig", 0x01000007));
    addVariable(new Variable("TimestampSource", Variable::Configuration));
@@ -282,11 +288,29 @@ ConFpga::ConFpga ( uint destination, uint index, uint kpixCount, Device *parent
    for (uint i=0; i < kpixCount; i++) 
       addDevice(new KpixAsic(destination,(0x01100000 | ((i<<8) & 0xff00)),i,(i==(kpixCount-1)),this));
 
+   // Broadcast copies of kpix configuration registers
+   for (x=0; x < KPIX_REG_COUNT; x++) {
+      tmp.str("");
+      tmp << "KpixBcast_" << setw(2) << setfill('0') << dec << x;
+      kpixBcast_.push_back(new Register(tmp.str(),
+         ((KpixAsic*)(device("kpixAsic",0)))->configAddress(x) | KPIX_BCAST_ADDR));
+   }
+
    getVariable("Enabled")->setHidden(true);
 }
 
 // Deconstructor
-ConFpga::~ConFpga ( ) { }
+ConFpga::~ConFpga ( ) {
+   uint x;
+
+   for (x=0; x < kpixBcast_.size(); x++) delete kpixBcast_[x];
+}
+
+// Method to allow kpix register broadcast
+void ConFpga::setBroadcastLink ( bool capable ) {
+   bcastLink_ = capable;
+   getVariable("KpixBroadcast")->setHidden(!capable);
+}
 
 // Method to process a command
 void ConFpga::command ( string name, string arg) {
@@ -443,6 +467,7 @@ void ConFpga::writeConfig ( bool force ) {
    stringstream tmpA;
    uint         evrReg;
    uint         evrIdx;
+   bool         bcast;
 
    REGISTER_LOCK
 
@@ -503,10 +528,91 @@ void ConFpga::writeConfig ( bool force ) {
       writeRegister(getRegister(tmpA.str()),force);
       
    }
+   bcast = (getVariable("KpixBroadcast")->getInt() == 1);
+
+   // Link would address a missing kpix
+   if ( bcast && !bcastLink_ ) {
+      cout << "ConFpga::writeConfig -> Comm link can not broadcast, disabling KpixBroadcast!" << endl;
+      getVariable("KpixBroadcast")->set("False");
+      bcast = false;
+   }
 
    // Sub devices
    REGISTER_UNLOCK
-   Device::writeConfig(force);
+   if ( bcast ) writeKpixConfig(force);
+   else Device::writeConfig(force);
+}
+
+// Write kpix configuration, registers with the same value in every kpix are broadcast
+void ConFpga::writeKpixConfig ( bool force ) {
+   KpixAsic *kpix;
+   uint     value;
+   uint     first;
+   uint     pending;
+   uint     x;
+   uint     i;
+   bool     used;
+   bool     bcast;
+
+   for (i=0; i < kpixCount; i++) ((KpixAsic*)(device("kpixAsic",i)))->prepConfig(force);
+
+   // Registers in address order
+   for (x=0; x < KPIX_REG_COUNT; x++) {
+      bcast   = true;
+      used    = false;
+      first   = 0;
+      pending = 0;
+
+      // Every enabled kpix using the register must hold the same value
+      for (i=0; i < kpixCount; i++) {
+         kpix = (KpixAsic*)(device("kpixAsic",i));
+         if ( kpix->getInt("Enabled") != 1 || ! kpix->configValue(x,&value) ) continue;
+         if ( used && value != first ) bcast = false;
+         if ( kpix->configPending(x) ) pending++;
+         first = value;
+         used  = true;
+      }
+      bcast = (bcast && pending > 1);
+
+      // Broadcast once
+      if ( bcast ) {
+         REGISTER_LOCK
+         kpixBcast_[x]->set(first);
+         writeRegister(kpixBcast_[x],true);
+         REGISTER_UNLOCK
+      }
+
+      // Verify kpix which took part in the broadcast, disabled kpix and kpix
+      // without the register received it as well and lose their written value
+      for (i=0; i < kpixCount; i++) {
+         kpix = (KpixAsic*)(device("kpixAsic",i));
+         if ( ! bcast ) kpix->writePending(x,false);
+         else if ( kpix->getInt("Enabled") == 1 && kpix->configValue(x,&value) ) kpix->writePending(x,true);
+         else kpix->invalidRegister(x);
+      }
+   }
+}
+
+// Method to prepare calibration configuration of every kpix
+void ConFpga::prepCalibConfig ( uint channel, uint dac ) {
+   for (uint i=0; i < kpixCount; i++)
+      ((KpixAsic*)(device("kpixAsic",i)))->prepCalibConfig(channel,dac);
+}
+
+// Method to write calibration configuration
+void ConFpga::writeCalibConfig ( uint channel, uint dac, bool verify ) {
+
+   REGISTER_LOCK
+
+   getVariable("RunMode")->set("Calibrate");
+   getRegister("TriggerControl")->set(getVariable("RunMode")->getInt(),4,0x1);
+   writeRegister(getRegister("TriggerControl"),false);
+
+   REGISTER_UNLOCK
+
+   // Sub devices, dummy kpix included
+   for (uint i=0; i < kpixCount; i++)
+      ((KpixAsic*)(device("kpixAsic",i)))->writeCalibConfig(channel,dac,verify);
 }
 
 // Verify hardware state of configuration
@@ -17,6 +17,7 @@
 #define __CON_FPGA_H__
 
 #include <Device.h>
+#include <vector>
 using namespace std;
 
 //! Class to contain APV25 
@@ -25,6 +26,15 @@ class ConFpga : public Device {
       // Number of kpix devices
       unsigned int kpixCount;
 
+      // Broadcast copies of kpix configuration registers
+      vector<Register *> kpixBcast_;
+
+      // Comm link maps KPIX_BCAST_ADDR to the broadcast header bit
+      bool bcastLink_;
+
+      // Write kpix configuration, registers with the same value in every kpix are broadcast
+      void writeKpixConfig ( bool force );
+
    public:
 
       //! Constructor
@@ -38,6 +48,15 @@ class ConFpga : public Device {
       //! Deconstructor
       ~ConFpga ( );
 
+      //! Method to allow kpix register broadcast
+      /*! 
+       * KpixBroadcast is refused unless the comm link maps the KPIX_BCAST_ADDR
+       * flag to the broadcast header bit. UdpLink sends the raw address, where
+       * the flag selects a kpix which does not exist.
+       * \param capable Comm link can broadcast
+      */
+      void setBroadcastLink ( bool capable );
+
       //! Method to process a command
       /*!
        * Returns status string if locally processed. Otherwise
@@ -66,6 +85,25 @@ class ConFpga : public Device {
       */
       void writeConfig ( bool force );
 
+      //! Method to prepare calibration configuration of every kpix
+      /*! 
+       * See KpixAsic::prepCalibConfig.
+       * \param channel Calibration channel
+       * \param dac     Calibration DAC value
+      */
+      void prepCalibConfig ( uint channel, uint dac );
+
+      //! Method to write calibration configuration
+      /*! 
+       * Sets calibrate run mode and writes the calibration configuration
+       * of every kpix, see KpixAsic::writeCalibConfig.
+       * Throws string on error.
+       * \param channel Calibration channel
+       * \param dac     Calibration DAC value
+       * \param verify  Read back calibration registers
+      */
+      void writeCalibConfig ( uint channel, uint dac, bool verify );
+
       //! Verify hardware state of configuration
       void verifyConfig ( );
 
@@ -23,6 +23,64 @@
 #include <iomanip>
 using namespace std;
 
+// Variable to register field table entry
+class KpixAsicFieldDef {
+   public:
+      const char *var;
+      uint        reg;
+      uint        bit;
+      uint        mask;
+};
+
+// Fields copied directly from variables by writeConfig
+static const KpixAsicFieldDef fieldDefs[] = {
+   { "CfgAutoReadDisable",   KPIX_REG_CONFIG,      2, 0x1    },
+   { "CfgForceTemp",         KPIX_REG_CONFIG,      3, 0x1    },
+   { "CfgDisableTemp",       KPIX_REG_CONFIG,      4, 0x1    },
+   { "CfgAutoStatusReadEn",  KPIX_REG_CONFIG,      5, 0x1    },
+   { "TimeResetOn",          KPIX_REG_TIMER_A,     0, 0xFFFF },
+   { "TimeResetOff",         KPIX_REG_TIMER_A,    16, 0xFFFF },
+   { "TimeOffsetNullOff",    KPIX_REG_TIMER_B,     0, 0xFFFF },
+   { "TimeLeakageNullOff",   KPIX_REG_TIMER_B,    16, 0xFFFF },
+   { "TimePowerUpOn",        KPIX_REG_TIMER_C,     0, 0xFFFF },
+   { "TimeThreshOff",        KPIX_REG_TIMER_C,    16, 0xFFFF },
+   { "BunchClockCount",      KPIX_REG_TIMER_E,     0, 0xFFFF },
+   { "TimePowerUpOn",        KPIX_REG_TIMER_E,    16, 0xFFFF },
+   { "TimeDeselDelay",       KPIX_REG_TIMER_F,     0, 0xFF   },
+   { "TimeBunchClkDelay",    KPIX_REG_TIMER_F,     8, 0xFFFF },
+   { "TimeDigitizeDelay",    KPIX_REG_TIMER_F,    24, 0xFF   },
+   { "Cal0Delay",            KPIX_REG_CAL_DELAY0,  0, 0x1FFF },
+   { "Cal1Delay",            KPIX_REG_CAL_DELAY0, 16, 0x1FFF },
+   { "Cal2Delay",            KPIX_REG_CAL_DELAY1,  0, 0x1FFF },
+   { "Cal3Delay",            KPIX_REG_CAL_DELAY1, 16, 0x1FFF },
+   { "CntrlDisPerReset",     KPIX_REG_CONTROL,     0, 0x1    },
+   { "CntrlEnDcReset",       KPIX_REG_CONTROL,     1, 0x1    },
+   { "CntrlHighGain",        KPIX_REG_CONTROL,     2, 0x1    },
+   { "CntrlNearNeighbor",    KPIX_REG_CONTROL,     3, 0x1    },
+   { "CntrlHoldTime",        KPIX_REG_CONTROL,     8, 0x7    },
+   { "CntrlCalibHigh",       KPIX_REG_CONTROL,    11, 0x1    },
+   { "CntrlShortIntEn",      KPIX_REG_CONTROL,    12, 0x1    },
+   { "CntrlForceLowGain",    KPIX_REG_CONTROL,    13, 0x1    },
+   { "CntrlLeakNullDisable", KPIX_REG_CONTROL,    14, 0x1    },
+   { "CntrlPolarity",        KPIX_REG_CONTROL,    15, 0x1    },
+   { "CntrlTrigDisable",     KPIX_REG_CONTROL,    16, 0x1    },
+   { "CntrlDisPwrCycle",     KPIX_REG_CONTROL,    24, 0x1    },
+   { "CntrlDiffTime",        KPIX_REG_CONTROL,    28, 0x3    },
+   { NULL,                   0,                    0, 0      }
+};
+
+// Dac variables, order of dac registers
+static const char *dacNames[] = {
+   "DacPreThresholdA", "DacPreThresholdB", "DacRampThresh",  "DacRangeThreshold", "DacCalibration",
+   "DacEventThreshold", "DacShaperBias",   "DacDefaultAnalog", "DacThresholdA",   "DacThresholdB"
+};
+
+// Dac voltage feedback variables, order of dac registers
+static const char *dacVoltNames[] = {
+   "DacPreThresholdAVolt",     "DacPreThresholdBVolt", "DacRampThreshVolt",    "DacRangeThresholdVolt", "DacCalibrationVolt",
+   "DacEventThresholdVoltage", "DacShaperBiasVolt",    "DacDefaultAnalogVolt", "DacThresholdAVolt",     "DacThresholdBVolt"
+};
+
 // Function to convert dac value into a voltage
 double KpixAsic::dacToVolt(uint dac) {
    double       volt;
@@ -73,6 +131,11 @@ KpixAsic::KpixAsic ( uint destination, uint baseAddress, uint index, bool dummy,
    desc_    = "Kpix ASIC Object.";
    dummy_   = dummy;
 
+   // No calibration registers prepared
+   calChannel_  = 0;
+   calDac_      = 0;
+   calPrepared_ = false;
+
    // Version value
    addVariable(new Variable("Version", Variable::Configuration));
    getVariable("Version")->setDescription("KPIX Version");
@@ -456,6 +519,9 @@ KpixAsic::KpixAsic ( uint destination, uint baseAddress, uint index, bool dummy,
    }
 
    if ( ! dummy ) getVariable("Enabled")->set("False");
+
+   // Index tables for writeConfig
+   compileMap();
 }
 
 // Deconstructor
@@ -491,6 +557,10 @@ void KpixAsic::readConfig ( ) {
 
    REGISTER_LOCK
 
+   // Hardware state is read back, write everything next time
+   clearShadow();
+   calPrepared_ = false;
+
    // Get acquistion clock rate
    clkPeriod = (parent_->getInt("ClkPeriodAcq") + 1) * 10;
 
@@ -715,39 +785,161 @@ void KpixAsic::readConfig ( ) {
    REGISTER_UNLOCK
 }
 
-// Method to write configuration registers
-void KpixAsic::writeConfig ( bool force ) {
+// Compile variable to register map
+void KpixAsic::compileMap ( ) {
+   stringstream  tmp;
+   KpixAsicField field;
+   uint          x;
+   uint          y;
+
+   // Registers by index
+   reg_[KPIX_REG_CONFIG]     = getRegister("Config");
+   reg_[KPIX_REG_TIMER_A]    = getRegister("TimerA");
+   reg_[KPIX_REG_TIMER_B]    = getRegister("TimerB");
+   reg_[KPIX_REG_TIMER_C]    = getRegister("TimerC");
+   reg_[KPIX_REG_TIMER_D]    = getRegister("TimerD");
+   reg_[KPIX_REG_TIMER_E]    = getRegister("TimerE");
+   reg_[KPIX_REG_TIMER_F]    = getRegister("TimerF");
+   reg_[KPIX_REG_CAL_DELAY0] = getRegister("CalDelay0");
+   reg_[KPIX_REG_CAL_DELAY1] = getRegister("CalDelay1");
+   reg_[KPIX_REG_CONTROL]    = getRegister("Control");
+
+   for (x=0; x < 10; x++) {
+      tmp.str("");
+      tmp << "Dac" << dec << x;
+      reg_[KPIX_REG_DAC+x] = getRegister(tmp.str());
+   }
+
+   for (x=0; x < 32; x++) {
+      tmp.str("");
+      tmp << "ChanModeA_0x" << setw(2) << setfill('0') << hex << x;
+      reg_[KPIX_REG_MODE_A+x] = getRegister(tmp.str());
+      tmp.str("");
+      tmp << "ChanModeB_0x" << setw(2) << setfill('0') << hex << x;
+      reg_[KPIX_REG_MODE_B+x] = getRegister(tmp.str());
+
+      tmp.str("");
+      tmp << "Chan_" << setw(4) << setfill('0') << dec << (x*32);
+      tmp << "_"     << setw(4) << setfill('0') << dec << ((x*32)+31);
+      chanVar_[x]   = getVariable(tmp.str());
+      chanValid_[x] = false;
+   }
+
+   // Variables with special encoding
+   var_[KpixVarVersion]        = getVariable("Version");
+   var_[KpixVarEnabled]        = getVariable("Enabled");
+   var_[KpixVarTrigInhibitOff] = getVariable("TrigInhibitOff");
+   var_[KpixVarBunchClkDelay]  = getVariable("TimeBunchClkDelay");
+   var_[KpixVarCalCount]       = getVariable("CalCount");
+   var_[KpixVarCalSource]      = getVariable("CntrlCalSource");
+   var_[KpixVarForceTrig]      = getVariable("CntrlForceTrigSource");
+   var_[KpixVarFeCurr]         = getVariable("CntrlFeCurr");
+   var_[KpixVarMonSource]      = getVariable("CntrlMonSource");
+   var_[KpixVarPolarity]       = getVariable("CntrlPolarity");
+   var_[KpixVarDisPwrCycle]    = getVariable("CntrlDisPwrCycle");
+
+   // Direct fields
+   field_.clear();
+   for (x=0; fieldDefs[x].var != NULL; x++) {
+      field.var  = getVariable(fieldDefs[x].var);
+      field.reg  = fieldDefs[x].reg;
+      field.bit  = fieldDefs[x].bit;
+      field.mask = fieldDefs[x].mask;
+      field_.push_back(field);
+   }
+
+   // Each dac value is repeated in all four bytes of its register
+   for (x=0; x < 10; x++) {
+      for (y=0; y < 4; y++) {
+         field.var  = getVariable(dacNames[x]);
+         field.reg  = KPIX_REG_DAC + x;
+         field.bit  = y * 8;
+         field.mask = 0xFF;
+         field_.push_back(field);
+      }
+   }
+
+   // Nothing written yet
+   for (x=0; x < KPIX_REG_COUNT; x++) {
+      shadow_[x]  = 0;
+      pending_[x] = false;
+   }
+   clearShadow();
+   shadowEnabled_ = false;
+   fbClkPeriod_   = 0;
+}
+
+// Forget written values, all registers are written next time
+void KpixAsic::clearShadow ( ) {
+   uint x;
+
+   for (x=0; x < KPIX_REG_COUNT; x++) shadowValid_[x] = false;
+   fbValid_ = false;
+}
+
+// Forget written values when device is enabled or disabled
+void KpixAsic::checkEnabled ( ) {
+   bool enabled;
+
+   enabled = (var_[KpixVarEnabled]->getInt() == 1);
+   if ( enabled != shadowEnabled_ ) clearShadow();
+   shadowEnabled_ = enabled;
+}
+
+// Write register if its value differs from the last written value
+void KpixAsic::writeShadow ( uint idx, bool force ) {
+   if ( force || !shadowValid_[idx] || reg_[idx]->get() != shadow_[idx] ) {
+      writeRegister(reg_[idx],true);
+      shadow_[idx]      = reg_[idx]->get();
+      shadowValid_[idx] = true;
+   }
+}
+
+// Charge string for calibration dac
+string KpixAsic::chargeString ( uint dac, bool positive ) {
    stringstream tmp;
-   stringstream regA;
-   stringstream regB;
-   stringstream varName;
-   string       varOld;
-   string       varNew;
-   string       varTmp;
-   uint         val;
-   uint         col;
-   uint         row;
-   uint         x;
-   uint         calCount;
-   bool         dacStale;
-   uint         clkPeriod;
 
-   REGISTER_LOCK
+   tmp.str("");
+   if ( positive ) {
+      tmp << ((2.5 - dacToVolt(dac)) * 200e-15);
+      tmp << " / ";
+      tmp << (((2.5 - dacToVolt(dac)) * 200e-15) * 22.0);
+   }
+   else {
+      tmp << (dacToVolt(dac) * 200e-15);
+      tmp << " / ";
+      tmp << ((dacToVolt(dac) * 200e-15) * 22.0);
+   }
+   return(tmp.str());
+}
+
+// Compute register values and pending registers
+void KpixAsic::prepRegisters ( bool force ) {
+   uint   value[KPIX_REG_COUNT];
+   uint   regCount;
+   uint   colCount;
+   string varOld;
+   string varNew;
+   string varTmp;
+   uint   val;
+   uint   col;
+   uint   row;
+   uint   x;
+   uint   calCount;
+   bool   dacStale;
+   bool   timeFb;
+   uint   clkPeriod;
+
+   // Registers are recomputed from variables
+   calPrepared_ = false;
+   checkEnabled();
 
    // Get acquistion clock rate
    clkPeriod = (parent_->getInt("ClkPeriodAcq") + 1) * 10;
 
-   // Config register & variables
-   //getRegister("Config")->set(getVariable("CfgTestDataEn")->getInt(),0,0x1);
-   getRegister("Config")->set(getVariable("CfgAutoReadDisable")->getInt(),2,0x1);
-   getRegister("Config")->set(getVariable("CfgForceTemp")->getInt(),3,0x1);
-   getRegister("Config")->set(getVariable("CfgDisableTemp")->getInt(),4,0x1);
-   getRegister("Config")->set(getVariable("CfgAutoStatusReadEn")->getInt(),5,0x1);
-   writeRegister(getRegister("Config"),force);
-
    // Overwrite some values in kpix version 8
-   if ( getVariable("Version")->getInt() == 8 ) {
-      if ( getVariable("Enabled")->getInt() ) cout << "KpixAsic::writeConfig -> Overwriting version 8 timing registers A, B & F!" << endl;
+   if ( var_[KpixVarVersion]->getInt() == 8 ) {
+      if ( var_[KpixVarEnabled]->getInt() ) cout << "KpixAsic::writeConfig -> Overwriting version 8 timing registers A, B & F!" << endl;
       getVariable("TimeResetOn")->setInt(0x000e);
       getVariable("TimeResetOff")->setInt(0x0960);
       getVariable("TimeOffsetNullOff")->setInt(0x07da);
@@ -757,277 +949,382 @@ void KpixAsic::writeConfig ( bool force ) {
       getVariable("TimeDigitizeDelay")->setInt(0xff);
    }
 
-   // Timing registers
-   getRegister("TimerA")->set(getVariable("TimeResetOn")->getInt(),0,0xFFFF);
-   getRegister("TimerA")->set(getVariable("TimeResetOff")->getInt(),16,0xFFFF);
-   writeRegister(getRegister("TimerA"),force);
+   // Some registers don't exist in dummy
+   if ( dummy_ ) {
+      regCount = KPIX_REG_DAC;
+      colCount = 0;
+   }
+   else {
+      regCount = KPIX_REG_COUNT;
+      colCount = channels() / 32;
+   }
 
-   getRegister("TimerB")->set(getVariable("TimeOffsetNullOff")->getInt(),0,0xFFFF);
-   getRegister("TimerB")->set(getVariable("TimeLeakageNullOff")->getInt(),16,0xFFFF);
-   writeRegister(getRegister("TimerB"),force);
+   // Start from register values, bits without a variable are kept
+   for (x=0; x < regCount; x++) value[x] = reg_[x]->get();
 
-   getRegister("TimerC")->set(getVariable("TimePowerUpOn")->getInt(),0,0xFFFF);
-   getRegister("TimerC")->set(getVariable("TimeThreshOff")->getInt(),16,0xFFFF);
-   writeRegister(getRegister("TimerC"),force);
+   // Direct fields
+   for (x=0; x < field_.size(); x++) {
+      if ( field_[x].reg >= regCount ) continue;
+      value[field_[x].reg] &= ~(field_[x].mask << field_[x].bit);
+      value[field_[x].reg] |= (field_[x].var->getInt() & field_[x].mask) << field_[x].bit;
+   }
 
-   val = (getVariable("TrigInhibitOff")->getInt() * 8) + getVariable("TimeBunchClkDelay")->getInt() + 1;
-   getRegister("TimerD")->set(val);
-   writeRegister(getRegister("TimerD"),force);
+   // Timing
+   value[KPIX_REG_TIMER_D] = (var_[KpixVarTrigInhibitOff]->getInt() * 8) + var_[KpixVarBunchClkDelay]->getInt() + 1;
 
-   getRegister("TimerE")->set(getVariable("BunchClockCount")->getInt(),0,0xFFFF);
-   getRegister("TimerE")->set(getVariable("TimePowerUpOn")->getInt(),16,0xFFFF);
-   writeRegister(getRegister("TimerE"),force);
+   // Calibration enables
+   calCount = var_[KpixVarCalCount]->getInt();
+   value[KPIX_REG_CAL_DELAY0] &= 0x7FFF7FFF;
+   value[KPIX_REG_CAL_DELAY1] &= 0x7FFF7FFF;
+   if ( calCount > 0 ) value[KPIX_REG_CAL_DELAY0] |= 0x00008000;
+   if ( calCount > 1 ) value[KPIX_REG_CAL_DELAY0] |= 0x80000000;
+   if ( calCount > 2 ) value[KPIX_REG_CAL_DELAY1] |= 0x00008000;
+   if ( calCount > 3 ) value[KPIX_REG_CAL_DELAY1] |= 0x80000000;
 
-   getRegister("TimerF")->set(getVariable("TimeDeselDelay")->getInt(),0,0xFF);
-   getRegister("TimerF")->set(getVariable("TimeBunchClkDelay")->getInt(),8,0xFFFF);
-   getRegister("TimerF")->set(getVariable("TimeDigitizeDelay")->getInt(),24,0xFF);
-   writeRegister(getRegister("TimerF"),force);
+   if ( !dummy_ ) {
 
-   // Feedback
-   getVariable("TimeResetOnFb")->set(timeString(clkPeriod,getVariable("TimeResetOn")->getInt()));
-   getVariable("TimeResetOffFb")->set(timeString(clkPeriod,getVariable("TimeResetOff")->getInt()));
-   getVariable("TimeOffsetNullOffFb")->set(timeString(clkPeriod,getVariable("TimeOffsetNullOff")->getInt()));
-   getVariable("TimeLeakageNullOffFb")->set(timeString(clkPeriod,getVariable("TimeLeakageNullOff")->getInt()));
-   getVariable("TimeDeselDelayFb")->set(timeString(clkPeriod,getVariable("TimeDeselDelay")->getInt()));
-   getVariable("TimeBunchClkDelayFb")->set(timeString(clkPeriod,getVariable("TimeBunchClkDelay")->getInt()));
-   getVariable("TimeDigitizeDelayFb")->set(timeString(clkPeriod,getVariable("TimeDigitizeDelay")->getInt()));
-   getVariable("TimePowerUpOnFb")->set(timeString(clkPeriod,getVariable("TimePowerUpOn")->getInt()));
-   getVariable("TimeThreshOffFb")->set(timeString(clkPeriod,getVariable("TimeThreshOff")->getInt()));
+      // Control sources
+      val = var_[KpixVarCalSource]->getInt();
+      value[KPIX_REG_CONTROL] &= ~0x00000050;
+      if ( val == 1 ) value[KPIX_REG_CONTROL] |= 0x00000040;
+      if ( val == 2 ) value[KPIX_REG_CONTROL] |= 0x00000010;
 
-   // Calibration control registers & variables
-   getRegister("CalDelay0")->set(getVariable("Cal0Delay")->getInt(),0,0x1FFF);
-   getRegister("CalDelay0")->set(getVariable("Cal1Delay")->getInt(),16,0x1FFF);
-   getRegister("CalDelay1")->set(getVariable("Cal2Delay")->getInt(),0,0x1FFF);
-   getRegister("CalDelay1")->set(getVariable("Cal3Delay")->getInt(),16,0x1FFF);
-
-   calCount = getVariable("CalCount")->getInt();
-   getRegister("CalDelay0")->set((calCount>0)?1:0,15,0x1);
-   getRegister("CalDelay0")->set((calCount>1)?1:0,31,0x1);
-   getRegister("CalDelay1")->set((calCount>2)?1:0,15,0x1);
-   getRegister("CalDelay1")->set((calCount>3)?1:0,31,0x1);
-   writeRegister(getRegister("CalDelay0"),force);
-   writeRegister(getRegister("CalDelay1"),force);
+      val = var_[KpixVarForceTrig]->getInt();
+      value[KPIX_REG_CONTROL] &= ~0x000000A0;
+      if ( val == 1 ) value[KPIX_REG_CONTROL] |= 0x00000080;
+      if ( val == 2 ) value[KPIX_REG_CONTROL] |= 0x00000020;
+
+      // bit order of FeCurr is reversed
+      val = var_[KpixVarFeCurr]->getInt();
+      value[KPIX_REG_CONTROL] &= ~0x0E000000;
+      value[KPIX_REG_CONTROL] |= ((val   )&0x1) << 27;
+      value[KPIX_REG_CONTROL] |= ((val>>1)&0x1) << 26;
+      value[KPIX_REG_CONTROL] |= ((val>>2)&0x1) << 25;
+
+      val = var_[KpixVarMonSource]->getInt();
+      value[KPIX_REG_CONTROL] &= ~0xC0000000;
+      if ( val == 2 ) value[KPIX_REG_CONTROL] |= 0x40000000;
+      if ( val == 1 ) value[KPIX_REG_CONTROL] |= 0x80000000;
+
+      // Calibration mask registers, strings are only parsed when changed
+      for (col=0; col < colCount; col++) {
+         varTmp = chanVar_[col]->get();
+
+         if ( !chanValid_[col] || varTmp != chanLast_[col] ) {
+            varOld = "";
+            varNew = "";
+            chanA_[col] = 0;
+            chanB_[col] = 0;
+
+            // Remove whitespace
+            for (x=0; x < varTmp.length(); x++) 
+               if ( varTmp[x] != ' ' ) varOld.append(1,varTmp[x]);
+
+            // Pad if less than 32
+            while ( varOld.length() < 32 ) varOld.append("D");
+
+            // Process variables
+            for (row=0; row < 32; row++) {
+               if ( (row != 0) && ((row % 8) == 0) ) varNew.append(" ");
+               switch(varOld[row]) {
+                  case 'B':
+                     varNew.append("B");
+                     break;
+                  case 'C':
+                     chanB_[col] |= (0x1u << row);
+                     chanA_[col] |= (0x1u << row);
+                     varNew.append("C");
+                     break;
+                  case 'A':
+                     chanB_[col] |= (0x1u << row);
+                     varNew.append("A");
+                     break;
+                  default : 
+                     chanA_[col] |= (0x1u << row);
+                     varNew.append("D");
+                     break;
+               }
+            }
+            chanVar_[col]->set(varNew);
+            chanLast_[col]  = varNew;
+            chanValid_[col] = true;
+         }
+         value[KPIX_REG_MODE_A+col] = chanA_[col];
+         value[KPIX_REG_MODE_B+col] = chanB_[col];
+      }
+   }
+
+   // Feedback, only for changed values
+   timeFb = (!fbValid_ || clkPeriod != fbClkPeriod_);
+   for (x=KPIX_REG_TIMER_A; x <= KPIX_REG_TIMER_F; x++) if ( value[x] != fbValue_[x] ) timeFb = true;
+
+   if ( timeFb ) {
+      getVariable("TimeResetOnFb")->set(timeString(clkPeriod,getVariable("TimeResetOn")->getInt()));
+      getVariable("TimeResetOffFb")->set(timeString(clkPeriod,getVariable("TimeResetOff")->getInt()));
+      getVariable("TimeOffsetNullOffFb")->set(timeString(clkPeriod,getVariable("TimeOffsetNullOff")->getInt()));
+      getVariable("TimeLeakageNullOffFb")->set(timeString(clkPeriod,getVariable("TimeLeakageNullOff")->getInt()));
+      getVariable("TimeDeselDelayFb")->set(timeString(clkPeriod,getVariable("TimeDeselDelay")->getInt()));
+      getVariable("TimeBunchClkDelayFb")->set(timeString(clkPeriod,getVariable("TimeBunchClkDelay")->getInt()));
+      getVariable("TimeDigitizeDelayFb")->set(timeString(clkPeriod,getVariable("TimeDigitizeDelay")->getInt()));
+      getVariable("TimePowerUpOnFb")->set(timeString(clkPeriod,getVariable("TimePowerUpOn")->getInt()));
+      getVariable("TimeThreshOffFb")->set(timeString(clkPeriod,getVariable("TimeThreshOff")->getInt()));
+   }
 
-   // Some registers don't exist in dummy
    if ( !dummy_ ) {
+      for (x=0; x < 10; x++) {
+         if ( !fbValid_ || value[KPIX_REG_DAC+x] != fbValue_[KPIX_REG_DAC+x] )
+            getVariable(dacVoltNames[x])->set(dacToVoltString(value[KPIX_REG_DAC+x] & 0xFF));
+      }
+      if ( !fbValid_ || value[KPIX_REG_DAC+4] != fbValue_[KPIX_REG_DAC+4] || value[KPIX_REG_CONTROL] != fbValue_[KPIX_REG_CONTROL] ) 
+         getVariable("DacCalibrationCharge")->set(chargeString(value[KPIX_REG_DAC+4] & 0xFF,var_[KpixVarPolarity]->get() == "Positive"));
+   }
 
-      // DAC registers and variables
-      val = getVariable("DacPreThresholdA")->getInt();
-      getVariable("DacPreThresholdAVolt")->set(dacToVoltString(val));
-      getRegister("Dac0")->set(val,0,0xFF);
-      getRegister("Dac0")->set(val,8,0xFF);
-      getRegister("Dac0")->set(val,16,0xFF);
-      getRegister("Dac0")->set(val,24,0xFF);
+   for (x=0; x <= KPIX_REG_CONTROL && x < regCount; x++) fbValue_[x] = value[x];
+   fbClkPeriod_ = clkPeriod;
+   fbValid_     = true;
+
+   // Update registers
+   for (x=0; x < regCount; x++) reg_[x]->set(value[x]);
+
+   // Turn front end power on in kpix 9 before writing dacs
+   // Real front end power mode will be updated when control
+   // register is written later
+   dacStale = false;
+   for (x=KPIX_REG_DAC; x < regCount && x < (KPIX_REG_DAC+10); x++) 
+      if ( force || !shadowValid_[x] || value[x] != shadow_[x] ) dacStale = true;
+
+   if ( var_[KpixVarVersion]->getInt() == 9 && dacStale && var_[KpixVarEnabled]->getInt() == 1 ) {
+      cout << "KpixAsic::writeConfig -> Forcing power on for DAC update!" << endl;
+      if ( shadowValid_[KPIX_REG_CONTROL] ) reg_[KPIX_REG_CONTROL]->set(shadow_[KPIX_REG_CONTROL]);
+      reg_[KPIX_REG_CONTROL]->set(1,24,0x1); // Disable power cycle
+      writeRegister(reg_[KPIX_REG_CONTROL],true);
+      reg_[KPIX_REG_CONTROL]->set(value[KPIX_REG_CONTROL]);
+      shadowValid_[KPIX_REG_CONTROL] = false;
+   }
 
-      val = getVariable("DacPreThresholdB")->getInt();
-      getVariable("DacPreThresholdBVolt")->set(dacToVoltString(val));
-      getRegister("Dac1")->set(val,0,0xFF);
-      getRegister("Dac1")->set(val,8,0xFF);
-      getRegister("Dac1")->set(val,16,0xFF);
-      getRegister("Dac1")->set(val,24,0xFF);
+   // Registers which differ from the last written values
+   for (x=0; x < KPIX_REG_COUNT; x++) {
+      pending_[x] = false;
+      if ( x >= regCount ) continue;
 
-      val = getVariable("DacRampThresh")->getInt();
-      getVariable("DacRampThreshVolt")->set(dacToVoltString(val));
-      getRegister("Dac2")->set(val,0,0xFF);
-      getRegister("Dac2")->set(val,8,0xFF);
-      getRegister("Dac2")->set(val,16,0xFF);
-      getRegister("Dac2")->set(val,24,0xFF);
+      // Mode registers of missing columns are not written
+      if ( x >= KPIX_REG_MODE_A && ((x - KPIX_REG_MODE_A) % 32) >= colCount ) continue;
 
-      val = getVariable("DacRangeThreshold")->getInt();
-      getVariable("DacRangeThresholdVolt")->set(dacToVoltString(val));
-      getRegister("Dac3")->set(val,0,0xFF);
-      getRegister("Dac3")->set(val,8,0xFF);
-      getRegister("Dac3")->set(val,16,0xFF);
-      getRegister("Dac3")->set(val,24,0xFF);
+      if ( force || !shadowValid_[x] || value[x] != shadow_[x] ) pending_[x] = true;
+   }
+}
 
-      val = getVariable("DacCalibration")->getInt();
-      getVariable("DacCalibrationVolt")->set(dacToVoltString(val));
-      getRegister("Dac4")->set(val,0,0xFF);
-      getRegister("Dac4")->set(val,8,0xFF);
-      getRegister("Dac4")->set(val,16,0xFF);
-      getRegister("Dac4")->set(val,24,0xFF);
+// Method to write configuration registers
+void KpixAsic::writeConfig ( bool force ) {
+   uint x;
 
-      tmp.str("");
-      if ( getVariable("CntrlPolarity")->get() == "Positive" ) {
-         tmp << ((2.5 - dacToVolt(val)) * 200e-15);
-         tmp << " / ";
-         tmp << (((2.5 - dacToVolt(val)) * 200e-15) * 22.0);
-      }
-      else {
-         tmp << (dacToVolt(val) * 200e-15);
-         tmp << " / ";
-         tmp << ((dacToVolt(val) * 200e-15) * 22.0);
+   REGISTER_LOCK
+
+   prepRegisters(force);
+
+   // Write changed registers in one pass, in address order
+   for (x=0; x < KPIX_REG_COUNT; x++) {
+      if ( pending_[x] ) writeShadow(x,true);
+      pending_[x] = false;
+   }
+
+   REGISTER_UNLOCK
+}
+
+// Method to compute configuration registers without writing them
+void KpixAsic::prepConfig ( bool force ) {
+   REGISTER_LOCK
+   prepRegisters(force);
+   REGISTER_UNLOCK
+}
+
+// Configuration register value
+bool KpixAsic::configValue ( uint idx, uint *value ) {
+   bool ret;
+
+   REGISTER_LOCK
+
+   // Dummy has no dac, control or mode registers
+   if ( idx >= KPIX_REG_COUNT || (dummy_ && idx >= KPIX_REG_DAC) ) ret = false;
+   else if ( idx >= KPIX_REG_MODE_A && ((idx - KPIX_REG_MODE_A) % 32) >= (channels() / 32) ) ret = false;
+   else {
+      *value = reg_[idx]->get();
+      ret    = true;
+   }
+
+   REGISTER_UNLOCK
+   return(ret);
+}
+
+// Configuration register is pending
+bool KpixAsic::configPending ( uint idx ) {
+   bool ret;
+
+   REGISTER_LOCK
+   ret = (idx < KPIX_REG_COUNT && pending_[idx]);
+   REGISTER_UNLOCK
+   return(ret);
+}
+
+// Configuration register address
+uint KpixAsic::configAddress ( uint idx ) {
+   return(reg_[idx]->address());
+}
+
+// Method to write pending configuration register
+void KpixAsic::writePending ( uint idx, bool bcast ) {
+
+   REGISTER_LOCK
+
+   if ( pending_[idx] ) {
+
+      // Broadcast already sent the value
+      if ( bcast ) {
+         shadow_[idx]      = reg_[idx]->get();
+         shadowValid_[idx] = true;
+         verifyRegister(reg_[idx]);
       }
-      getVariable("DacCalibrationCharge")->set(tmp.str());
-      
-      val = getVariable("DacEventThreshold")->getInt();
-      getVariable("DacEventThresholdVoltage")->set(dacToVoltString(val));
-      getRegister("Dac5")->set(val,0,0xFF);
-      getRegister("Dac5")->set(val,8,0xFF);
-      getRegister("Dac5")->set(val,16,0xFF);
-      getRegister("Dac5")->set(val,24,0xFF);
+      else writeShadow(idx,true);
+      pending_[idx] = false;
+   }
 
-      val = getVariable("DacShaperBias")->getInt();
-      getVariable("DacShaperBiasVolt")->set(dacToVoltString(val));
-      getRegister("Dac6")->set(val,0,0xFF);
-      getRegister("Dac6")->set(val,8,0xFF);
-      getRegister("Dac6")->set(val,16,0xFF);
-      getRegister("Dac6")->set(val,24,0xFF);
+   REGISTER_UNLOCK
+}
 
-      val = getVariable("DacDefaultAnalog")->getInt();
-      getVariable("DacDefaultAnalogVolt")->set(dacToVoltString(val));
-      getRegister("Dac7")->set(val,0,0xFF);
-      getRegister("Dac7")->set(val,8,0xFF);
-      getRegister("Dac7")->set(val,16,0xFF);
-      getRegister("Dac7")->set(val,24,0xFF);
+// Method to forget the written value of a configuration register
+void KpixAsic::invalidRegister ( uint idx ) {
 
-      val = getVariable("DacThresholdA")->getInt();
-      getVariable("DacThresholdAVolt")->set(dacToVoltString(val));
-      getRegister("Dac8")->set(val,0,0xFF);
-      getRegister("Dac8")->set(val,8,0xFF);
-      getRegister("Dac8")->set(val,16,0xFF);
-      getRegister("Dac8")->set(val,24,0xFF);
+   REGISTER_LOCK
 
-      val = getVariable("DacThresholdB")->getInt();
-      getVariable("DacThresholdBVolt")->set(dacToVoltString(val));
-      getRegister("Dac9")->set(val,0,0xFF);
-      getRegister("Dac9")->set(val,8,0xFF);
-      getRegister("Dac9")->set(val,16,0xFF);
-      getRegister("Dac9")->set(val,24,0xFF);
-
-      // Determine if dac registers are stale
-      dacStale = force;
-      if ( getRegister("Dac0")->stale() ) dacStale = true;
-      if ( getRegister("Dac1")->stale() ) dacStale = true;
-      if ( getRegister("Dac2")->stale() ) dacStale = true;
-      if ( getRegister("Dac3")->stale() ) dacStale = true;
-      if ( getRegister("Dac4")->stale() ) dacStale = true;
-      if ( getRegister("Dac5")->stale() ) dacStale = true;
-      if ( getRegister("Dac6")->stale() ) dacStale = true;
-      if ( getRegister("Dac7")->stale() ) dacStale = true;
-      if ( getRegister("Dac8")->stale() ) dacStale = true;
-      if ( getRegister("Dac9")->stale() ) dacStale = true;
-
-      // Turn front end power on in kpix 9 before writing dacs
-      // Real front end power mode will be updated when control
-      // register is written later
-      if ( getVariable("Version")->getInt() == 9 && dacStale && getVariable("Enabled")->getInt() == 1 ) {
-         cout << "KpixAsic::writeConfig -> Forcing power on for DAC update!" << endl;
-         getRegister("Control")->set(1,24,0x1); // Disable power cycle
-         writeRegister(getRegister("Control"),true);
+   shadowValid_[idx] = false;
+   pending_[idx]     = false;
+
+   REGISTER_UNLOCK
+}
+
+// Compute staged calibration register values, lock must be held
+void KpixAsic::calibRegisters ( uint channel, uint dac ) {
+   uint col;
+   uint row;
+   uint x;
+
+   // Row column index
+   col = (channel>1023)?32:(channel/32);
+   row = channel%32;
+
+   if ( !dummy_ ) {
+      calValue_[KPIX_REG_DAC+4] = (dac & 0xFF) * 0x01010101;
+
+      // Internal calibration source, internal force trigger, self trigger disabled
+      calValue_[KPIX_REG_CONTROL] = reg_[KPIX_REG_CONTROL]->get();
+      calValue_[KPIX_REG_CONTROL] |= (0x1u << 6) | (0x1u << 7) | (0x1u << 16);
+      calValue_[KPIX_REG_CONTROL] &= ~((0x1u << 4) | (0x1u << 5) | (0x1u << 24));
+      calValue_[KPIX_REG_CONTROL] |= ((var_[KpixVarDisPwrCycle]->getInt() & 0x1) << 24);
+
+      // Disabled channels are A=1, B=0, calibration channel is A=1, B=1
+      for (x=0; x < (channels()/32); x++) {
+         calValue_[KPIX_REG_MODE_B+x] = (col == x)?(0x1u << row):0;
+         calValue_[KPIX_REG_MODE_A+x] = 0xFFFFFFFF;
       }
-  
-      // Now safe to write dac registers
-      writeRegister(getRegister("Dac0"),force);
-      writeRegister(getRegister("Dac1"),force);
-      writeRegister(getRegister("Dac2"),force);
-      writeRegister(getRegister("Dac3"),force);
-      writeRegister(getRegister("Dac4"),force);
-      writeRegister(getRegister("Dac5"),force);
-      writeRegister(getRegister("Dac6"),force);
-      writeRegister(getRegister("Dac7"),force);
-      writeRegister(getRegister("Dac8"),force);
-      writeRegister(getRegister("Dac9"),force);
+   }
 
-      // Control register and variables
-      getRegister("Control")->set(getVariable("CntrlDisPerReset")->getInt(),0,0x1);
-      getRegister("Control")->set(getVariable("CntrlEnDcReset")->getInt(),1,0x1);
-      getRegister("Control")->set(getVariable("CntrlHighGain")->getInt(),2,0x1);
-      getRegister("Control")->set(getVariable("CntrlNearNeighbor")->getInt(),3,0x1);
-
-      val = getVariable("CntrlCalSource")->getInt();
-      getRegister("Control")->set((val==1)?1:0,6,0x1);
-      getRegister("Control")->set((val==2)?1:0,4,0x1);
-
-      val = getVariable("CntrlForceTrigSource")->getInt();
-      getRegister("Control")->set((val==1)?1:0,7,0x1);
-      getRegister("Control")->set((val==2)?1:0,5,0x1);
-
-      getRegister("Control")->set(getVariable("CntrlHoldTime")->getInt(),8,0x7);
-      getRegister("Control")->set(getVariable("CntrlCalibHigh")->getInt(),11,0x1);
-      getRegister("Control")->set(getVariable("CntrlShortIntEn")->getInt(),12,0x1);
-      getRegister("Control")->set(getVariable("CntrlForceLowGain")->getInt(),13,0x1);
-      getRegister("Control")->set(getVariable("CntrlLeakNullDisable")->getInt(),14,0x1);
-      getRegister("Control")->set(getVariable("CntrlPolarity")->getInt(),15,0x1);
-      getRegister("Control")->set(getVariable("CntrlTrigDisable")->getInt(),16,0x1);
-      getRegister("Control")->set(getVariable("CntrlDisPwrCycle")->getInt(),24,0x1);
+   calChannel_  = channel;
+   calDac_      = dac;
+   calPrepared_ = true;
+}
 
-      // bit order of FeCurr is reversed
-      val = getVariable("CntrlFeCurr")->getInt();
-      getRegister("Control")->set(((val   )&0x1),27,0x1);
-      getRegister("Control")->set(((val>>1)&0x1),26,0x1);
-      getRegister("Control")->set(((val>>2)&0x1),25,0x1);
+// Method to prepare calibration configuration
+void KpixAsic::prepCalibConfig ( uint channel, uint dac ) {
 
-      getRegister("Control")->set(getVariable("CntrlDiffTime")->getInt(),28,0x3);
+   REGISTER_LOCK
 
-      val = getVariable("CntrlMonSource")->getInt();
-      getRegister("Control")->set((val==2)?1:0,30,0x1);
-      getRegister("Control")->set((val==1)?1:0,31,0x1);
+   calibRegisters(channel,dac);
 
-      writeRegister(getRegister("Control"),force);
+   REGISTER_UNLOCK
+}
 
-      // Calibration Mask Registers
-      for (col=0; col < (channels()/32); col++) {
-         regA.str("");
-         regA << "ChanModeA_0x" << setw(2) << setfill('0') << hex << col;
-         regB.str("");
-         regB << "ChanModeB_0x" << setw(2) << setfill('0') << hex << col;
+// Method to write calibration configuration
+void KpixAsic::writeCalibConfig ( uint channel, uint dac, bool verify ) {
+   string modeString;
+   uint   col;
+   uint   row;
+   uint   x;
+   bool   dacStale;
 
-         varName.str("");
-         varName << "Chan_" << setw(4) << setfill('0') << dec << (col*32);
-         varName << "_"     << setw(4) << setfill('0') << dec << ((col*32)+31);
-         varTmp = getVariable(varName.str())->get();
-         varNew = "";
-
-         // Remove whitespace
-         row = 0;
-         for (x=0; x < varTmp.length(); x++) 
-            if ( varTmp[x] != ' ' ) {
-               varOld.append(" ");
-               varOld[row++] = varTmp[x];
-            }
+   REGISTER_LOCK
 
-         // Pad if less than 32
-         for (; row < 32; row++) varOld.append("D");
+   // Row column index
+   col = (channel>1023)?32:(channel/32);
+   row = channel%32;
 
-         // Process variables
-         for (row=0; row < 32; row++) {
-            if ( (row != 0) && ((row % 8) == 0) ) varNew.append(" ");
-            switch(varOld[row]) {
-               case 'B':
-                  getRegister(regB.str())->set(0,row,0x1);
-                  getRegister(regA.str())->set(0,row,0x1);
-                  varNew.append("B");
-                  break;
-               case 'D':
-                  getRegister(regB.str())->set(0,row,0x1);
-                  getRegister(regA.str())->set(1,row,0x1);
-                  varNew.append("D");
-                  break;
-               case 'C':
-                  getRegister(regB.str())->set(1,row,0x1);
-                  getRegister(regA.str())->set(1,row,0x1);
-                  varNew.append("C");
-                  break;
-               case 'A':
-                  getRegister(regB.str())->set(1,row,0x1);
-                  getRegister(regA.str())->set(0,row,0x1);
-                  varNew.append("A");
-                  break;
-               default : 
-                  getRegister(regB.str())->set(0,row,0x1);
-                  getRegister(regA.str())->set(1,row,0x1);
-                  varNew.append("D");
-                  break;
-            }
-         }
+   checkEnabled();
+
+   // Stage register values unless already prepared
+   if ( !calPrepared_ || calChannel_ != channel || calDac_ != dac ) calibRegisters(channel,dac);
+
+   // Same values as the calibration xml previously passed to parseXml
+   var_[KpixVarCalSource]->set("Internal");
+   var_[KpixVarForceTrig]->set("Internal");
+   getVariable("CntrlTrigDisable")->set("True");
+   getVariable("DacCalibration")->setInt(dac);
+
+   // Channel mode variables, dummy has no registers to normalize the string
+   for (x=0; x < 32; x++) {
+      if ( dummy_ ) {
+         modeString = "DDDDDDDDDDDDDDDDDDDDDDDDDDDDDDDD";
+         if ( col == x ) modeString[row] = 'C';
+      }
+      else {
+         modeString = "DDDDDDDD DDDDDDDD DDDDDDDD DDDDDDDD";
+         if ( col == x ) modeString[row+(row/8)] = 'C';
+      }
+      chanVar_[x]->set(modeString);
+   }
+
+   // Only dac, control and mode registers are touched
+   if ( !dummy_ ) {
+      getVariable("DacCalibrationVolt")->set(dacToVoltString(dac));
+      getVariable("DacCalibrationCharge")->set(chargeString(dac,var_[KpixVarPolarity]->get() == "Positive"));
+
+      // Staged values become the register values now that they are written
+      reg_[KPIX_REG_DAC+4]->set(calValue_[KPIX_REG_DAC+4]);
+      reg_[KPIX_REG_CONTROL]->set(calValue_[KPIX_REG_CONTROL]);
+      for (x=0; x < (channels()/32); x++) {
+         reg_[KPIX_REG_MODE_B+x]->set(calValue_[KPIX_REG_MODE_B+x]);
+         reg_[KPIX_REG_MODE_A+x]->set(calValue_[KPIX_REG_MODE_A+x]);
+      }
+
+      // Turn front end power on in kpix 9 before writing dacs, see writeConfig
+      dacStale = (!shadowValid_[KPIX_REG_DAC+4] || reg_[KPIX_REG_DAC+4]->get() != shadow_[KPIX_REG_DAC+4]);
+      if ( var_[KpixVarVersion]->getInt() == 9 && dacStale && var_[KpixVarEnabled]->getInt() == 1 ) {
+         cout << "KpixAsic::writeCalibConfig -> Forcing power on for DAC update!" << endl;
+         reg_[KPIX_REG_CONTROL]->set(1,24,0x1); // Disable power cycle
+         writeShadow(KPIX_REG_CONTROL,true);
+         reg_[KPIX_REG_CONTROL]->set(var_[KpixVarDisPwrCycle]->getInt(),24,0x1);
+      }
+      writeShadow(KPIX_REG_DAC+4,false);
+      writeShadow(KPIX_REG_CONTROL,false);
 
-         writeRegister(getRegister(regB.str()),force);
-         writeRegister(getRegister(regA.str()),force);
-         getVariable(varName.str())->set(varNew);
+      for (x=0; x < (channels()/32); x++) {
+         writeShadow(KPIX_REG_MODE_B+x,false);
+         writeShadow(KPIX_REG_MODE_A+x,false);
+      }
+
+      // Read back what the calibration channel depends on
+      if ( verify ) {
+         verifyRegister(reg_[KPIX_REG_DAC+4]);
+         verifyRegister(reg_[KPIX_REG_CONTROL]);
+
+         if ( col < (channels()/32) ) {
+            verifyRegister(reg_[KPIX_REG_MODE_B+col]);
+            verifyRegister(reg_[KPIX_REG_MODE_A+col]);
+         }
       }
    }
 
+   // Mode strings and registers now follow the calibration values
+   for (x=0; x < 32; x++) chanValid_[x] = false;
+
    REGISTER_UNLOCK
 }
 
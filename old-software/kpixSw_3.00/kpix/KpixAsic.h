@@ -17,8 +17,37 @@
 #define __KPIX_ASIC_H__
 
 #include <Device.h>
+#include <vector>
 using namespace std;
 
+// Configuration register indices, in address order
+#define KPIX_REG_CONFIG      0
+#define KPIX_REG_TIMER_A     1
+#define KPIX_REG_TIMER_B     2
+#define KPIX_REG_TIMER_C     3
+#define KPIX_REG_TIMER_D     4
+#define KPIX_REG_TIMER_E     5
+#define KPIX_REG_TIMER_F     6
+#define KPIX_REG_CAL_DELAY0  7
+#define KPIX_REG_CAL_DELAY1  8
+#define KPIX_REG_DAC         9
+#define KPIX_REG_CONTROL     19
+#define KPIX_REG_MODE_A      20
+#define KPIX_REG_MODE_B      52
+#define KPIX_REG_COUNT       84
+
+// Broadcast flag of kpix register writes, sent as the 0x0800 header bit
+#define KPIX_BCAST_ADDR      0x00008000
+
+//! Variable field of a configuration register
+class KpixAsicField {
+   public:
+      Variable *var;
+      uint     reg;
+      uint     bit;
+      uint     mask;
+};
+
 //! Class to contain Kpix ASIC
 class KpixAsic : public Device {
 
@@ -28,6 +57,46 @@ class KpixAsic : public Device {
       // Kpix version
       uint version_;
 
+      // Variables with special encoding, index of var_
+      enum KpixAsicVar {
+         KpixVarVersion, KpixVarEnabled, KpixVarTrigInhibitOff, KpixVarBunchClkDelay,
+         KpixVarCalCount, KpixVarCalSource, KpixVarForceTrig, KpixVarFeCurr,
+         KpixVarMonSource, KpixVarPolarity, KpixVarDisPwrCycle, KpixVarCount
+      };
+
+      // Compiled register map
+      Register              *reg_[KPIX_REG_COUNT];
+      Variable              *var_[KpixVarCount];
+      vector<KpixAsicField> field_;
+
+      // Last written register values
+      uint shadow_[KPIX_REG_COUNT];
+      bool shadowValid_[KPIX_REG_COUNT];
+      bool shadowEnabled_;
+
+      // Registers computed but not yet written
+      bool pending_[KPIX_REG_COUNT];
+
+      // Register values and clock period of feedback variables
+      uint fbValue_[KPIX_REG_CONTROL+1];
+      uint fbClkPeriod_;
+      bool fbValid_;
+
+      // Channel mode strings and their mode register values
+      Variable *chanVar_[32];
+      string   chanLast_[32];
+      uint     chanA_[32];
+      uint     chanB_[32];
+      bool     chanValid_[32];
+
+      // Calibration channel and dac of the staged register values
+      uint calChannel_;
+      uint calDac_;
+      bool calPrepared_;
+
+      // Calibration register values, staged until writeCalibConfig copies them to reg_
+      uint calValue_[KPIX_REG_COUNT];
+
       // Time value to use for timing calculations
       static const uint KpixAcqPeriod = 50;
 
@@ -40,6 +109,27 @@ class KpixAsic : public Device {
       // Function to time value to string
       static string timeString(uint period, uint value);
 
+      // Function to convert calibration dac value to charge string
+      static string chargeString(uint dac, bool positive);
+
+      // Compile variable to register map
+      void compileMap ( );
+
+      // Forget written values, all registers are written next time
+      void clearShadow ( );
+
+      // Forget written values when device is enabled or disabled
+      void checkEnabled ( );
+
+      // Write register if its value differs from the last written value, lock must be held
+      void writeShadow ( uint idx, bool force );
+
+      // Compute register values and pending registers, lock must be held
+      void prepRegisters ( bool force );
+
+      // Compute staged calibration register values, lock must be held
+      void calibRegisters ( uint channel, uint dac );
+
    public:
 
       //! Constructor
@@ -70,10 +160,86 @@ class KpixAsic : public Device {
       //! Method to write configuration registers
       /*! 
        * Throws string on error.
-       * \param force Write all registers if true, only stale if false
+       * Register values are computed through the compiled variable map and
+       * only registers which differ from the last written values are sent,
+       * in a single pass.
+       * \param force Write all registers if true, only changed if false
       */
       void writeConfig ( bool force );
 
+      //! Method to compute configuration registers without writing them
+      /*! 
+       * Computes register values as writeConfig does and marks the registers
+       * which differ from the last written values as pending. Pending
+       * registers are sent with writePending.
+       * Throws string on error.
+       * \param force Mark all registers pending if true, only changed if false
+      */
+      void prepConfig ( bool force );
+
+      //! Configuration register value
+      /*! 
+       * Returns false if the register is not used by this kpix.
+       * \param idx   Register index
+       * \param value Register value
+      */
+      bool configValue ( uint idx, uint *value );
+
+      //! Configuration register is pending
+      /*! 
+       * \param idx Register index
+      */
+      bool configPending ( uint idx );
+
+      //! Configuration register address
+      /*! 
+       * \param idx Register index
+      */
+      uint configAddress ( uint idx );
+
+      //! Method to write pending configuration register
+      /*! 
+       * Throws string on error.
+       * \param idx   Register index
+       * \param bcast Register was written by broadcast, mark it written and verify
+      */
+      void writePending ( uint idx, bool bcast );
+
+      //! Method to forget the written value of a configuration register
+      /*! 
+       * Used when a broadcast overwrote the register without this kpix
+       * taking part, the register is rewritten on the next write.
+       * \param idx Register index
+      */
+      void invalidRegister ( uint idx );
+
+      //! Method to prepare calibration configuration
+      /*! 
+       * Computes the DAC, control and channel mode register values for
+       * the passed calibration channel and dac into a staging area without
+       * touching the register values, so verifyConfig and readConfig still
+       * see the last written configuration. A following writeCalibConfig with
+       * the same values only has to send the changed registers.
+       * Channel values above 1023 disable all channels.
+       * \param channel Calibration channel
+       * \param dac     Calibration DAC value
+      */
+      void prepCalibConfig ( uint channel, uint dac );
+
+      //! Method to write calibration configuration
+      /*! 
+       * Enables internal calibration and forced trigger, disables self
+       * trigger, sets the calibration DAC and marks the passed channel for
+       * calibration with all other channels disabled. The variables are
+       * updated directly and only the DAC, control and channel mode registers
+       * are written if stale.
+       * Throws string on error.
+       * \param channel Calibration channel
+       * \param dac     Calibration DAC value
+       * \param verify  Read back DAC, control and calibration channel mode registers
+      */
+      void writeCalibConfig ( uint channel, uint dac, bool verify );
+
       //! Verify hardware state of configuration
       void verifyConfig ( );
 
@@ -16,160 +16,434 @@
 #include <iostream>
 #include <iomanip>
 #include <sstream>
-#include <fstream>
 #include <string>
 #include <string.h>
 #include <stdlib.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include "KpixCalibRead.h"
 using namespace std;
 
 // Calib Data Class Constructor
 KpixCalibRead::KpixCalibRead ( ) {
    xmlInitParser();
-   asicList_.clear();  
+   asicData_.clear();
+   asicMap_.clear();
+   cacheMap_  = NULL;
+   cacheSize_ = 0;
 }
 
 // Calib Data Class DecConstructor
 KpixCalibRead::~KpixCalibRead ( ) {
+   uint x;
+
+   for (x=0; x < asicData_.size(); x++) delete asicData_[x];
+   asicData_.clear();
+   asicMap_.clear();
+
+   if ( cacheMap_ != NULL ) munmap(cacheMap_,cacheSize_);
+
    xmlCleanupParser();
    xmlMemoryDump();
 }
 
-// Parse xml file
-bool KpixCalibRead::parse ( string calibFile ) {
-   xmlDocPtr    doc;
-   xmlNodePtr   node;
-   ifstream     is;
-   stringstream buffer;
-   bool         ret;
-
-   // Open file
-   is.open(calibFile.c_str());
-   if ( ! is.is_open() ) {
-      cout << "Error opening xml file for read: " << calibFile << endl;
-      return(false);
+// Tags recognized by the parser
+enum KpixCalibTag {
+   TagBaseMean,       TagBaseRms,         TagBaseFitMean,   TagBaseFitSigma,
+   TagBaseFitMeanErr, TagBaseFitSigmaErr, TagBaseFitChisq,  TagCalibGain,
+   TagCalibIntercept, TagCalibGainErr,    TagCalibGainRms,  TagCalibInterceptErr,
+   TagCalibChisq,     TagCalibCrossTalk,  TagBadChannel,    TagKpixAsic,
+   TagChannel,        TagBucket,          TagRange,         TagCount
+};
+
+// Tag names, indexed by KpixCalibTag
+static const char *KpixCalibTagName[TagCount] = {
+   "BaseMean",       "BaseRms",         "BaseFitMean",      "BaseFitSigma",
+   "BaseFitMeanErr", "BaseFitSigmaErr", "BaseFitChisquare", "CalibGain",
+   "CalibIntercept", "CalibGainErr",    "CalibGainRms",     "CalibInterceptErr",
+   "CalibChisquare", "CalibCrossTalk",  "BadChannel",       "kpixAsic",
+   "Channel",        "Bucket",          "Range"
+};
+
+// Hash table slot for each tag, from the name length, last and middle characters.
+// The hash is collision free for the tag set above.
+#define KPIX_CALIB_HASH(name,len) (((len) + 22 * (name)[(len)-1] + (name)[(len)/2]) & 0x3F)
+static const signed char KpixCalibTagSlot[64] = {
+   -1,-1,11,-1,-1,-1,-1,-1,-1, 0,-1,15,-1,-1, 1,10,
+   -1,-1,-1,-1,-1,-1, 3,-1,-1,-1,-1,-1,-1,-1,-1, 7,
+   -1,18,-1,-1,-1,12, 6, 4, 2,17,-1,-1,-1,-1, 5,13,
+   -1,-1,-1,14,-1,-1,-1,-1,-1, 9, 8,-1,-1,16,-1,-1
+};
+
+// Return tag index for element name, -1 if not a known tag
+int KpixCalibRead::findTag ( const char *name ) {
+   uint len;
+   int  tag;
+
+   len = strlen(name);
+   if ( len == 0 ) return(-1);
+
+   tag = KpixCalibTagSlot[KPIX_CALIB_HASH(name,len)];
+   if ( tag < 0 || strcmp(name,KpixCalibTagName[tag]) != 0 ) return(-1);
+   return(tag);
+}
+
+// Binary cache file header
+class KpixCalibCacheHeader {
+   public:
+      char     magic[8];
+      uint32_t version;
+      uint32_t byteOrder;
+      uint32_t recordSize;
+      uint32_t asicCount;
+      uint64_t sourceSize;
+      int64_t  sourceSec;
+      int64_t  sourceNsec;
+      uint64_t stringOffset;
+      uint64_t stringSize;
+      uint64_t checksum;
+};
+
+// Binary cache constants, bump the version when the layout changes
+#define KPIX_CALIB_CACHE_MAGIC   "KPIXCAL"
+#define KPIX_CALIB_CACHE_VERSION 1
+#define KPIX_CALIB_CACHE_ORDER   0x01020304
+#define KPIX_CALIB_CACHE_SERIAL  0xFFFFFFFF
+#define KPIX_CALIB_CACHE_HASH    0xcbf29ce484222325ULL
+
+// 64-bit FNV-1a over 8 byte words, size must be a multiple of 8
+static uint64_t calibCacheChecksum ( uint64_t hash, const void *buffer, uint64_t size ) {
+   const uint64_t *word;
+   uint64_t       x;
+
+   word = (const uint64_t *)buffer;
+   for (x=0; x < size/8; x++) {
+      hash ^= word[x];
+      hash *= 0x100000001b3ULL;
    }
+   return(hash);
+}
 
-   buffer.str("");
-   buffer << is.rdbuf();
-   is.close();
-   ret = false;
+// Append string record to cache string section
+static void calibCacheString ( string &section, uint32_t asic, uint32_t index, const string &value ) {
+   uint32_t len;
 
-   // Parse string
-   doc = xmlReadMemory(buffer.str().c_str(), strlen(buffer.str().c_str()), "calib.xml", NULL, 0);
-   if (doc != NULL) {
+   len = value.size();
+   section.append((const char *)&asic,4);
+   section.append((const char *)&index,4);
+   section.append((const char *)&len,4);
+   section.append(value);
+}
 
-      // get the root element node
-      node = xmlDocGetRootElement(doc);
+// Parse calibration file, using binary cache if enabled
+bool KpixCalibRead::parse ( string calibFile, bool cache ) {
+   string cacheFile;
+   bool   empty;
 
-      // Process
-      parseXmlLevel(node,"",0,0,0);
+   cacheFile = calibFile + ".cache";
 
-      // Cleanup
-      xmlFreeDoc(doc);
-      ret = true;
-   }
-   xmlCleanupParser();
-   xmlMemoryDump();
-   return(ret);
+   // The cache only describes a single file, merged loads always use the XML
+   empty = asicData_.empty();
+   if ( cache && empty && readCache(calibFile,cacheFile) ) return(true);
+
+   if ( ! parseXml(calibFile) ) return(false);
+
+   if ( cache && empty && ! writeCache(calibFile,cacheFile) )
+      cout << "KpixCalibRead::parse -> Could not write cache file " << cacheFile << endl;
+   return(true);
 }
 
-// Parse XML level
-void KpixCalibRead::parseXmlLevel ( xmlNode *node, string kpix, uint channel, uint bucket, uint range ) {
-   xmlNode    *childNode;
-   string     topStr;
-   string     nameStr;
-   char       *attrValue;
-   uint       idxNum;
-   string     idxStr;
-   string     kpixLocal;
-   char       *nodeValue;
-   double     value;
-
-   kpixLocal = kpix;
-
-   // Top level node name
-   topStr = (char *)node->name;
-
-   // Look for child nodes
-   for ( childNode = node->children; childNode; childNode = childNode->next ) {
-
-      // Process element
-      if ( childNode->type == XML_ELEMENT_NODE ) {
-
-         // Get name
-         nameStr = (char *)childNode->name;
-
-         // Get index
-         attrValue = (char *)xmlGetProp(childNode,(const xmlChar*)"id");
-         if ( attrValue != NULL ) {
-            idxNum = atoi(attrValue);
-            idxStr = attrValue;
-         }
+// Load constants from binary cache, returns false if missing or stale
+bool KpixCalibRead::readCache ( string calibFile, string cacheFile ) {
+   KpixCalibCacheHeader *header;
+   struct stat          srcStat;
+   struct stat          cacheStat;
+   uint64_t             blockSize;
+   const char           *str;
+   const char           *strEnd;
+   uint32_t             asic;
+   uint32_t             index;
+   uint32_t             len;
+   void                 *map;
+   int                  fd;
+   bool                 valid;
+   uint                 x;
+
+   if ( stat(calibFile.c_str(),&srcStat) != 0 ) return(false);
+   if ( (fd = open(cacheFile.c_str(),O_RDONLY)) < 0 ) return(false);
+
+   // Cache must be newer than the source
+   if ( fstat(fd,&cacheStat) != 0 || cacheStat.st_mtime < srcStat.st_mtime ||
+        (uint64_t)cacheStat.st_size < sizeof(KpixCalibCacheHeader) ) {
+      close(fd);
+      return(false);
+   }
+
+   // Private mapping, pages are copied if a later parse updates values
+   map = mmap(NULL,cacheStat.st_size,PROT_READ|PROT_WRITE,MAP_PRIVATE,fd,0);
+   close(fd);
+   if ( map == MAP_FAILED ) return(false);
+
+   // Check header against the source file and this build
+   header    = (KpixCalibCacheHeader *)map;
+   blockSize = sizeof(KpixCalibChannel) * 1024;
+   valid     = true;
+   if ( memcmp(header->magic,KPIX_CALIB_CACHE_MAGIC,8) != 0 ) valid = false;
+   if ( header->version    != KPIX_CALIB_CACHE_VERSION       ) valid = false;
+   if ( header->byteOrder  != KPIX_CALIB_CACHE_ORDER         ) valid = false;
+   if ( header->recordSize != sizeof(KpixCalibData)          ) valid = false;
+   if ( header->sourceSize != (uint64_t)srcStat.st_size      ) valid = false;
+   if ( header->sourceSec  != (int64_t)srcStat.st_mtim.tv_sec  ) valid = false;
+   if ( header->sourceNsec != (int64_t)srcStat.st_mtim.tv_nsec ) valid = false;
+
+   // Check layout against file size
+   if ( header->stringOffset != sizeof(KpixCalibCacheHeader) + header->asicCount * blockSize ) valid = false;
+   if ( header->stringOffset + header->stringSize != (uint64_t)cacheStat.st_size ) valid = false;
+   if ( header->stringSize % 8 != 0 ) valid = false;
+
+   // Checksum covers everything after the header
+   if ( valid && header->checksum != calibCacheChecksum(KPIX_CALIB_CACHE_HASH,(char *)map + sizeof(KpixCalibCacheHeader),
+                                                        cacheStat.st_size - sizeof(KpixCalibCacheHeader)) ) valid = false;
+
+   // Create ASICs and attach crosstalk strings
+   str    = (const char *)map + header->stringOffset;
+   strEnd = str + header->stringSize;
+   while ( valid && strEnd - str >= 12 ) {
+      memcpy(&asic,str,4);
+      memcpy(&index,str+4,4);
+      memcpy(&len,str+8,4);
+      str += 12;
+
+      if ( (uint64_t)(strEnd - str) < len ) valid = false;
+      else if ( index == KPIX_CALIB_CACHE_SERIAL ) {
+         if ( asic != asicData_.size() || asic >= header->asicCount ) valid = false;
          else {
-            idxNum = 0;
-            idxStr = "";
+            asicMap_.insert(pair<string,int>(string(str,len),asic));
+            asicData_.push_back(new KpixCalibAsic((KpixCalibChannel *)((char *)map + sizeof(KpixCalibCacheHeader) + asic * blockSize)));
          }
+      }
+      else if ( asic >= asicData_.size() || index >= 1024*4*2 ) valid = false;
+      else asicData_[asic]->crossTalk[index] = string(str,len);
+      str += len;
+   }
+   if ( valid && asicData_.size() != header->asicCount ) valid = false;
 
-         // Look for tags
-         if ( nameStr == "Channel"  ) channel   = idxNum;
-         if ( nameStr == "Bucket"   ) bucket    = idxNum;
-         if ( nameStr == "Range"    ) range     = idxNum;
-         if ( nameStr == "kpixAsic" ) kpixLocal = idxStr;
+   if ( ! valid ) {
+      for (x=0; x < asicData_.size(); x++) delete asicData_[x];
+      asicData_.clear();
+      asicMap_.clear();
+      munmap(map,cacheStat.st_size);
+      return(false);
+   }
 
-         // Process next level
-         parseXmlLevel(childNode,kpixLocal,channel,bucket,range);
-      }
+   cacheMap_  = map;
+   cacheSize_ = cacheStat.st_size;
+   return(true);
+}
+
+// Write constants to binary cache
+bool KpixCalibRead::writeCache ( string calibFile, string cacheFile ) {
+   KpixCalibCacheHeader         header;
+   struct stat                  srcStat;
+   map<string,int>::iterator    asicIter;
+   vector<string>               serialList;
+   map<uint,string>::iterator   crossIter;
+   string                       section;
+   string                       tmpFile;
+   stringstream                 tmp;
+   uint64_t                     blockSize;
+   uint64_t                     hash;
+   uint64_t                     x;
+   int                          fd;
+   bool                         ret;
+
+   if ( stat(calibFile.c_str(),&srcStat) != 0 ) return(false);
+   blockSize = sizeof(KpixCalibChannel) * 1024;
+
+   // Serial numbers followed by crosstalk strings
+   serialList.resize(asicData_.size());
+   for (asicIter=asicMap_.begin(); asicIter != asicMap_.end(); asicIter++)
+      serialList[asicIter->second] = asicIter->first;
+
+   section = "";
+   for (x=0; x < asicData_.size(); x++) calibCacheString(section,x,KPIX_CALIB_CACHE_SERIAL,serialList[x]);
+   for (x=0; x < asicData_.size(); x++) {
+      for (crossIter=asicData_[x]->crossTalk.begin(); crossIter != asicData_[x]->crossTalk.end(); crossIter++)
+         calibCacheString(section,x,crossIter->first,crossIter->second);
+   }
+   while ( section.size() % 8 != 0 ) section.append(1,'\0');
+
+   // Header
+   memset(&header,0,sizeof(header));
+   memcpy(header.magic,KPIX_CALIB_CACHE_MAGIC,8);
+   header.version      = KPIX_CALIB_CACHE_VERSION;
+   header.byteOrder    = KPIX_CALIB_CACHE_ORDER;
+   header.recordSize   = sizeof(KpixCalibData);
+   header.asicCount    = asicData_.size();
+   header.sourceSize   = srcStat.st_size;
+   header.sourceSec    = srcStat.st_mtim.tv_sec;
+   header.sourceNsec   = srcStat.st_mtim.tv_nsec;
+   header.stringOffset = sizeof(header) + asicData_.size() * blockSize;
+   header.stringSize   = section.size();
+
+   // Checksum over the data blocks and string section
+   hash = KPIX_CALIB_CACHE_HASH;
+   for (x=0; x < asicData_.size(); x++) hash = calibCacheChecksum(hash,asicData_[x]->data,blockSize);
+   header.checksum = calibCacheChecksum(hash,section.data(),section.size());
+
+   // Write to a temporary file and rename so readers never see a partial cache
+   tmp.str("");
+   tmp << cacheFile << ".tmp" << dec << getpid();
+   tmpFile = tmp.str();
+   if ( (fd = open(tmpFile.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0644)) < 0 ) return(false);
+
+   ret = (write(fd,&header,sizeof(header)) == (ssize_t)sizeof(header));
+   for (x=0; ret && x < asicData_.size(); x++)
+      ret = (write(fd,asicData_[x]->data,blockSize) == (ssize_t)blockSize);
+   if ( ret ) ret = (write(fd,section.data(),section.size()) == (ssize_t)section.size());
+   close(fd);
+
+   if ( ! ret || rename(tmpFile.c_str(),cacheFile.c_str()) != 0 ) {
+      unlink(tmpFile.c_str());
+      return(false);
+   }
+   return(true);
+}
 
-      // Process text value
-      else if ( childNode->type == XML_TEXT_NODE ) {
-         nodeValue = (char *)childNode->content;
-         if ( nodeValue != NULL ) {
-
-            // Convert to double
-            sscanf(nodeValue,"%lf",&value);
-
-            // What do we do with this value
-            if ( bucket < 4 && channel < 1024 && range < 2 ) {
-               if ( topStr == "BaseMean" )          findKpix(kpix,channel,bucket,range,true)->baseMean          = value;
-               if ( topStr == "BaseRms" )           findKpix(kpix,channel,bucket,range,true)->baseRms           = value;
-               if ( topStr == "BaseFitMean" )       findKpix(kpix,channel,bucket,range,true)->baseFitMean       = value;
-               if ( topStr == "BaseFitSigma" )      findKpix(kpix,channel,bucket,range,true)->baseFitSigma      = value;
-               if ( topStr == "BaseFitMeanErr" )    findKpix(kpix,channel,bucket,range,true)->baseFitMeanErr    = value;
-               if ( topStr == "BaseFitSigmaErr" )   findKpix(kpix,channel,bucket,range,true)->baseFitSigmaErr   = value;
-               if ( topStr == "BaseFitChisquare" )  findKpix(kpix,channel,bucket,range,true)->baseFitChisquare  = value;
-               if ( topStr == "CalibGain" )         findKpix(kpix,channel,bucket,range,true)->calibGain         = value;
-               if ( topStr == "CalibIntercept" )    findKpix(kpix,channel,bucket,range,true)->calibIntercept    = value;
-               if ( topStr == "CalibGainErr" )      findKpix(kpix,channel,bucket,range,true)->calibGainErr      = value;
-               if ( topStr == "CalibGainRms" )      findKpix(kpix,channel,bucket,range,true)->calibGainRms      = value;
-               if ( topStr == "CalibInterceptErr" ) findKpix(kpix,channel,bucket,range,true)->calibInterceptErr = value;
-               if ( topStr == "CalibChisquare" )    findKpix(kpix,channel,bucket,range,true)->calibChisquare    = value;
-               if ( topStr == "CalibCrossTalk" )    findKpix(kpix,channel,bucket,range,true)->calibCrossTalk    = nodeValue;
-               if ( topStr == "BadChannel"        ) findKpix(kpix,channel,0     ,0    ,true)->badChannel        = (uint)value;
+// Parse xml file
+bool KpixCalibRead::parseXml ( string calibFile ) {
+   xmlTextReaderPtr       reader;
+   vector<KpixCalibLevel> level;
+   vector<string>         serialList;
+   vector<int>            asicList;
+   KpixCalibLevel         *cur;
+   KpixCalibData          *data;
+   const char             *name;
+   const char             *text;
+   char                   *attrValue;
+   uint                   depth;
+   int                    type;
+   int                    ret;
+   int                    tag;
+   double                 value;
+
+   // Open file, contents are streamed with no document tree
+   reader = xmlReaderForFile(calibFile.c_str(), NULL, 0);
+   if ( reader == NULL ) {
+      cout << "Error opening xml file for read: " << calibFile << endl;
+      return(false);
+   }
+
+   // Top level state, empty serial number
+   serialList.push_back("");
+   asicList.push_back(-1);
+   level.resize(2);
+   level[0].serial  = 0;
+   level[0].channel = 0;
+   level[0].bucket  = 0;
+   level[0].range   = 0;
+   level[0].tag     = -1;
+
+   while ( (ret = xmlTextReaderRead(reader)) == 1 ) {
+      type  = xmlTextReaderNodeType(reader);
+      depth = xmlTextReaderDepth(reader);
+
+      // Start of element, state persists for following siblings
+      if ( type == XML_READER_TYPE_ELEMENT ) {
+         if ( level.size() < depth + 2 ) level.resize(depth + 2);
+         cur  = &(level[depth]);
+         name = (const char *)xmlTextReaderConstLocalName(reader);
+         tag  = findTag(name);
+
+         if ( tag == TagKpixAsic || tag == TagChannel || tag == TagBucket || tag == TagRange ) {
+            attrValue = (char *)xmlTextReaderGetAttribute(reader,(const xmlChar*)"id");
+
+            if      ( tag == TagChannel ) cur->channel = (attrValue == NULL)?0:atoi(attrValue);
+            else if ( tag == TagBucket  ) cur->bucket  = (attrValue == NULL)?0:atoi(attrValue);
+            else if ( tag == TagRange   ) cur->range   = (attrValue == NULL)?0:atoi(attrValue);
+            else {
+               cur->serial = serialList.size();
+               serialList.push_back((attrValue == NULL)?"":attrValue);
+               asicList.push_back(-1);
             }
+            if ( attrValue != NULL ) xmlFree(attrValue);
+         }
+         cur->tag = tag;
+
+         // Children start with the state of this element
+         level[depth+1] = *cur;
+      }
+
+      // Text value
+      else if ( (type == XML_READER_TYPE_TEXT || type == XML_READER_TYPE_CDATA) && depth > 0 ) {
+         if ( level.size() < depth + 1 ) level.resize(depth + 1);
+         cur = &(level[depth]);
+         tag = level[depth-1].tag;
+
+         if ( tag < 0 || tag >= TagKpixAsic ) continue;
+         if ( cur->channel > 1023 || cur->bucket > 3 || cur->range > 1 ) continue;
+         if ( (text = (const char *)xmlTextReaderConstValue(reader)) == NULL ) continue;
+
+         // Resolve ASIC handle on first value
+         if ( asicList[cur->serial] < 0 ) {
+            findKpix(serialList[cur->serial],0,0,0,true);
+            asicList[cur->serial] = findAsic(serialList[cur->serial]);
+         }
+
+         // Bad channel flag is stored with bucket 0, range 0
+         if ( tag == TagBadChannel ) data = &(asicData_[asicList[cur->serial]]->data[cur->channel][0][0]);
+         else data = &(asicData_[asicList[cur->serial]]->data[cur->channel][cur->bucket][cur->range]);
+
+         if ( tag == TagCalibCrossTalk ) {
+            asicData_[asicList[cur->serial]]->crossTalk[(cur->channel*4+cur->bucket)*2+cur->range] = text;
+            continue;
+         }
+         value = strtod(text,NULL);
+
+         switch ( tag ) {
+            case TagBaseMean:          data->baseMean          = value; break;
+            case TagBaseRms:           data->baseRms           = value; break;
+            case TagBaseFitMean:       data->baseFitMean       = value; break;
+            case TagBaseFitSigma:      data->baseFitSigma      = value; break;
+            case TagBaseFitMeanErr:    data->baseFitMeanErr    = value; break;
+            case TagBaseFitSigmaErr:   data->baseFitSigmaErr   = value; break;
+            case TagBaseFitChisq:      data->baseFitChisquare  = value; break;
+            case TagCalibGain:         data->calibGain         = value; break;
+            case TagCalibIntercept:    data->calibIntercept    = value; break;
+            case TagCalibGainErr:      data->calibGainErr      = value; break;
+            case TagCalibGainRms:      data->calibGainRms      = value; break;
+            case TagCalibInterceptErr: data->calibInterceptErr = value; break;
+            case TagCalibChisq:        data->calibChisquare    = value; break;
+            case TagBadChannel:        data->badChannel        = (uint)value; break;
+            default: break;
          }
       }
    }
-}
+   xmlFreeTextReader(reader);
 
-// Return pointer to ASIC, optional creation
-KpixCalibRead::KpixCalibData *KpixCalibRead::findKpix ( string kpix, uint channel, uint bucket, uint range, bool create ) {
-   KpixCalibAsic *asic;
+   if ( ret != 0 ) cout << "Error parsing xml file: " << calibFile << endl;
+   return(ret == 0);
+}
 
-   map<string,KpixCalibAsic *>::iterator asicMapIter;
+// Return pointer to channel data, optional ASIC creation
+KpixCalibRead::KpixCalibData *KpixCalibRead::findKpix ( const string &kpix, uint channel, uint bucket, uint range, bool create ) {
+   map<string,int>::iterator asicMapIter;
+   int                       asic;
 
-   if ( channel > 1024 ) return(NULL);
+   if ( channel > 1023 ) return(NULL);
    if ( bucket  > 3    ) return(NULL);
    if ( range   > 1    ) return(NULL);
 
-   asicMapIter = asicList_.find(kpix);
+   asicMapIter = asicMap_.find(kpix);
 
-   if ( asicMapIter == asicList_.end() ) {
+   if ( asicMapIter == asicMap_.end() ) {
       if ( create ) {
-         asic = new KpixCalibAsic;
-         asicList_.insert(pair<string,KpixCalibAsic*>(kpix,asic));
+         asic = asicData_.size();
+         asicData_.push_back(new KpixCalibAsic);
+         asicMap_.insert(pair<string,int>(kpix,asic));
          //cout << "KpixCalibRead::findKpix -> Creating entry for Kpix " << kpix << endl;
       }
       else {
@@ -179,144 +453,127 @@ KpixCalibRead::KpixCalibData *KpixCalibRead::findKpix ( string kpix, uint channe
    }
    else asic = asicMapIter->second;
 
-   return(asic->data[channel][bucket][range]);
+   return(&(asicData_[asic]->data[channel][bucket][range]));
 }
 
-// Get baseline mean value
-double KpixCalibRead::baseMean ( string kpix, uint channel, uint bucket, uint range ) {
-   KpixCalibData *data;
+// Get ASIC handle for serial number
+int KpixCalibRead::findAsic ( const string &kpix ) const {
+   map<string,int>::const_iterator asicMapIter;
 
-   if ( (data = findKpix(kpix,channel,bucket,range,false)) == NULL ) return(0.0);
-   return(data->baseMean);
+   asicMapIter = asicMap_.find(kpix);
+   if ( asicMapIter == asicMap_.end() ) return(-1);
+   return(asicMapIter->second);
 }
 
-// Get baseline rms value
-double KpixCalibRead::baseRms ( string kpix, uint channel, uint bucket, uint range ) {
-   KpixCalibData *data;
+// Get number of ASICs
+uint KpixCalibRead::asicCount ( ) const {
+   return(asicData_.size());
+}
 
-   if ( (data = findKpix(kpix,channel,bucket,range,false)) == NULL ) return(0.0);
-   return(data->baseRms);
+// Get baseline mean value
+double KpixCalibRead::baseMean ( const string &kpix, uint channel, uint bucket, uint range ) {
+   return(baseMean(findAsic(kpix),channel,bucket,range));
 }
 
-// Get baseline guassian fit mean
-double KpixCalibRead::baseFitMean ( string kpix, uint channel, uint bucket, uint range ) {
-   KpixCalibData *data;
+// Get baseline rms value
+double KpixCalibRead::baseRms ( const string &kpix, uint channel, uint bucket, uint range ) {
+   return(baseRms(findAsic(kpix),channel,bucket,range));
+}
 
-   if ( (data = findKpix(kpix,channel,bucket,range,false)) == NULL ) return(0.0);
-   return(data->baseFitMean);
+// Get baseline guassian fit mean
+double KpixCalibRead::baseFitMean ( const string &kpix, uint channel, uint bucket, uint range ) {
+   return(baseFitMean(findAsic(kpix),channel,bucket,range));
 }
 
 // Get baseline guassian fit sigma
-double KpixCalibRead::baseFitSigma ( string kpix, uint channel, uint bucket, uint range ) {
-   KpixCalibData *data;
-
-   if ( (data = findKpix(kpix,channel,bucket,range,false)) == NULL ) return(0.0);
-   return(data->baseFitSigma);
+double KpixCalibRead::baseFitSigma ( const string &kpix, uint channel, uint bucket, uint range ) {
+   return(baseFitSigma(findAsic(kpix),channel,bucket,range));
 }
 
 // Get baseline guassian fit mean error
-double KpixCalibRead::baseFitMeanErr ( string kpix, uint channel, uint bucket, uint range ) {
-   KpixCalibData *data;
-
-   if ( (data = findKpix(kpix,channel,bucket,range,false)) == NULL ) return(0.0);
-   return(data->baseFitMeanErr);
+double KpixCalibRead::baseFitMeanErr ( const string &kpix, uint channel, uint bucket, uint range ) {
+   return(baseFitMeanErr(findAsic(kpix),channel,bucket,range));
 }
 
 // Get baseline guassian fit sigma error
-double KpixCalibRead::baseFitSigmaErr ( string kpix, uint channel, uint bucket, uint range ) {
-   KpixCalibData *data;
-
-   if ( (data = findKpix(kpix,channel,bucket,range,false)) == NULL ) return(0.0);
-   return(data->baseFitSigmaErr);
+double KpixCalibRead::baseFitSigmaErr ( const string &kpix, uint channel, uint bucket, uint range ) {
+   return(baseFitSigmaErr(findAsic(kpix),channel,bucket,range));
 }
 
-// Get baseline guassian fit chisquare   
-double KpixCalibRead::baseFitChisquare ( string kpix, uint channel, uint bucket, uint range ) {
-   KpixCalibData *data;
-
-   if ( (data = findKpix(kpix,channel,bucket,range,false)) == NULL ) return(0.0);
-   return(data->baseFitChisquare);
+// Get baseline guassian fit chisquare
+double KpixCalibRead::baseFitChisquare ( const string &kpix, uint channel, uint bucket, uint range ) {
+   return(baseFitChisquare(findAsic(kpix),channel,bucket,range));
 }
 
 // Get calibration gain
-double KpixCalibRead::calibGain ( string kpix, uint channel, uint bucket, uint range ) {
-   KpixCalibData *data;
-
-   if ( (data = findKpix(kpix,channel,bucket,range,false)) == NULL ) return(0.0);
-   return(data->calibGain);
+double KpixCalibRead::calibGain ( const string &kpix, uint channel, uint bucket, uint range ) {
+   return(calibGain(findAsic(kpix),channel,bucket,range));
 }
 
 // Get calibration intercept
-double KpixCalibRead::calibIntercept ( string kpix, uint channel, uint bucket, uint range ) {
-   KpixCalibData *data;
-
-   if ( (data = findKpix(kpix,channel,bucket,range,false)) == NULL ) return(0.0);
-   return(data->calibIntercept);
+double KpixCalibRead::calibIntercept ( const string &kpix, uint channel, uint bucket, uint range ) {
+   return(calibIntercept(findAsic(kpix),channel,bucket,range));
 }
 
 // Get calibration gain error
-double KpixCalibRead::calibGainErr ( string kpix, uint channel, uint bucket, uint range ) {
-   KpixCalibData *data;
-
-   if ( (data = findKpix(kpix,channel,bucket,range,false)) == NULL ) return(0.0);
-   return(data->calibGainErr);
+double KpixCalibRead::calibGainErr ( const string &kpix, uint channel, uint bucket, uint range ) {
+   return(calibGainErr(findAsic(kpix),channel,bucket,range));
 }
 
 // Get calibration gain rms
-double KpixCalibRead::calibGainRms ( string kpix, uint channel, uint bucket, uint range ) {
-   KpixCalibData *data;
-
-   if ( (data = findKpix(kpix,channel,bucket,range,false)) == NULL ) return(0.0);
-   return(data->calibGainRms);
+double KpixCalibRead::calibGainRms ( const string &kpix, uint channel, uint bucket, uint range ) {
+   return(calibGainRms(findAsic(kpix),channel,bucket,range));
 }
 
 // Get calibration intercept error
-double KpixCalibRead::calibInterceptErr ( string kpix, uint channel, uint bucket, uint range ) {
-   KpixCalibData *data;
-
-   if ( (data = findKpix(kpix,channel,bucket,range,false)) == NULL ) return(0.0);
-   return(data->calibInterceptErr);
+double KpixCalibRead::calibInterceptErr ( const string &kpix, uint channel, uint bucket, uint range ) {
+   return(calibInterceptErr(findAsic(kpix),channel,bucket,range));
 }
 
 // Get calibration chisquare
-double KpixCalibRead::calibChisquare ( string kpix, uint channel, uint bucket, uint range ) {
-   KpixCalibData *data;
-
-   if ( (data = findKpix(kpix,channel,bucket,range,false)) == NULL ) return(0.0);
-   return(data->calibChisquare);
+double KpixCalibRead::calibChisquare ( const string &kpix, uint channel, uint bucket, uint range ) {
+   return(calibChisquare(findAsic(kpix),channel,bucket,range));
 }
 
 // Get calibration crosstalk string
-string KpixCalibRead::calibCrossTalk ( string kpix, uint channel, uint bucket, uint range ) {
-   KpixCalibData *data;
-
-   if ( (data = findKpix(kpix,channel,bucket,range,false)) == NULL ) return("");
-   return(data->calibCrossTalk);
+string KpixCalibRead::calibCrossTalk ( const string &kpix, uint channel, uint bucket, uint range ) {
+   return(calibCrossTalk(findAsic(kpix),channel,bucket,range));
 }
 
 // Get bad channel
-uint KpixCalibRead::badChannel ( string kpix, uint channel ) {
-   KpixCalibData *data;
+uint KpixCalibRead::badChannel ( const string &kpix, uint channel ) {
+   return(badChannel(findAsic(kpix),channel));
+}
 
-   if ( (data = findKpix(kpix,channel,0,0,false)) == NULL ) return(false);
-   return(data->badChannel);
+// Get calibration value by name
+double KpixCalibRead::calibByName ( const string &kpix, uint channel, uint bucket, uint range, string name ) {
+   return(calibByName(findAsic(kpix),channel,bucket,range,name));
 }
 
-//! Get calibration value by name
-double KpixCalibRead::calibByName ( string kpix, uint channel, uint bucket, uint range, string name ) {
-   if      ( name == "baseMean"          ) return( baseMean ( kpix, channel, bucket, range ));
-   else if ( name == "baseRms"           ) return( baseRms ( kpix, channel, bucket, range ));
-   else if ( name == "baseFitMean"       ) return( baseFitMean ( kpix, channel, bucket, range ));
-   else if ( name == "baseFitSigma"      ) return( baseFitSigma ( kpix, channel, bucket, range ));
-   else if ( name == "baseFitMeanErr"    ) return( baseFitMeanErr ( kpix, channel, bucket, range ));
-   else if ( name == "baseFitSigmaErr"   ) return( baseFitSigmaErr ( kpix, channel, bucket, range ));
-   else if ( name == "baseFitChisquare"  ) return( baseFitChisquare ( kpix, channel, bucket, range ));
-   else if ( name == "calibGain"         ) return( calibGain ( kpix, channel, bucket, range ));
-   else if ( name == "calibIntercept"    ) return( calibIntercept ( kpix, channel, bucket, range ));
-   else if ( name == "calibGainErr"      ) return( calibGainErr ( kpix, channel, bucket, range ));
-   else if ( name == "calibGainRms"      ) return( calibGainRms ( kpix, channel, bucket, range ));
-   else if ( name == "calibInterceptErr" ) return( calibInterceptErr ( kpix, channel, bucket, range ));
-   else if ( name == "calibChisquare"    ) return( calibChisquare ( kpix, channel, bucket, range ));
-   else return(0.0);
+// Get calibration crosstalk string by ASIC handle
+string KpixCalibRead::calibCrossTalk ( int asic, uint channel, uint bucket, uint range ) const {
+   map<uint,string>::const_iterator iter;
+
+   if ( findData(asic,channel,bucket,range) == NULL ) return("");
+   iter = asicData_[asic]->crossTalk.find((channel*4+bucket)*2+range);
+   if ( iter == asicData_[asic]->crossTalk.end() ) return("");
+   return(iter->second);
 }
 
+// Get calibration value by name and ASIC handle
+double KpixCalibRead::calibByName ( int asic, uint channel, uint bucket, uint range, string name ) const {
+   if      ( name == "baseMean"          ) return( baseMean ( asic, channel, bucket, range ));
+   else if ( name == "baseRms"           ) return( baseRms ( asic, channel, bucket, range ));
+   else if ( name == "baseFitMean"       ) return( baseFitMean ( asic, channel, bucket, range ));
+   else if ( name == "baseFitSigma"      ) return( baseFitSigma ( asic, channel, bucket, range ));
+   else if ( name == "baseFitMeanErr"    ) return( baseFitMeanErr ( asic, channel, bucket, range ));
+   else if ( name == "baseFitSigmaErr"   ) return( baseFitSigmaErr ( asic, channel, bucket, range ));
+   else if ( name == "baseFitChisquare"  ) return( baseFitChisquare ( asic, channel, bucket, range ));
+   else if ( name == "calibGain"         ) return( calibGain ( asic, channel, bucket, range ));
+   else if ( name == "calibIntercept"    ) return( calibIntercept ( asic, channel, bucket, range ));
+   else if ( name == "calibGainErr"      ) return( calibGainErr ( asic, channel, bucket, range ));
+   else if ( name == "calibGainRms"      ) return( calibGainRms ( asic, channel, bucket, range ));
+   else if ( name == "calibInterceptErr" ) return( calibInterceptErr ( asic, channel, bucket, range ));
+   else if ( name == "calibChisquare"    ) return( calibChisquare ( asic, channel, bucket, range ));
+   else return(0.0);
+}
@@ -18,8 +18,10 @@
 
 #include <string>
 #include <map>
+#include <vector>
+#include <string.h>
 #include <sys/types.h>
-#include <libxml/tree.h>
+#include <libxml/xmlreader.h>
 using namespace std;
 
 #ifdef __CINT__
@@ -27,6 +29,13 @@ using namespace std;
 #endif
 
 //! Class used to parse and read calibration run data.
+/*!
+ * Constants are held in one contiguous block per ASIC indexed by
+ * [channel][bucket][range]. Code which performs a lookup per sample should
+ * resolve the ASIC serial number to an integer handle once with findAsic()
+ * and use the handle based accessors. The serial number based accessors are
+ * retained as wrappers around the handle lookup.
+ */
 class KpixCalibRead {
 
       // Class for channel data
@@ -47,60 +56,81 @@ class KpixCalibRead {
             double calibInterceptErr;
             double calibChisquare;
             double calibGainRms;
-            string calibCrossTalk;
             uint   badChannel;
-
-            // Init
-            KpixCalibData () {
-               baseMean          = 0;
-               baseRms           = 0;
-               baseFitMean       = 0;
-               baseFitSigma      = 0;
-               baseFitMeanErr    = 0;
-               baseFitSigmaErr   = 0;
-               baseFitChisquare  = 0;
-               calibGain         = 0;
-               calibIntercept    = 0;
-               calibGainErr      = 0;
-               calibGainRms      = 0;
-               calibInterceptErr = 0;
-               calibChisquare    = 0;
-               calibCrossTalk    = "";
-               badChannel        = 0;
-            }
       };
 
+      // Channel data indexed by bucket and range
+      typedef KpixCalibData KpixCalibChannel[4][2];
+
       // Structure for ASIC
       class KpixCalibAsic {
          public:
 
-            KpixCalibData *data[1024][4][2];
-
-            KpixCalibAsic () {
-               for (uint x=0; x < 1024; x++) 
-                  for (uint y=0; y < 4; y++) {
-                     data[x][y][0] = new KpixCalibData;
-                     data[x][y][1] = new KpixCalibData;
-                  }
+            // Contiguous channel data block, owned or in the cache mapping
+            KpixCalibChannel *data;
+            bool             owner;
+
+            // Crosstalk strings, sparse, indexed by channel/bucket/range
+            map<uint,string> crossTalk;
+
+            KpixCalibAsic ( KpixCalibChannel *mapped = NULL ) {
+               if ( mapped == NULL ) {
+                  data  = new KpixCalibChannel[1024];
+                  owner = true;
+                  memset(data,0,sizeof(KpixCalibChannel)*1024);
+               }
+               else {
+                  data  = mapped;
+                  owner = false;
+               }
             }
-      
+
             ~KpixCalibAsic () {
-               for (uint x=0; x < 1024; x++) 
-                  for (uint y=0; y < 4; y++) {
-                     delete data[x][y][0];
-                     delete data[x][y][1];
-                  }
+               if ( owner ) delete[] data;
             }
       };
 
-      // Vector of KPIXs
-      map<string,KpixCalibAsic *> asicList_;
+      // ASIC data blocks, indexed by handle
+      vector<KpixCalibAsic *> asicData_;
+
+      // Serial number to handle map
+      map<string,int> asicMap_;
 
-      // Parse XML level
-      void parseXmlLevel ( xmlNode *node, string kpix, uint channel, uint bucket, uint range );
+      // Parser state for one element depth
+      class KpixCalibLevel {
+         public:
+            uint serial;
+            uint channel;
+            uint bucket;
+            uint range;
+            int  tag;
+      };
 
-      // Return pointer to ASIC, optional creation
-      KpixCalibData *findKpix ( string kpix, uint channel, uint bucket, uint range, bool create );
+      // Binary cache mapping
+      void   *cacheMap_;
+      size_t  cacheSize_;
+
+      // Return tag index for element name, -1 if not a known tag
+      static int findTag ( const char *name );
+
+      // Parse XML file
+      bool parseXml ( string calibFile );
+
+      // Load constants from binary cache, returns false if missing or stale
+      bool readCache ( string calibFile, string cacheFile );
+
+      // Write constants to binary cache
+      bool writeCache ( string calibFile, string cacheFile );
+
+      // Return pointer to channel data, optional ASIC creation
+      KpixCalibData *findKpix ( const string &kpix, uint channel, uint bucket, uint range, bool create );
+
+      // Return pointer to channel data by handle
+      inline const KpixCalibData *findData ( int asic, uint channel, uint bucket, uint range ) const {
+         if ( asic < 0 || (uint)asic >= asicData_.size() ) return(NULL);
+         if ( channel > 1023 || bucket > 3 || range > 1 ) return(NULL);
+         return(&(asicData_[asic]->data[channel][bucket][range]));
+      }
       
    public:
 
@@ -111,55 +141,156 @@ class KpixCalibRead {
       ~KpixCalibRead ( );
 
       //! Parse XML file
-      bool parse ( string calibFile );
+      /*!
+       * When cache is set a binary image of the constants is kept in calibFile.cache.
+       * The image is mapped instead of parsing the XML when it matches the source
+       * file size and modification time and passes its checksum.
+       */
+      bool parse ( string calibFile, bool cache = true );
+
+      //! Get ASIC handle for serial number, returns -1 if not found
+      int findAsic ( const string &kpix ) const;
+
+      //! Get number of ASICs
+      uint asicCount ( ) const;
 
       //! Get baseline mean value
-      double baseMean ( string kpix, uint channel, uint bucket, uint range );
+      double baseMean ( const string &kpix, uint channel, uint bucket, uint range );
 
       //! Get baseline rms value
-      double baseRms ( string kpix, uint channel, uint bucket, uint range );
+      double baseRms ( const string &kpix, uint channel, uint bucket, uint range );
 
       //! Get baseline guassian fit mean
-      double baseFitMean ( string kpix, uint channel, uint bucket, uint range );
+      double baseFitMean ( const string &kpix, uint channel, uint bucket, uint range );
 
       //! Get baseline guassian fit sigma
-      double baseFitSigma ( string kpix, uint channel, uint bucket, uint range );
+      double baseFitSigma ( const string &kpix, uint channel, uint bucket, uint range );
 
       //! Get baseline guassian fit mean error
-      double baseFitMeanErr ( string kpix, uint channel, uint bucket, uint range );
+      double baseFitMeanErr ( const string &kpix, uint channel, uint bucket, uint range );
 
       //! Get baseline guassian fit sigma error
-      double baseFitSigmaErr ( string kpix, uint channel, uint bucket, uint range );
+      double baseFitSigmaErr ( const string &kpix, uint channel, uint bucket, uint range );
 
       //! Get baseline guassian fit chisquare
-      double baseFitChisquare ( string kpix, uint channel, uint bucket, uint range );
+      double baseFitChisquare ( const string &kpix, uint channel, uint bucket, uint range );
 
       //! Get calibration gain
-      double calibGain ( string kpix, uint channel, uint bucket, uint range );
+      double calibGain ( const string &kpix, uint channel, uint bucket, uint range );
 
       //! Get calibration intercept
-      double calibIntercept ( string kpix, uint channel, uint bucket, uint range );
+      double calibIntercept ( const string &kpix, uint channel, uint bucket, uint range );
 
       //! Get calibration gain error
-      double calibGainErr ( string kpix, uint channel, uint bucket, uint range );
+      double calibGainErr ( const string &kpix, uint channel, uint bucket, uint range );
 
       //! Get calibration gain rms
-      double calibGainRms ( string kpix, uint channel, uint bucket, uint range );
+      double calibGainRms ( const string &kpix, uint channel, uint bucket, uint range );
 
       //! Get calibration intercept error
-      double calibInterceptErr ( string kpix, uint channel, uint bucket, uint range );
+      double calibInterceptErr ( const string &kpix, uint channel, uint bucket, uint range );
 
       //! Get calibration chisquare
-      double calibChisquare ( string kpix, uint channel, uint bucket, uint range );
+      double calibChisquare ( const string &kpix, uint channel, uint bucket, uint range );
 
       //! Get crosstalk string
-      string calibCrossTalk ( string kpix, uint channel, uint bucket, uint range );
+      string calibCrossTalk ( const string &kpix, uint channel, uint bucket, uint range );
 
       //! Get bad channel flag
-      uint badChannel ( string kpix, uint channel );
+      uint badChannel ( const string &kpix, uint channel );
 
       //! Get calibration value by name
-      double calibByName ( string kpix, uint channel, uint bucket, uint range, string name );
+      double calibByName ( const string &kpix, uint channel, uint bucket, uint range, string name );
+
+      //! Get baseline mean value by ASIC handle
+      inline double baseMean ( int asic, uint channel, uint bucket, uint range ) const {
+         const KpixCalibData *data = findData(asic,channel,bucket,range);
+         return((data == NULL)?0.0:data->baseMean);
+      }
+
+      //! Get baseline rms value by ASIC handle
+      inline double baseRms ( int asic, uint channel, uint bucket, uint range ) const {
+         const KpixCalibData *data = findData(asic,channel,bucket,range);
+         return((data == NULL)?0.0:data->baseRms);
+      }
+
+      //! Get baseline guassian fit mean by ASIC handle
+      inline double baseFitMean ( int asic, uint channel, uint bucket, uint range ) const {
+         const KpixCalibData *data = findData(asic,channel,bucket,range);
+         return((data == NULL)?0.0:data->baseFitMean);
+      }
+
+      //! Get baseline guassian fit sigma by ASIC handle
+      inline double baseFitSigma ( int asic, uint channel, uint bucket, uint range ) const {
+         const KpixCalibData *data = findData(asic,channel,bucket,range);
+         return((data == NULL)?0.0:data->baseFitSigma);
+      }
+
+      //! Get baseline guassian fit mean error by ASIC handle
+      inline double baseFitMeanErr ( int asic, uint channel, uint bucket, uint range ) const {
+         const KpixCalibData *data = findData(asic,channel,bucket,range);
+         return((data == NULL)?0.0:data->baseFitMeanErr);
+      }
+
+      //! Get baseline guassian fit sigma error by ASIC handle
+      inline double baseFitSigmaErr ( int asic, uint channel, uint bucket, uint range ) const {
+         const KpixCalibData *data = findData(asic,channel,bucket,range);
+         return((data == NULL)?0.0:data->baseFitSigmaErr);
+      }
+
+      //! Get baseline guassian fit chisquare by ASIC handle
+      inline double baseFitChisquare ( int asic, uint channel, uint bucket, uint range ) const {
+         const KpixCalibData *data = findData(asic,channel,bucket,range);
+         return((data == NULL)?0.0:data->baseFitChisquare);
+      }
+
+      //! Get calibration gain by ASIC handle
+      inline double calibGain ( int asic, uint channel, uint bucket, uint range ) const {
+         const KpixCalibData *data = findData(asic,channel,bucket,range);
+         return((data == NULL)?0.0:data->calibGain);
+      }
+
+      //! Get calibration intercept by ASIC handle
+      inline double calibIntercept ( int asic, uint channel, uint bucket, uint range ) const {
+         const KpixCalibData *data = findData(asic,channel,bucket,range);
+         return((data == NULL)?0.0:data->calibIntercept);
+      }
+
+      //! Get calibration gain error by ASIC handle
+      inline double calibGainErr ( int asic, uint channel, uint bucket, uint range ) const {
+         const KpixCalibData *data = findData(asic,channel,bucket,range);
+         return((data == NULL)?0.0:data->calibGainErr);
+      }
+
+      //! Get calibration gain rms by ASIC handle
+      inline double calibGainRms ( int asic, uint channel, uint bucket, uint range ) const {
+         const KpixCalibData *data = findData(asic,channel,bucket,range);
+         return((data == NULL)?0.0:data->calibGainRms);
+      }
+
+      //! Get calibration intercept error by ASIC handle
+      inline double calibInterceptErr ( int asic, uint channel, uint bucket, uint range ) const {
+         const KpixCalibData *data = findData(asic,channel,bucket,range);
+         return((data == NULL)?0.0:data->calibInterceptErr);
+      }
+
+      //! Get calibration chisquare by ASIC handle
+      inline double calibChisquare ( int asic, uint channel, uint bucket, uint range ) const {
+         const KpixCalibData *data = findData(asic,channel,bucket,range);
+         return((data == NULL)?0.0:data->calibChisquare);
+      }
+
+      //! Get bad channel flag by ASIC handle
+      inline uint badChannel ( int asic, uint channel ) const {
+         const KpixCalibData *data = findData(asic,channel,0,0);
+         return((data == NULL)?0:data->badChannel);
+      }
+
+      //! Get crosstalk string by ASIC handle
+      string calibCrossTalk ( int asic, uint channel, uint bucket, uint range ) const;
+
+      //! Get calibration value by name and ASIC handle
+      double calibByName ( int asic, uint channel, uint bucket, uint range, string name ) const;
 
 };
 
@@ -0,0 +1,163 @@
+//-----------------------------------------------------------------------------
+// File          : KpixChargeTable.cpp
+// Author        : agent  <agent@local>
+// Created       : 10/19/2026
+// Project       : KPIX Control Software
+//-----------------------------------------------------------------------------
+// Description :
+// This class holds baseline and gain pairs extracted once from KpixCalibRead
+// and converts samples to charge without calibration lookups.
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 by SLAC. All rights reserved.
+// Proprietary and confidential to SLAC.
+//-----------------------------------------------------------------------------
+// Modification history :
+// 10/19/2026: created
+//-----------------------------------------------------------------------------
+#include <string.h>
+#include "KpixChargeTable.h"
+#include "KpixCalibRead.h"
+#include "KpixEvent.h"
+using namespace std;
+
+// Charge Table Class Constructor
+KpixChargeTable::KpixChargeTable ( ) {
+   uint x;
+
+   for (x=0; x < 32; x++) asic_[x] = NULL;
+   fitMean_    = true;
+   gainMin_    = 3e-15;
+   skipBad_    = true;
+   validCount_ = 0;
+}
+
+// Charge Table Class DeConstructor
+KpixChargeTable::~KpixChargeTable ( ) {
+   uint x;
+
+   for (x=0; x < 32; x++) if ( asic_[x] != NULL ) delete asic_[x];
+}
+
+// Use gaussian fit mean for the baseline
+void KpixChargeTable::setFitMean ( bool enable ) {
+   fitMean_ = enable;
+}
+
+// Set minimum gain for a valid channel
+void KpixChargeTable::setGainMin ( double min ) {
+   gainMin_ = min;
+}
+
+// Exclude channels flagged bad in the calibration
+void KpixChargeTable::setSkipBad ( bool enable ) {
+   skipBad_ = enable;
+}
+
+// Build pairs for ASIC address from calibration
+bool KpixChargeTable::addAsic ( uint address, KpixCalibRead *calib, const string &serial ) {
+   KpixChargeAsic *asic;
+   KpixChargePair *pair;
+   int            handle;
+   uint           channel;
+   uint           bucket;
+   uint           range;
+   double         mean;
+   double         gain;
+   bool           bad;
+   uint           x;
+
+   if ( address > 31 ) return(false);
+
+   // Remove existing entry
+   if ( asic_[address] != NULL ) {
+      for (x=0; x < 1024*4*2; x++)
+         if ( asic_[address]->pair[x].scale != 0 ) validCount_--;
+      delete asic_[address];
+      asic_[address] = NULL;
+   }
+   if ( (handle = calib->findAsic(serial)) < 0 ) return(false);
+
+   asic = new KpixChargeAsic;
+   memset(asic,0,sizeof(KpixChargeAsic));
+
+   for (channel=0; channel < 1024; channel++) {
+      bad = skipBad_ && calib->badChannel(handle,channel) != 0;
+
+      for (bucket=0; bucket < 4; bucket++) {
+         for (range=0; range < 2; range++) {
+            pair = &(asic->pair[(channel*4+bucket)*2+range]);
+
+            if ( fitMean_ ) mean = calib->baseFitMean(handle,channel,bucket,range);
+            else mean = calib->baseMean(handle,channel,bucket,range);
+            gain = calib->calibGain(handle,channel,bucket,range);
+
+            // Scale of zero marks an invalid entry
+            if ( ! bad && mean > 0 && gain > gainMin_ ) {
+               pair->offset = mean;
+               pair->scale  = 1.0 / gain;
+               validCount_++;
+            }
+         }
+      }
+   }
+   asic_[address] = asic;
+   return(true);
+}
+
+// Number of active ASICs
+uint KpixChargeTable::asicCount ( ) const {
+   uint x;
+   uint ret;
+
+   ret = 0;
+   for (x=0; x < 32; x++) if ( asic_[x] != NULL ) ret++;
+   return(ret);
+}
+
+// Number of valid channel/bucket/range entries
+uint KpixChargeTable::validCount ( ) const {
+   return(validCount_);
+}
+
+// Memory used by the table in bytes
+uint KpixChargeTable::memoryUsage ( ) const {
+   return(sizeof(KpixChargeTable) + asicCount() * sizeof(KpixChargeAsic));
+}
+
+// Convert all samples in event
+uint KpixChargeTable::convert ( KpixEvent *event, double *charge, bool *valid ) const {
+   const KpixChargePair *pair;
+   KpixChargeAsic       *asic;
+   uint                 *data;
+   uint                 count;
+   uint                 word;
+   uint                 address;
+   uint                 ret;
+   uint                 x;
+
+   count = event->count();
+   data  = event->sampleData();
+   ret   = 0;
+
+   for (x=0; x < count; x++) {
+      word    = data[x*2];
+      address = (word >> 16) & 0xFFF;
+
+      // Data samples only, see KpixSample for the format
+      asic = (((word >> 28) & 0xF) == 0 && address < 32) ? asic_[address] : NULL;
+
+      // Channel, bucket and range bits pack directly into the pair index
+      pair = (asic == NULL) ? NULL : &(asic->pair[((word & 0x3FF) << 3) | (((word >> 10) & 0x3) << 1) | ((word >> 13) & 0x1)]);
+
+      if ( pair != NULL && pair->scale != 0 ) {
+         charge[x] = ((double)(data[x*2+1] & 0x1FFF) - pair->offset) * pair->scale;
+         valid[x]  = true;
+         ret++;
+      }
+      else {
+         charge[x] = 0;
+         valid[x]  = false;
+      }
+   }
+   return(ret);
+}
@@ -0,0 +1,122 @@
+//-----------------------------------------------------------------------------
+// File          : KpixChargeTable.h
+// Author        : agent  <agent@local>
+// Created       : 10/19/2026
+// Project       : KPIX Control Software
+//-----------------------------------------------------------------------------
+// Description :
+// This class holds baseline and gain pairs extracted once from KpixCalibRead
+// and converts samples to charge without calibration lookups.
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 by SLAC. All rights reserved.
+// Proprietary and confidential to SLAC.
+//-----------------------------------------------------------------------------
+// Modification history :
+// 10/19/2026: created
+//-----------------------------------------------------------------------------
+#ifndef __KPIX_CHARGE_TABLE_H__
+#define __KPIX_CHARGE_TABLE_H__
+
+#include <string>
+#include <sys/types.h>
+using namespace std;
+
+#ifdef __CINT__
+#define uint unsigned int
+#endif
+
+class KpixCalibRead;
+class KpixEvent;
+
+//! Class used to convert samples to charge from calibration constants.
+/*!
+ * Each channel, bucket and range holds a fused pair so that
+ * charge = (value - offset) * scale. Channels which do not pass the
+ * calibration cuts have a scale of zero and are reported as invalid.
+ * Storage is only allocated for ASIC addresses added with addAsic().
+ */
+class KpixChargeTable {
+
+      // Fused baseline and gain pair
+      class KpixChargePair {
+         public:
+            double offset;
+            double scale;
+      };
+
+      // Pairs for one ASIC, indexed by (channel*4+bucket)*2+range
+      class KpixChargeAsic {
+         public:
+            KpixChargePair pair[1024*4*2];
+      };
+
+      // ASICs by address, NULL if not active
+      KpixChargeAsic *asic_[32];
+
+      // Calibration cuts
+      bool   fitMean_;
+      double gainMin_;
+      bool   skipBad_;
+
+      // Number of valid channel/bucket/range entries
+      uint validCount_;
+
+   public:
+
+      //! Charge Table Class Constructor
+      KpixChargeTable ( );
+
+      //! Charge Table Class DeConstructor
+      ~KpixChargeTable ( );
+
+      //! Use gaussian fit mean for the baseline, otherwise the raw mean. Default true.
+      void setFitMean ( bool enable );
+
+      //! Set minimum gain for a valid channel. Default 3e-15.
+      void setGainMin ( double min );
+
+      //! Exclude channels flagged bad in the calibration. Default true.
+      void setSkipBad ( bool enable );
+
+      //! Build pairs for ASIC address from calibration
+      /*!
+       * Replaces any existing entry for the address. Returns false and leaves
+       * the address inactive if the calibration does not contain the serial
+       * number. Cuts must be set before calling.
+       */
+      bool addAsic ( uint address, KpixCalibRead *calib, const string &serial );
+
+      //! Number of active ASICs
+      uint asicCount ( ) const;
+
+      //! Number of valid channel/bucket/range entries
+      uint validCount ( ) const;
+
+      //! Memory used by the table in bytes
+      uint memoryUsage ( ) const;
+
+      //! Convert single sample, returns false if no valid calibration
+      inline bool charge ( uint address, uint channel, uint bucket, uint range, uint value, double *charge ) const {
+         const KpixChargePair *pair;
+
+         if ( address > 31 || asic_[address] == NULL ) return(false);
+         if ( channel > 1023 || bucket > 3 || range > 1 ) return(false);
+
+         pair = &(asic_[address]->pair[(channel*4+bucket)*2+range]);
+         if ( pair->scale == 0 ) return(false);
+
+         *charge = ((double)value - pair->offset) * pair->scale;
+         return(true);
+      }
+
+      //! Convert all samples in event
+      /*!
+       * charge and valid must hold event->count() entries. Non data samples
+       * and samples without valid calibration are set invalid with zero charge.
+       * Returns the number of valid samples.
+       */
+      uint convert ( KpixEvent *event, double *charge, bool *valid ) const;
+
+};
+
+#endif
@@ -24,8 +24,24 @@
 #include <iostream>
 #include <string>
 #include <iomanip>
+#include <string.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
 using namespace std;
 
+// Calibration state names, order of KpixCalState
+static const char *calStateNames[] = { "Idle", "Baseline", "Inject" };
+
+// Monotonic time in microseconds
+static uint64_t runTime ( ) {
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC,&now);
+   return((uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000);
+}
+
 // Constructor
 KpixControl::KpixControl ( CommLink *commLink, string defFile, uint kpixCount ) : System("KpixControl",commLink) {
 
@@ -46,6 +62,8 @@ KpixControl::KpixControl ( CommLink *commLink, string defFile, uint kpixCount )
    states[2] = "Running Calibration";
    states[3] = "Evr Running";
    getVariable("RunState")->setEnums(states);
+   runState_    = RunStopped;
+   runProgress_ = 0;
 
    // Set run rates
    vector<string> rates;
@@ -109,14 +127,25 @@ KpixControl::KpixControl ( CommLink *commLink, string defFile, uint kpixCount )
    getVariable("CalChanMax")->setRange(0,1023);
    getVariable("CalChanMax")->setInt(1023);
 
+   addVariable(new Variable("CalSettleTime",Variable::Configuration));
+   getVariable("CalSettleTime")->setDescription("Extra time in microseconds between a channel change\n"
+                                                "and the next calibration event. A new channel settles\n"
+                                                "once its registers have been read back and the events\n"
+                                                "of its first dac point, which the fitter does not use,\n"
+                                                "have been received");
+   getVariable("CalSettleTime")->setRange(0,1000000);
+   getVariable("CalSettleTime")->setInt(0);
+
    addVariable(new Variable("CalState",Variable::Status));
    getVariable("CalState")->setDescription("Calibration state");
    vector<string> calState;
    calState.resize(3);
-   calState[0] = "Idle";
-   calState[1] = "Baseline";
-   calState[2] = "Inject";
+   calState[CalIdle]     = calStateNames[CalIdle];
+   calState[CalBaseline] = calStateNames[CalBaseline];
+   calState[CalInject]   = calStateNames[CalInject];
    getVariable("CalState")->setEnums(calState);
+   getVariable("CalState")->set(calStateNames[CalIdle]);
+   calState_ = CalIdle;
 
    addVariable(new Variable("CalChannel",Variable::Status));
    getVariable("CalChannel")->setDescription("Calibration channel");
@@ -146,41 +175,134 @@ KpixControl::KpixControl ( CommLink *commLink, string defFile, uint kpixCount )
 
    // Add sub-devices
    addDevice(new ConFpga(0, 0, kpixCount, this));
+
+   // Run pacing timer and wake up event
+   runTimerFd_ = timerfd_create(CLOCK_MONOTONIC,TFD_NONBLOCK);
+   runEventFd_ = eventfd(0,EFD_NONBLOCK);
+   if ( runTimerFd_ < 0 || runEventFd_ < 0 ) {
+      if ( runTimerFd_ >= 0 ) ::close(runTimerFd_);
+      if ( runEventFd_ >= 0 ) ::close(runEventFd_);
+      throw(string("KpixControl::KpixControl -> Error creating run timer"));
+   }
 }
 
 // Deconstructor
-KpixControl::~KpixControl ( ) { }
+KpixControl::~KpixControl ( ) { 
+   ::close(runTimerFd_);
+   ::close(runEventFd_);
+}
+
+// Wait for run pacing time, wake up or timeout
+void KpixControl::runWait ( uint64_t end, uint wait ) {
+   struct itimerspec timer;
+   struct timespec   timeout;
+   struct pollfd     fds[2];
+   uint64_t          val;
+
+   // Absolute deadline on monotonic clock
+   memset(&timer,0,sizeof(timer));
+   timer.it_value.tv_sec  = end / 1000000;
+   timer.it_value.tv_nsec = (end % 1000000) * 1000;
+   timerfd_settime(runTimerFd_,TFD_TIMER_ABSTIME,&timer,NULL);
+
+   fds[0].fd     = runTimerFd_;
+   fds[0].events = POLLIN;
+   fds[1].fd     = runEventFd_;
+   fds[1].events = POLLIN;
+
+   timeout.tv_sec  = wait / 1000000;
+   timeout.tv_nsec = (wait % 1000000) * 1000;
+
+   if ( ppoll(fds,2,(wait == 0)?NULL:&timeout,NULL) > 0 ) {
+      if ( fds[0].revents & POLLIN ) read(runTimerFd_,&val,sizeof(val));
+      if ( fds[1].revents & POLLIN ) read(runEventFd_,&val,sizeof(val));
+   }
+}
+
+// Set run state variable and cached run state
+void KpixControl::updateRunState ( string state ) {
+   getVariable("RunState")->set(state);
+   runState_ = (KpixRunState)getVariable("RunState")->getInt();
+}
+
+// Set calibration state, variable set on change
+void KpixControl::updateCalState ( KpixCalState state ) {
+   if ( state == calState_ ) return;
+   calState_ = state;
+   getVariable("CalState")->set(calStateNames[state]);
+}
+
+// Set run progress, variable set on change
+void KpixControl::updateRunProgress ( uint progress ) {
+   if ( progress == runProgress_ ) return;
+   runProgress_ = progress;
+   getVariable("RunProgress")->setInt(progress);
+}
+
+// Wake run thread on data arrival
+void KpixControl::dataReceived ( ) {
+   uint64_t val;
+
+   val = 1;
+   write(runEventFd_,&val,sizeof(val));
+}
+
+// Build calibration schedule
+void KpixControl::calibSchedule ( vector<KpixCalStep> *sched ) {
+   KpixCalStep step;
+   uint        calMeanCount;
+   uint        calDacCount;
+   uint        calDacMin;
+   uint        calDacMax;
+   uint        calDacStep;
+   uint        calChanMin;
+   uint        calChanMax;
+   uint        chan;
+   uint        dac;
+
+   calMeanCount = getVariable("CalMeanCount")->getInt();
+   calDacCount  = getVariable("CalDacCount")->getInt();
+   calDacMin    = getVariable("CalDacMin")->getInt();
+   calDacMax    = getVariable("CalDacMax")->getInt();
+   calDacStep   = getVariable("CalDacStep")->getInt();
+   calChanMin   = getVariable("CalChanMin")->getInt();
+   calChanMax   = getVariable("CalChanMax")->getInt();
+   if ( calDacStep == 0 ) calDacStep = 1;
+
+   sched->clear();
+
+   // Baseline with all channels disabled
+   step.channel = 9999;
+   step.dac     = calDacMin;
+   step.count   = calMeanCount;
+   step.settle  = false;
+   sched->push_back(step);
+
+   // Cal count value is zero
+   if ( calDacCount == 0 ) return;
+
+   // Each channel steps through the dac range. The first dac point of a
+   // new channel is read back and its events settle the front end
+   if ( calChanMax >= calChanMin && calDacMax >= calDacMin )
+      sched->reserve(sched->size() + (calChanMax - calChanMin + 1) * (((calDacMax - calDacMin) / calDacStep) + 1));
+
+   for (chan=calChanMin; chan <= calChanMax; chan++) {
+      for (dac=calDacMin; dac <= calDacMax; dac += calDacStep) {
+         step.channel = chan;
+         step.dac     = dac;
+         step.count   = calDacCount;
+         step.settle  = (dac == calDacMin);
+         sched->push_back(step);
+      }
+   }
+}
 
 // Setup config for calibration
-void KpixControl::calibConfig ( uint channel, uint dac ) {
-   uint            x;
-   uint            col;
-   uint            row;
-   string          modeString;
+void KpixControl::calibConfig ( KpixCalStep *step ) {
    stringstream    newConfig;
-   newConfig.str("");
-
-   // Row column index
-   col = (channel>1023)?32:(channel/32);
-   row = channel%32;
 
    // Disable self trigger. Set forced trigger
-   newConfig << "<system><config><cntrlFpga>";
-   newConfig << "<RunMode>Calibrate</RunMode>";
-   newConfig << "<kpixAsic>";
-   newConfig << "<CntrlCalSource>Internal</CntrlCalSource>";
-   newConfig << "<CntrlForceTrigSource>Internal</CntrlForceTrigSource>";
-   newConfig << "<CntrlTrigDisable>True</CntrlTrigDisable>";
-   newConfig << "<DacCalibration>"<< dec << dac << "</DacCalibration>";
-   for (x=0; x < 32; x++) {
-      newConfig << "<Chan_" << setw(4) << setfill('0') << dec << (x*32) << "_" << setw(4) << setfill('0') << dec << ((x*32)+31) << ">";
-      modeString = "DDDDDDDDDDDDDDDDDDDDDDDDDDDDDDDD";
-      if ( col == x ) modeString[row] = 'C';
-      newConfig << modeString;
-      newConfig << "</Chan_" << setw(4) << setfill('0') << dec << (x*32) << "_" << setw(4) << setfill('0') << dec << ((x*32)+31) << ">";
-   }
-   newConfig << "</kpixAsic></cntrlFpga></config></system>\n";
-   parseXml(newConfig.str(),false);
+   ((ConFpga*)(device("cntrlFpga",0)))->writeCalibConfig(step->channel,step->dac,step->settle);
 
    // Update a few status variables in data file
    newConfig.str("");
@@ -194,23 +316,23 @@ void KpixControl::calibConfig ( uint channel, uint dac ) {
 }
 
 void KpixControl::swRunThread() {
-   struct timespec tme;
-   ulong           ctime;
-   ulong           ltime;
+   uint64_t        ctime;
+   uint64_t        ltime;
+   uint64_t        next;
+   uint64_t        settle;
+   uint64_t        end;
+   uint            wait;
    uint            runTotal;
    uint            stepTotal;
    uint            lastData;
-   uint            calMeanCount;
-   uint            calDacCount;
-   uint            calDacMin;
-   uint            calDacMax;
-   uint            calDacStep;
-   uint            calChanMin;
-   uint            calChanMax;
    uint            calTotal;
-   uint            calChan;
-   uint            calDac;
+   uint            calSettle;
+   uint            calStep;
+   bool            calPrep;
+   uint            x;
    bool            gotEvent;
+   ConFpga         *fpga;
+   vector<KpixCalStep> calSched;
    stringstream    oldConfig;
    stringstream    xml;
 
@@ -222,8 +344,16 @@ void KpixControl::swRunThread() {
    stepTotal   = 0;
    swRunning_  = true;
    swRunError_ = "";
-   clock_gettime(CLOCK_REALTIME,&tme);
-   ltime = (tme.tv_sec * 1000000) + (tme.tv_nsec/1000);
+   ltime       = runTime();
+   next        = ltime + swRunPeriod_;
+   settle      = 0;
+   calTotal    = 0;
+   calStep     = 0;
+   calPrep     = false;
+   fpga        = (ConFpga*)(device("cntrlFpga",0));
+
+   // Progress variable is written on first update
+   runProgress_ = 0xFFFFFFFF;
 
    // Show start
    if ( debug_ ) {
@@ -241,51 +371,37 @@ void KpixControl::swRunThread() {
       writeConfig(false);
 
       // Calibration run enabled
-      if ( getVariable("RunState")->get() == "Running Calibration" ) {
-         calMeanCount = getVariable("CalMeanCount")->getInt();
-         calDacCount  = getVariable("CalDacCount")->getInt();
-         calDacMin    = getVariable("CalDacMin")->getInt();
-         calDacMax    = getVariable("CalDacMax")->getInt();
-         calDacStep   = getVariable("CalDacStep")->getInt();
-         calChanMin   = getVariable("CalChanMin")->getInt();
-         calChanMax   = getVariable("CalChanMax")->getInt();
-         calTotal     = calMeanCount + ((calChanMax - calChanMin + 1) * ((calDacMax - calDacMin + 1)/calDacStep) * calDacCount);
-         calChan      = calChanMin;
-         calDac       = calDacMin;
+      if ( runState_ == RunCalibration ) {
+         calibSchedule(&calSched);
+         for (x=0; x < calSched.size(); x++) calTotal += calSched[x].count;
+         calSettle = getVariable("CalSettleTime")->getInt();
 
          // Save old configuration
          oldConfig << "<system>" << endl << configString(true,false) << "</system>" << endl;
 
          // Update variables
-         getVariable("CalState")->set("Baseline");
+         updateCalState(CalBaseline);
          getVariable("CalChannel")->setInt(0);
          getVariable("CalDac")->setInt(0);
 
          // Update config
-         calibConfig(9999,calDac);
+         calibConfig(&(calSched[0]));
+         calPrep = true;
       }
-      else getVariable("CalState")->set("Idle");
+      else updateCalState(CalIdle);
 
       // Run
       while ( swRunEnable_ ) {
 
-         // Delay between attempts
-         do {
-            usleep(1);
-            clock_gettime(CLOCK_REALTIME,&tme);
-            ctime = (tme.tv_sec * 1000000) + (tme.tv_nsec/1000);
-         } while ( (ctime-ltime) < swRunPeriod_);
-
          // Check that we received a data frame
          gotEvent = true;
+         wait     = KPIX_RUN_BUSY_WAIT;
 
          while ( commLink_->dataRxCount() == lastData ) {
-            usleep(1);
-            clock_gettime(CLOCK_REALTIME,&tme);
-            ctime = (tme.tv_sec * 1000000) + (tme.tv_nsec/1000);
+            ctime = runTime();
 
             // One second has passed. event was missed.
-            if ( (ctime-ltime) > 1000000) {
+            if ( (ctime-ltime) > KPIX_RUN_MISS_TIME ) {
                ltime = ctime;
 
                // In Simulation just make some noise
@@ -304,81 +420,69 @@ void KpixControl::swRunThread() {
                }
             }
             if ( !swRunEnable_ ) break;
+
+            // Sleep until data or missed event, wait grows while idle
+            runWait(ltime + KPIX_RUN_MISS_TIME + 1,wait);
+            wait *= 2;
+            if ( wait > KPIX_RUN_IDLE_WAIT ) wait = KPIX_RUN_IDLE_WAIT;
          }
          if ( !swRunEnable_ ) break; 
 
          // Setup next calibration data point
-         if ( getVariable("RunState")->get() == "Running Calibration" ) {
+         if ( runState_ == RunCalibration ) {
             if ( gotEvent ) {
                runTotal++;
                stepTotal++;
             }
-            getVariable("RunProgress")->setInt((uint)(((double)runTotal/(double)calTotal)*100.0));
-
-            // running baseline
-            if ( gotEvent && getVariable("CalState")->get() == "Baseline" ) {
-
-               // Mean run is done
-               if ( runTotal >= calMeanCount ) {
-
-                  // Cal count value is zero
-                  if ( calDacCount == 0 ) break;
-
-                  // Setup calibration
-                  else {
-                     usleep(100000);
-                     getVariable("CalState")->set("Inject");
-                     calChan = calChanMin;
-                     calDac  = calDacMin;
-                     getVariable("CalChannel")->setInt(calChan);
-                     getVariable("CalDac")->setInt(calDac);
-                     calibConfig(calChan,calDac);
-                     stepTotal = 0;
-                  }
-               }
-            }
-
-            // running calibration
-            else if ( gotEvent && getVariable("CalState")->get() == "Inject" ) {
-
-               // Have we taken enough points at this value?
-               if ( stepTotal >= calDacCount ) {
-
-                  // Increment cal dac
-                  calDac += calDacStep;
-                  if ( calDac > calDacMax ) {
-                     usleep(100000);
-                     calDac = calDacMin;
-                     calChan++;
-                  }
-
-                  // Are we done?
-                  if ( calChan > calChanMax ) break;
-
-                  // Write config
-                  getVariable("CalChannel")->setInt(calChan);
-                  getVariable("CalDac")->setInt(calDac);
-                  calibConfig(calChan,calDac);
-                  stepTotal = 0;
-               }
+            updateRunProgress((uint)(((uint64_t)runTotal * 100) / calTotal));
+
+            // Step is done, its successor was prepared during acquisition
+            if ( gotEvent && stepTotal >= calSched[calStep].count ) {
+               calStep++;
+
+               // Are we done?
+               if ( calStep >= calSched.size() ) break;
+
+               // Write config, new channel is read back before its first event
+               updateCalState(CalInject);
+               getVariable("CalChannel")->setInt(calSched[calStep].channel);
+               getVariable("CalDac")->setInt(calSched[calStep].dac);
+               calibConfig(&(calSched[calStep]));
+               if ( calSched[calStep].settle ) settle = runTime() + calSettle;
+               calPrep   = true;
+               stepTotal = 0;
             }
          }
          else {
             if ( gotEvent ) runTotal++;
-            if ( swRunCount_ == 0 ) getVariable("RunProgress")->setInt(0);
-            else getVariable("RunProgress")->setInt((uint)(((double)runTotal/(double)swRunCount_)*100.0));
+            if ( swRunCount_ == 0 ) updateRunProgress(0);
+            else updateRunProgress((uint)(((uint64_t)runTotal * 100) / swRunCount_));
             if ( swRunCount_ != 0 && runTotal >= swRunCount_ ) break;
          }
 
-         // Execute command
+         // Delay between attempts and after calibration channel change
+         end = (next > settle)?next:settle;
+         while ( swRunEnable_ && runTime() < end ) runWait(end,0);
+         if ( !swRunEnable_ ) break;
+
+         // Execute command, next one a period after this one was due unless
+         // it is already more than a period late
          lastData = commLink_->dataRxCount();
-         ltime = ctime;
+         ltime    = runTime();
+         next    += swRunPeriod_;
+         if ( next < ltime ) next = ltime + swRunPeriod_;
          commLink_->queueRunCommand();
+
+         // Prepare next calibration step while this event is acquired
+         if ( calPrep && (calStep+1) < calSched.size() ) 
+            fpga->prepCalibConfig(calSched[calStep+1].channel,calSched[calStep+1].dac);
+         calPrep = false;
       }
 
       // Restore configuration here
-      if ( getVariable("RunState")->get() == "Running Calibration" ) {
-         getVariable("CalState")->set("Idle");
+      if ( runState_ == RunCalibration ) {
+
+         updateCalState(CalIdle);
          getVariable("CalChannel")->setInt(0);
          parseXml(oldConfig.str(),false);
          usleep(100);
@@ -394,7 +498,7 @@ void KpixControl::swRunThread() {
    // Cleanup
    sleep(1);
 
-   getVariable("RunState")->set(swRunRetState_);
+   updateRunState(swRunRetState_);
    swRunning_ = false;
 }
 
@@ -434,6 +538,7 @@ void KpixControl::setRunState ( string state ) {
 
       if ( swRunEnable_ ) {
          swRunEnable_ = false;
+         dataReceived();
          pthread_join(swRunThread_,NULL);
       }
 
@@ -442,7 +547,7 @@ void KpixControl::setRunState ( string state ) {
          device("cntrlFpga",0)->set("AcquisitionTrigger","Software");
          writeConfig(false);
          hwRunning_ = false;
-         getVariable("RunState")->set(state);
+         updateRunState(state);
       }
 
       allStatusReq_ = true;
@@ -464,7 +569,7 @@ void KpixControl::setRunState ( string state ) {
 
       swRunRetState_ = "Stopped";
       swRunEnable_   = true;
-      getVariable("RunState")->set(state);
+      updateRunState(state);
 
       // Setup run parameters
       swRunCount_ = getInt("RunCount");
@@ -487,7 +592,7 @@ void KpixControl::setRunState ( string state ) {
       if ( pthread_create(&swRunThread_,NULL,swRunStatic,this) ) {
          err << "KpixControl::startRun -> Failed to create ioThread" << endl;
          if ( debug_ ) cout << err.str();
-         getVariable("RunState")->set(swRunRetState_);
+         updateRunState(swRunRetState_);
          throw(err.str());
       }
 
@@ -500,7 +605,7 @@ void KpixControl::setRunState ( string state ) {
             swRunEnable_ = false;
             err << "KpixControl::startRun -> Timeout waiting for runthread" << endl;
             if ( debug_ ) cout << err.str();
-            getVariable("RunState")->set(swRunRetState_);
+            updateRunState(swRunRetState_);
             throw(err.str());
          }
       }
@@ -516,7 +621,7 @@ void KpixControl::setRunState ( string state ) {
 
       swRunRetState_ = "Stopped";
       hwRunning_   = true;
-      getVariable("RunState")->set(state);
+      updateRunState(state);
 
       device("cntrlFpga",0)->set("AcquisitionTrigger","Event Receiver");
       writeConfig(false);
@@ -529,10 +634,10 @@ string KpixControl::localState ( ) {
 
    loc = "System Ready To Take Data.\n";
 
-   if ( getVariable("RunState")->get() == "Running Calibration" ) {
+   if ( runState_ == RunCalibration ) {
       loc.append("Calibration running: ");
-      loc.append(getVariable("CalState")->get());
-      if ( getVariable("CalState")->get() == "Inject" ) {
+      loc.append(calStateNames[calState_]);
+      if ( calState_ == CalInject ) {
          loc.append(" Channel: ");
          loc.append(getVariable("CalChannel")->get());
       }
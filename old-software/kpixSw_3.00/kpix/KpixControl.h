@@ -17,15 +17,64 @@
 #define __KPIX_CONTROL_H__
 
 #include <System.h>
+#include <stdint.h>
+#include <vector>
 using namespace std;
 
+// First and longest wait in microseconds between data count checks
+#define KPIX_RUN_BUSY_WAIT 10
+#define KPIX_RUN_IDLE_WAIT 1000
+
+// Time in microseconds after which a data event is missed
+#define KPIX_RUN_MISS_TIME 1000000
+
 class CommLink;
 
+//! Calibration step, count events taken at channel and dac
+class KpixCalStep {
+   public:
+      uint channel;
+      uint dac;
+      uint count;
+      bool settle;
+};
+
 //! Class to contain APV25 
 class KpixControl : public System {
 
-      // setup calibration config
-      void calibConfig ( uint channel, uint dac );
+      // Run states, order of RunState enums
+      enum KpixRunState { RunStopped, RunRunning, RunCalibration, RunEvr };
+
+      // Calibration states, order of CalState enums
+      enum KpixCalState { CalIdle, CalBaseline, CalInject };
+
+      // Cached states and progress, variables are only set on change
+      KpixRunState runState_;
+      KpixCalState calState_;
+      uint         runProgress_;
+
+      // Set run state variable and cached run state
+      void updateRunState ( string state );
+
+      // Set calibration state
+      void updateCalState ( KpixCalState state );
+
+      // Set run progress in percent
+      void updateRunProgress ( uint progress );
+
+      // Run pacing timer and run thread wake up event
+      int runTimerFd_;
+      int runEventFd_;
+
+      // Wait until monotonic time end in microseconds, a wake up or for
+      // at most wait microseconds if wait is non zero
+      void runWait ( uint64_t end, uint wait );
+
+      // Build calibration schedule, baseline step first
+      void calibSchedule ( vector<KpixCalStep> *sched );
+
+      // Write calibration step config
+      void calibConfig ( KpixCalStep *step );
 
       // Software run thread
       void swRunThread();
@@ -65,5 +114,14 @@ class KpixControl : public System {
       //! Method to perform hard reset
       void hardReset ( );
 
+      //! Wake run thread on data arrival
+      /*!
+       * Called by the server relay for each data record it copies out of
+       * shared memory so the run thread sees the event at once. Without
+       * it the run thread finds the event within KPIX_RUN_IDLE_WAIT
+       * microseconds.
+       */
+      void dataReceived ( );
+
 };
 #endif
@@ -86,3 +86,8 @@ KpixSample *KpixEvent::sampleCopy (uint index) {
    }
 }
 
+// Get raw sample data
+uint *KpixEvent::sampleData ( ) {
+   if ( count() == 0 ) return(NULL);
+   else return(&(data_[headSize_]));
+}
@@ -83,6 +83,13 @@ class KpixEvent : public Data {
       */
       KpixSample *sampleCopy (uint index);
 
+      //! Get raw sample data
+      /*!
+       * Returns pointer to the first sample, 2 x 32-bits per sample, or NULL
+       * if the event contains no samples. See KpixSample for the format.
+      */
+      uint *sampleData ( );
+
 };
 
 #endif
@@ -0,0 +1,495 @@
+//-----------------------------------------------------------------------------
+// File          : KpixSharedRing.cpp
+// Author        : agent  <agent@local>
+// Created       : 10/19/2026
+// Project       : KPIX Control Software
+//-----------------------------------------------------------------------------
+// Description :
+// Shared memory record ring with independent consumer cursors.
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 by SLAC. All rights reserved.
+// Proprietary and confidential to SLAC.
+//-----------------------------------------------------------------------------
+// Modification history :
+// 10/19/2026: created
+//-----------------------------------------------------------------------------
+#include <sstream>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "KpixSharedRing.h"
+using namespace std;
+
+// Segment constants
+#define KPIX_RING_MAGIC  0x4B52494E
+#define KPIX_RING_PAD    0xFFFFFFFF
+#define KPIX_RING_ALIGN  16
+#define KPIX_RING_WAIT   100
+
+// Consumer cursor
+class KpixRingConsumer {
+   public:
+      uint     active;
+      uint     mode;
+      uint     stalled;
+      pid_t    pid;
+      uint64_t pos;
+      uint64_t seq;
+      uint64_t records;
+      uint64_t drops;
+};
+
+// Segment header, positions count bytes written since creation
+class KpixRingHeader {
+   public:
+      uint             magic;
+      uint             size;
+      pid_t            writer;
+      uint             closed;
+      pthread_mutex_t  mutex;
+      pthread_cond_t   dataCond;
+      pthread_cond_t   spaceCond;
+      uint             dataWaiters;
+      uint             spaceWaiters;
+      uint64_t         head;
+      uint64_t         reserve;
+      uint64_t         records;
+      KpixRingConsumer consumer[KPIX_RING_CONSUMERS];
+};
+
+// Record header, payload follows padded to KPIX_RING_ALIGN
+class KpixRingRecord {
+   public:
+      uint     flag;
+      uint     size;
+      uint64_t seq;
+};
+
+// Header space before ring data
+static size_t ringHeaderSize ( ) {
+   return((sizeof(KpixRingHeader) + 63) & ~((size_t)63));
+}
+
+// Lock segment mutex, recover if owner died
+static void ringLock ( KpixRingHeader *ring ) {
+   if ( pthread_mutex_lock(&(ring->mutex)) == EOWNERDEAD ) pthread_mutex_consistent(&(ring->mutex));
+}
+
+// Wait on segment condition until deadline, returns false on timeout
+static bool ringWait ( KpixRingHeader *ring, pthread_cond_t *cond, struct timespec *deadline ) {
+   int ret;
+
+   if ( (ret = pthread_cond_timedwait(cond,&(ring->mutex),deadline)) == EOWNERDEAD )
+      pthread_mutex_consistent(&(ring->mutex));
+   return(ret != ETIMEDOUT);
+}
+
+// Deadline timeout milliseconds from now
+static void ringDeadline ( struct timespec *deadline, uint timeout ) {
+   clock_gettime(CLOCK_MONOTONIC,deadline);
+   deadline->tv_sec  += timeout / 1000;
+   deadline->tv_nsec += (timeout % 1000) * 1000000;
+   if ( deadline->tv_nsec >= 1000000000 ) {
+      deadline->tv_sec++;
+      deadline->tv_nsec -= 1000000000;
+   }
+}
+
+// Process has exited
+static bool ringDead ( pid_t pid ) {
+   return(kill(pid,0) < 0 && errno == ESRCH);
+}
+
+// Ring Class Constructor
+KpixSharedRing::KpixSharedRing ( ) {
+   ring_       = NULL;
+   data_       = NULL;
+   mapSize_    = 0;
+   slot_       = -1;
+   writer_     = false;
+   overruns_   = 0;
+   buffer_     = NULL;
+   bufferSize_ = 0;
+}
+
+// Ring Class DeConstructor
+KpixSharedRing::~KpixSharedRing ( ) {
+   close();
+   if ( buffer_ != NULL ) free(buffer_);
+}
+
+// Map segment
+void KpixSharedRing::map ( string system, uint id, bool create, uint size ) {
+   pthread_mutexattr_t mattr;
+   pthread_condattr_t  cattr;
+   stringstream        tmp;
+   struct stat         st;
+   void                *ptr;
+   int                 fd;
+
+   close();
+   tmp << "/" << system << ".ring." << dec << id;
+   name_ = tmp.str();
+
+   // Writer starts with a clean segment
+   if ( create ) {
+      shm_unlink(name_.c_str());
+      mapSize_ = ringHeaderSize() + size;
+      if ( (fd = shm_open(name_.c_str(),O_CREAT|O_RDWR,0666)) < 0 )
+         throw(string("KpixSharedRing::create -> Failed to open ") + name_);
+      if ( ftruncate(fd,mapSize_) < 0 ) {
+         ::close(fd);
+         throw(string("KpixSharedRing::create -> Failed to size ") + name_);
+      }
+   }
+   else {
+      if ( (fd = shm_open(name_.c_str(),O_RDWR,0)) < 0 )
+         throw(string("KpixSharedRing::attach -> Failed to open ") + name_);
+      if ( fstat(fd,&st) < 0 || (size_t)st.st_size < ringHeaderSize() ) {
+         ::close(fd);
+         throw(string("KpixSharedRing::attach -> Bad segment ") + name_);
+      }
+      mapSize_ = st.st_size;
+   }
+
+   ptr = mmap(NULL,mapSize_,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+   ::close(fd);
+   if ( ptr == MAP_FAILED ) throw(string("KpixSharedRing::map -> Failed to map ") + name_);
+
+   ring_ = (KpixRingHeader *)ptr;
+   data_ = (uint8_t *)ptr + ringHeaderSize();
+
+   if ( create ) {
+      memset(ring_,0,sizeof(KpixRingHeader));
+
+      pthread_mutexattr_init(&mattr);
+      pthread_mutexattr_setpshared(&mattr,PTHREAD_PROCESS_SHARED);
+      pthread_mutexattr_setrobust(&mattr,PTHREAD_MUTEX_ROBUST);
+      pthread_mutex_init(&(ring_->mutex),&mattr);
+      pthread_mutexattr_destroy(&mattr);
+
+      pthread_condattr_init(&cattr);
+      pthread_condattr_setpshared(&cattr,PTHREAD_PROCESS_SHARED);
+      pthread_condattr_setclock(&cattr,CLOCK_MONOTONIC);
+      pthread_cond_init(&(ring_->dataCond),&cattr);
+      pthread_cond_init(&(ring_->spaceCond),&cattr);
+      pthread_condattr_destroy(&cattr);
+
+      ring_->size   = size;
+      ring_->writer = getpid();
+      __sync_synchronize();
+      ring_->magic = KPIX_RING_MAGIC;
+   }
+   else if ( ring_->magic != KPIX_RING_MAGIC || ringHeaderSize() + ring_->size > mapSize_ ) {
+      close();
+      throw(string("KpixSharedRing::attach -> Bad segment ") + name_);
+   }
+}
+
+// Create ring as writer
+void KpixSharedRing::create ( string system, uint id, uint size ) {
+   map(system,id,true,size & ~(KPIX_RING_ALIGN-1));
+   slot_     = -1;
+   writer_   = true;
+   overruns_ = 0;
+}
+
+// Attach to ring as consumer
+void KpixSharedRing::attach ( string system, uint id, Mode mode ) {
+   KpixRingConsumer *con;
+   uint             x;
+
+   map(system,id,false,0);
+
+   // Take free slot, reclaim slots of exited consumers
+   ringLock(ring_);
+   for (x=0; x < KPIX_RING_CONSUMERS; x++) {
+      con = &(ring_->consumer[x]);
+      if ( con->active == 0 || ringDead(con->pid) ) {
+         con->mode    = mode;
+         con->stalled = 0;
+         con->pid     = getpid();
+         con->pos     = ring_->head;
+         con->seq     = ring_->records;
+         con->records = 0;
+         con->drops   = 0;
+         con->active  = 1;
+         break;
+      }
+   }
+   pthread_mutex_unlock(&(ring_->mutex));
+
+   if ( x == KPIX_RING_CONSUMERS ) {
+      close();
+      throw(string("KpixSharedRing::attach -> No free consumer slot"));
+   }
+   slot_ = x;
+}
+
+// Detach from ring
+void KpixSharedRing::close ( ) {
+   if ( ring_ == NULL ) return;
+
+   // Release writer if waiting on this consumer
+   if ( slot_ >= 0 ) {
+      ringLock(ring_);
+      ring_->consumer[slot_].active = 0;
+      pthread_cond_broadcast(&(ring_->spaceCond));
+      pthread_mutex_unlock(&(ring_->mutex));
+   }
+
+   // Tell consumers to attach to the next writer
+   if ( writer_ ) {
+      ringLock(ring_);
+      ring_->closed = 1;
+      pthread_cond_broadcast(&(ring_->dataCond));
+      pthread_mutex_unlock(&(ring_->mutex));
+   }
+   munmap(ring_,mapSize_);
+   ring_    = NULL;
+   data_    = NULL;
+   mapSize_ = 0;
+   slot_    = -1;
+   writer_  = false;
+}
+
+// Wait for lossless consumers
+bool KpixSharedRing::waitSpace ( uint64_t end, uint timeout ) {
+   KpixRingConsumer *con;
+   struct timespec  deadline;
+   struct timespec  limit;
+   bool             ready;
+   bool             expired;
+   uint             x;
+
+   if ( timeout > 0 ) ringDeadline(&limit,timeout);
+   expired = false;
+
+   ringLock(ring_);
+   do {
+      ready = true;
+      for (x=0; x < KPIX_RING_CONSUMERS; x++) {
+         con = &(ring_->consumer[x]);
+         if ( con->active == 0 || con->mode != Lossless || con->stalled ) continue;
+         if ( end - con->pos <= ring_->size ) continue;
+         if ( ringDead(con->pid) ) con->active = 0;
+         else if ( expired ) con->stalled = 1;
+         else ready = false;
+      }
+      if ( ! ready ) {
+         if ( timeout > 0 && timeout < KPIX_RING_WAIT ) deadline = limit;
+         else ringDeadline(&deadline,KPIX_RING_WAIT);
+         ring_->spaceWaiters++;
+         ringWait(ring_,&(ring_->spaceCond),&deadline);
+         ring_->spaceWaiters--;
+
+         // Stop waiting once the limit has passed
+         if ( timeout > 0 ) {
+            clock_gettime(CLOCK_MONOTONIC,&deadline);
+            expired = ( deadline.tv_sec > limit.tv_sec ||
+                       (deadline.tv_sec == limit.tv_sec && deadline.tv_nsec >= limit.tv_nsec) );
+         }
+      }
+   } while ( ! ready );
+
+   // Consumers left behind, space they had not read is overwritten
+   ready = true;
+   for (x=0; x < KPIX_RING_CONSUMERS; x++) {
+      con = &(ring_->consumer[x]);
+      if ( con->active && con->mode == Lossless && con->stalled && end - con->pos > ring_->size ) ready = false;
+   }
+   pthread_mutex_unlock(&(ring_->mutex));
+   return(ready);
+}
+
+// Append record
+bool KpixSharedRing::write ( uint flag, const void *data, uint size, uint timeout ) {
+   KpixRingRecord *rec;
+   uint64_t       pos;
+   uint64_t       len;
+   uint64_t       total;
+   uint           off;
+
+   if ( ring_ == NULL || slot_ >= 0 ) return(false);
+
+   len = sizeof(KpixRingRecord) + ((size + KPIX_RING_ALIGN - 1) & ~(KPIX_RING_ALIGN-1));
+   if ( flag == KPIX_RING_PAD || len > ring_->size / 2 ) return(false);
+
+   // Records do not wrap, pad to end of ring first
+   pos   = ring_->head;
+   off   = pos % ring_->size;
+   total = len;
+   if ( ring_->size - off < len ) total += ring_->size - off;
+
+   if ( ! waitSpace(pos + total,timeout) ) overruns_++;
+
+   // Readers check reserve after copying to detect overwrites
+   ring_->reserve = pos + total;
+   __sync_synchronize();
+
+   if ( total != len ) {
+      rec = (KpixRingRecord *)(data_ + off);
+      rec->flag = KPIX_RING_PAD;
+      rec->size = ring_->size - off;
+      off = 0;
+   }
+   rec = (KpixRingRecord *)(data_ + off);
+   rec->flag = flag;
+   rec->size = size;
+   rec->seq  = ring_->records;
+   memcpy(data_ + off + sizeof(KpixRingRecord),data,size);
+   __sync_synchronize();
+
+   // Publish
+   ringLock(ring_);
+   ring_->head = pos + total;
+   ring_->records++;
+   if ( ring_->dataWaiters > 0 ) pthread_cond_broadcast(&(ring_->dataCond));
+   pthread_mutex_unlock(&(ring_->mutex));
+   return(true);
+}
+
+// Read next record
+bool KpixSharedRing::read ( uint *flag, uint8_t **data, uint *size, uint timeout ) {
+   KpixRingConsumer *con;
+   KpixRingRecord   rec;
+   struct timespec  deadline;
+   bool             waiting;
+   bool             wake;
+   uint64_t         head;
+   uint64_t         len;
+   uint             off;
+   uint8_t          *buff;
+
+   if ( ring_ == NULL || slot_ < 0 ) return(false);
+   con     = &(ring_->consumer[slot_]);
+   waiting = false;
+
+   while ( 1 ) {
+      head = *((volatile uint64_t *)&(ring_->head));
+
+      // Wait for data
+      if ( con->pos == head ) {
+         if ( timeout == 0 ) return(false);
+         if ( ! waiting ) ringDeadline(&deadline,timeout);
+         waiting = true;
+         wake    = true;
+
+         // Closed writer adds no more records
+         ringLock(ring_);
+         if ( ring_->closed ) wake = false;
+         else if ( con->pos == ring_->head ) {
+            ring_->dataWaiters++;
+            wake = ringWait(ring_,&(ring_->dataCond),&deadline);
+            ring_->dataWaiters--;
+         }
+         pthread_mutex_unlock(&(ring_->mutex));
+         if ( ! wake ) return(false);
+         continue;
+      }
+
+      // Lapped by writer, skipped records are counted as drops
+      if ( head - con->pos > ring_->size ) {
+         ringLock(ring_);
+         con->pos = ring_->head;
+         if ( ring_->records > con->seq ) con->drops += ring_->records - con->seq;
+         con->seq = ring_->records;
+         pthread_mutex_unlock(&(ring_->mutex));
+         continue;
+      }
+
+      __sync_synchronize();
+      off = con->pos % ring_->size;
+      memcpy(&rec,data_ + off,sizeof(KpixRingRecord));
+
+      if ( rec.flag == KPIX_RING_PAD ) len = ring_->size - off;
+      else if ( rec.size <= ring_->size / 2 ) {
+         len = sizeof(KpixRingRecord) + ((rec.size + KPIX_RING_ALIGN - 1) & ~(KPIX_RING_ALIGN-1));
+
+         if ( rec.size > bufferSize_ ) {
+            if ( (buff = (uint8_t *)realloc(buffer_,rec.size)) == NULL )
+               throw(string("KpixSharedRing::read -> Malloc Error"));
+            buffer_     = buff;
+            bufferSize_ = rec.size;
+         }
+         memcpy(buffer_,data_ + off + sizeof(KpixRingRecord),rec.size);
+      }
+      else len = 0;
+      __sync_synchronize();
+
+      // Record overwritten while copying
+      if ( len == 0 || *((volatile uint64_t *)&(ring_->reserve)) - con->pos > ring_->size ) {
+         con->pos = *((volatile uint64_t *)&(ring_->head));
+         continue;
+      }
+      con->pos += len;
+      if ( rec.flag == KPIX_RING_PAD ) continue;
+
+      if ( rec.seq > con->seq ) con->drops += rec.seq - con->seq;
+      con->seq = rec.seq + 1;
+      con->records++;
+      con->stalled = 0;
+
+      // Wake writer waiting on this consumer
+      if ( con->mode == Lossless && ring_->spaceWaiters > 0 ) {
+         ringLock(ring_);
+         pthread_cond_broadcast(&(ring_->spaceCond));
+         pthread_mutex_unlock(&(ring_->mutex));
+      }
+
+      *flag = rec.flag;
+      *data = buffer_;
+      *size = rec.size;
+      return(true);
+   }
+}
+
+// Number of attached consumers
+uint KpixSharedRing::consumerCount ( ) {
+   uint x;
+   uint ret;
+
+   ret = 0;
+   if ( ring_ != NULL )
+      for (x=0; x < KPIX_RING_CONSUMERS; x++) if ( ring_->consumer[x].active ) ret++;
+   return(ret);
+}
+
+// Get consumer status
+bool KpixSharedRing::consumer ( uint slot, pid_t *pid, Mode *mode, uint64_t *records, uint64_t *drops ) {
+   KpixRingConsumer *con;
+
+   if ( ring_ == NULL || slot >= KPIX_RING_CONSUMERS ) return(false);
+   con = &(ring_->consumer[slot]);
+   if ( con->active == 0 ) return(false);
+
+   *pid     = con->pid;
+   *mode    = (Mode)con->mode;
+   *records = con->records;
+   *drops   = con->drops;
+   return(true);
+}
+
+// Records dropped for this consumer
+uint64_t KpixSharedRing::drops ( ) {
+   if ( ring_ == NULL || slot_ < 0 ) return(0);
+   return(ring_->consumer[slot_].drops);
+}
+
+// Records written over unread data of stalled lossless consumers
+uint64_t KpixSharedRing::overruns ( ) {
+   return(overruns_);
+}
+
+// Consumer is attached and the writer is running
+bool KpixSharedRing::alive ( ) {
+   if ( ring_ == NULL || slot_ < 0 ) return(false);
+   return(*((volatile uint *)&(ring_->closed)) == 0 && ! ringDead(ring_->writer));
+}
@@ -0,0 +1,132 @@
+//-----------------------------------------------------------------------------
+// File          : KpixSharedRing.h
+// Author        : agent  <agent@local>
+// Created       : 10/19/2026
+// Project       : KPIX Control Software
+//-----------------------------------------------------------------------------
+// Description :
+// Shared memory record ring with independent consumer cursors.
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 by SLAC. All rights reserved.
+// Proprietary and confidential to SLAC.
+//-----------------------------------------------------------------------------
+// Modification history :
+// 10/19/2026: created
+//-----------------------------------------------------------------------------
+#ifndef __KPIX_SHARED_RING_H__
+#define __KPIX_SHARED_RING_H__
+
+#include <string>
+#include <stdint.h>
+#include <sys/types.h>
+using namespace std;
+
+#ifdef __CINT__
+#define uint unsigned int
+#endif
+
+//! Maximum number of attached consumers
+#define KPIX_RING_CONSUMERS 16
+
+class KpixRingHeader;
+
+//! Class used to pass data records between one writer and several consumers.
+/*!
+ * The writer creates the ring and appends records of a 32-bit flag and a
+ * payload. Each consumer attaches with its own read cursor. Lossy consumers
+ * never slow the writer; when the writer laps them they skip ahead to the
+ * newest record and the skipped records are counted as drops. The writer
+ * waits for lossless consumers before overwriting records they have not
+ * read, up to the write timeout. A lossless consumer which does not catch
+ * up in time is treated as lossy until its next read and the overwritten
+ * records are counted in overruns(). A lossless consumer whose process has
+ * exited is detached by the writer. Consumers wait for new records on a
+ * process shared condition.
+ *
+ * The header holds the writer pid and a closed flag. A restarted writer
+ * creates a new segment, so consumers poll alive() and attach again once
+ * the old writer has closed or exited.
+ */
+class KpixSharedRing {
+
+      // Mapped segment
+      KpixRingHeader *ring_;
+      uint8_t        *data_;
+      size_t         mapSize_;
+
+      // Segment name
+      string name_;
+
+      // Writer or consumer slot, -1 for writer
+      int slot_;
+
+      // Created as writer
+      bool writer_;
+
+      // Records written over unread lossless consumer data
+      uint64_t overruns_;
+
+      // Record copy for consumer
+      uint8_t *buffer_;
+      uint    bufferSize_;
+
+      // Map segment
+      void map ( string system, uint id, bool create, uint size );
+
+      // Wait for lossless consumers, returns false if any timed out
+      bool waitSpace ( uint64_t end, uint timeout );
+
+   public:
+
+      //! Consumer mode
+      enum Mode {
+         Lossy    = 0,
+         Lossless = 1
+      };
+
+      //! Ring Class Constructor
+      KpixSharedRing ( );
+
+      //! Ring Class DeConstructor
+      ~KpixSharedRing ( );
+
+      //! Create ring as writer, size is the payload space in bytes
+      void create ( string system, uint id, uint size );
+
+      //! Attach to ring as consumer
+      void attach ( string system, uint id, Mode mode );
+
+      //! Detach from ring
+      void close ( );
+
+      //! Append record, returns false if the record does not fit in the ring
+      /*!
+       * Waits up to timeout milliseconds for lossless consumers, 0 waits
+       * until they have read the space.
+       */
+      bool write ( uint flag, const void *data, uint size, uint timeout = 0 );
+
+      //! Read next record
+      /*!
+       * Waits up to timeout milliseconds for a record. On success data points
+       * to a copy of the record which is valid until the next read.
+       */
+      bool read ( uint *flag, uint8_t **data, uint *size, uint timeout );
+
+      //! Number of attached consumers
+      uint consumerCount ( );
+
+      //! Get consumer status, returns false if the slot is not in use
+      bool consumer ( uint slot, pid_t *pid, Mode *mode, uint64_t *records, uint64_t *drops );
+
+      //! Records dropped for this consumer
+      uint64_t drops ( );
+
+      //! Records written over unread data of stalled lossless consumers
+      uint64_t overruns ( );
+
+      //! Consumer is attached and the writer has not closed or exited
+      bool alive ( );
+};
+
+#endif
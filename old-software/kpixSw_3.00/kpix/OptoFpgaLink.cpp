@@ -24,130 +24,263 @@
 #include <string.h>
 #include <stdlib.h>
 #include <sys/ioctl.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <time.h>
+#include <stdint.h>
+#include <stddef.h>
 #include <termio.h>
 
 using namespace std;
 
-// Receive frame
-int OptoFpgaLink::rxFrame ( ushort *frame, uint size, uint *type, uint *err ) {
-   ulong         rcount;
-   uint          rstate;
-   ulong         toCount;
-   int           ret;
-   unsigned char qbuffer[size*3];
-   int           x;
+// Consumers delete frames through Data pointers, pool slots are only
+// returned if the Data destructor is virtual
+typedef char OptoFpgaDataCheck[__has_virtual_destructor(Data) ? 1 : -1];
 
-   toCount = 0;
-   rcount  = 0;
-   rstate  = 0;
-   *err    = 0;
-   while (1) {
+// Frame constructor
+OptoFpgaData::OptoFpgaData ( uint *buffer, uint size ) : Data() {
+   baseData_ = data_;
+   baseSize_ = size_;
+   data_     = buffer;
+   size_     = size;
+}
 
-      // Receive data
-      ret = read(fd_,qbuffer,size*3);
+// Frame deconstructor, base class frees its own buffer
+OptoFpgaData::~OptoFpgaData ( ) {
+   data_ = baseData_;
+   size_ = baseSize_;
+}
 
-      // No data, not in frame
-      if ( ret <= 0 && rcount == 0 ) return(0);
+// Construct in pool slot
+void *OptoFpgaData::operator new ( size_t size, void *mem ) {
+   return(mem);
+}
 
-      // Got data
-      if ( ret > 0 ) {
+// Return slot to pool
+void OptoFpgaData::operator delete ( void *mem ) {
+   OptoFpgaSlot *slot;
 
-         // Process each byte
-         for (x=0; x < ret; x++) {
- 
-            // Three byte packets
-            switch(rstate) {
+   if ( mem == NULL ) return;
+   slot = (OptoFpgaSlot *)((char *)mem - offsetof(OptoFpgaSlot,mem));
+   slot->pool->give(slot);
+}
 
-               // Byte 0
-               case 0:
+// Return slot to pool if constructor throws
+void OptoFpgaData::operator delete ( void *mem, void *slot ) {
+   OptoFpgaData::operator delete(mem);
+}
 
-                  // Misalignment, allow to re-align if no data has been received
-                  if ( (qbuffer[x] & 0x80) == 0 ) {
-                     if ( rcount != 0 ) {
-                        *err = 1;
-                        return(0);
-                     }
-                     // else process next byte
-                  }
+// Pool constructor
+OptoFpgaPool::OptoFpgaPool ( uint count, uint size ) {
+   uint x;
 
-                  // SOF should match
-                  else if ( rcount == 0 && (qbuffer[x] & 0x40 ) == 0 ) return(0);
-                  else if ( rcount != 0 && (qbuffer[x] & 0x40 ) != 0 ) {
-                     *err = 1;
-                     return(0);
-                  }
+   count_     = count;
+   freeCount_ = count;
+   closed_    = false;
+   free_      = NULL;
 
-                  // First charactor
-                  else {
-                     frame[rcount] = (qbuffer[x] & 0x000F);    
-                     rstate = 1;
-                     if ( rcount == 0 ) *type = ((qbuffer[x] >> 4) & 0x3);
-                  }
-                  break;
+   slot_ = (OptoFpgaSlot *) calloc(count_,sizeof(OptoFpgaSlot));
+   if ( slot_ == NULL ) throw(string("OptoFpgaPool::OptoFpgaPool -> Malloc Error"));
 
-               // Byte 1
-               case 1:
+   for (x=0; x < count_; x++) {
+      slot_[x].pool   = this;
+      slot_[x].buffer = (uint *) malloc(sizeof(uint)*size);
+      if ( slot_[x].buffer == NULL ) throw(string("OptoFpgaPool::OptoFpgaPool -> Malloc Error"));
+      slot_[x].next = free_;
+      free_ = &(slot_[x]);
+   }
+   pthread_mutex_init(&mutex_,NULL);
+}
 
-                  // Misalignment
-                  if ( (qbuffer[x] & 0xC0) != 0 ) {
-                     *err = 1;
-                     return(0);
-                  }
+// Pool deconstructor
+OptoFpgaPool::~OptoFpgaPool ( ) {
+   uint x;
 
-                  // second charactor
-                  else {
-                     frame[rcount] |= ((qbuffer[x] << 4) & 0x03F0);
-                     rstate = 2;
-                  }
-                  break;
+   for (x=0; x < count_; x++) free(slot_[x].buffer);
+   free(slot_);
+   pthread_mutex_destroy(&mutex_);
+}
 
-               // Byte 3
-               case 2:
+// Take free slot
+OptoFpgaSlot *OptoFpgaPool::take ( ) {
+   OptoFpgaSlot *slot;
 
-                  // Misalignment
-                  if ( (qbuffer[x] & 0xC0) != 0x40 ) {
-                     *err = 1;
-                     return(0);
-                  }
+   pthread_mutex_lock(&mutex_);
+   if ( (slot = free_) != NULL ) {
+      free_ = slot->next;
+      freeCount_--;
+   }
+   pthread_mutex_unlock(&mutex_);
+   return(slot);
+}
 
-                  // third charactor
-                  else {
-                     frame[rcount] |= ((qbuffer[x] << 10) & 0xFC00);
-                     rcount++;
-                     rstate = 0;
-
-                     // KPIX registed or FPGA register done after 4 words
-                     if ( (*type == 0) || (*type == 2) ) {
-                        if ( rcount == 4 ) return(4);
-                     }
-
-                     // Data is done when last marker is set data frame consists of 2 header words
-                     // followed by groups of 3 words. If the last word of the 3 has bit 15 set
-                     // then the frame is done
-                     else {
-                        if ( (rcount > 2) && (((rcount - 3) % 3) == 2) && ((frame[rcount-3] & 0x8000) != 0) )
-                           return(rcount);
-                     }
-                  }
-                  break;
+// Return slot
+void OptoFpgaPool::give ( OptoFpgaSlot *slot ) {
+   bool done;
 
-               default:
-                  rstate = 0;
-                  break;
-            }
+   pthread_mutex_lock(&mutex_);
+   slot->next = free_;
+   free_      = slot;
+   freeCount_++;
+   done = ( closed_ && freeCount_ == count_ );
+   pthread_mutex_unlock(&mutex_);
+
+   if ( done ) delete this;
+}
+
+// Create frame in slot
+OptoFpgaData *OptoFpgaPool::frame ( OptoFpgaSlot *slot, uint size ) {
+   return(new ((void *)slot->mem) OptoFpgaData(slot->buffer,size));
+}
+
+// Release pool
+void OptoFpgaPool::close ( ) {
+   bool done;
+
+   pthread_mutex_lock(&mutex_);
+   closed_ = true;
+   done    = ( freeCount_ == count_ );
+   pthread_mutex_unlock(&mutex_);
+
+   if ( done ) delete this;
+}
+
+// Number of free slots
+uint OptoFpgaPool::freeCount ( ) {
+   return(freeCount_);
+}
+
+// Monotonic time in microseconds
+static uint64_t linkTime ( ) {
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC,&now);
+   return((uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000);
+}
+
+// Receive frame
+int OptoFpgaLink::rxFrame ( ushort *frame, uint size, uint *type, uint *err ) {
+   unsigned char *b;
+   ushort        *f;
+   uint          w0;
+   uint          w1;
+   uint          w2;
+   uint          head;
+   uint          tail;
+   uint          count;
+   uint          last;
+   uint          end;
+   uint          bad;
+   uint          n;
+   uint          x;
+   int           ret;
+
+   *err = 0;
+   while (1) {
+      head  = rxHead_;
+      tail  = rxTail_;
+      count = rxCount_;
+
+      // Each word is three bytes:
+      //    byte 0 : 1 SOF type[1:0] data[3:0]
+      //    byte 1 : 0 0   data[9:4]
+      //    byte 2 : 0 1   data[15:10]
+
+      // Not in frame, skip to start of frame
+      while ( count == 0 && (tail - head) >= 3 ) {
+         b = &(rxRaw_[head]);
+         if ( (b[0] & 0xC0) == 0xC0 && (b[1] & 0xC0) == 0x00 && (b[2] & 0xC0) == 0x40 ) {
+            rxType_  = (b[0] >> 4) & 0x3;
+            frame[0] = (b[0] & 0x000F) | ((b[1] << 4) & 0x03F0) | ((b[2] << 10) & 0xFC00);
+            count    = 1;
+            head    += 3;
          }
+         else head++;
       }
-      else {
-         toCount++;
-         if ( toCount >= 1000 ) {
-            *err = 1;
+
+      // Decode buffered words in blocks, register frames stop after 4 words
+      while ( count > 0 && (tail - head) >= 3 ) {
+         n = (tail - head) / 3;
+         if ( n > OPTO_FPGA_LINK_RX_BLOCK ) n = OPTO_FPGA_LINK_RX_BLOCK;
+         if ( ((rxType_ == 0) || (rxType_ == 2)) && n > (4 - count) ) n = 4 - count;
+         if ( n > (size - count) ) n = size - count;
+
+         // Four words are loaded as three 32-bit little endian values, framing
+         // bits of the block are collected in bad and checked once
+         bad = 0;
+         b   = &(rxRaw_[head]);
+         f   = &(frame[count]);
+         for (x=0; (x+4) <= n; x += 4) {
+            memcpy(&w0,b,4);
+            memcpy(&w1,b+4,4);
+            memcpy(&w2,b+8,4);
+            bad |= ((w0 & 0xC0C0C0C0) ^ 0x80400080) | ((w1 & 0xC0C0C0C0) ^ 0x00804000) | ((w2 & 0xC0C0C0C0) ^ 0x40008040);
+            f[x]   = ( w0        & 0x000F) | ((w0 >>  4) & 0x03F0) | ((w0 >>  6) & 0xFC00);
+            f[x+1] = ((w0 >> 24) & 0x000F) | ((w1 <<  4) & 0x03F0) | ((w1 <<  2) & 0xFC00);
+            f[x+2] = ((w1 >> 16) & 0x000F) | ((w1 >> 20) & 0x03F0) | ((w2 << 10) & 0xFC00);
+            f[x+3] = ((w2 >>  8) & 0x000F) | ((w2 >> 12) & 0x03F0) | ((w2 >> 14) & 0xFC00);
+            b += 12;
+         }
+         for ( ; x < n; x++) {
+            bad |= ((b[0] & 0xC0) ^ 0x80) | (b[1] & 0xC0) | ((b[2] & 0xC0) ^ 0x40);
+            f[x] = (b[0] & 0x000F) | ((b[1] << 4) & 0x03F0) | ((b[2] << 10) & 0xFC00);
+            b += 3;
+         }
+
+         // Misalignment or early start of frame, keep words before it
+         if ( bad != 0 ) {
+            for (x=0; x < n; x++) {
+               b = &(rxRaw_[head + x*3]);
+               if ( (((b[0] & 0xC0) ^ 0x80) | (b[1] & 0xC0) | ((b[2] & 0xC0) ^ 0x40)) != 0 ) break;
+            }
+            n = x;
+         }
+         last = count + n;
+         end  = 0;
+
+         // KPIX registed or FPGA register done after 4 words
+         if ( (rxType_ == 0) || (rxType_ == 2) ) {
+            if ( last == 4 ) end = 4;
+         }
+
+         // Data is done when last marker is set data frame consists of 2 header words
+         // followed by groups of 3 words. If the last word of the 3 has bit 15 set
+         // then the frame is done
+         else {
+            x = (count < 5) ? 5 : (count + 3 - ((count - 5) % 3));
+            for ( ; x <= last && end == 0; x += 3 ) if ( (frame[x-3] & 0x8000) != 0 ) end = x;
+         }
+
+         // Frame done, following bytes stay buffered for the next frame
+         if ( end != 0 ) {
+            rxHead_  = head + (end - count) * 3;
+            rxCount_ = 0;
+            *type    = rxType_;
+            return(end);
+         }
+
+         // Drop frame on error or overflow, resync at the failing word
+         head += n * 3;
+         if ( bad != 0 || last >= size ) {
+            rxHead_  = head;
+            rxCount_ = 0;
+            *err     = 1;
             return(0);
          }
-         usleep(10);
+         count = last;
       }
+      rxCount_ = count;
+
+      // Move partial word to start of buffer
+      rxTail_ = tail - head;
+      rxHead_ = 0;
+      if ( rxTail_ > 0 ) memmove(rxRaw_,&(rxRaw_[head]),rxTail_);
+
+      // Fill buffer, frame in progress is kept until more data arrives
+      ret = read(fd_,&(rxRaw_[rxTail_]),OPTO_FPGA_LINK_RX_SIZE - rxTail_);
+      if ( ret <= 0 ) return(0);
+      rxTail_ += ret;
    }
-   *err = 0;
-   return(0);
 }
 
 // transmit frame
@@ -183,6 +316,57 @@ int OptoFpgaLink::txFrame ( ushort *frame, uint size, uint type ) {
    return(size);
 }
 
+// Send register transaction
+void OptoFpgaLink::regSend ( OptoFpgaRequest *req ) {
+   ushort txBuff[4];
+
+   // Extract lane
+   req->type = (req->reg->address()>>24) & 0xF;
+
+   // Setup tx buffer for kpix write
+   if ( req->type == 0 ) {
+      txBuff[0]  = (req->reg->address() & 0x007F);
+      if ( req->write ) txBuff[0] |= 0x0080; // Write
+      txBuff[0] |= 0x0100; // Reg Access
+      txBuff[0] |= (req->reg->address() << 1) & 0x0600; // Assign lower 2-bits of kpixAddress
+      txBuff[0] |= (req->reg->address() << 2) & 0xF000; // Assign upper 4-bits of kpixAddress
+      if ( req->reg->address() & 0x8000 ) txBuff[0] |= 0x0800; // Bcast, see KPIX_BCAST_ADDR
+   }
+
+   // Setup tx buffer for fpga write
+   else {
+      txBuff[0]  = (req->reg->address() & 0x00FF);
+      if ( req->write ) txBuff[0] |= 0x0100; // Write
+   }
+   req->header = txBuff[0];
+
+   // Write has data
+   if ( req->write ) {
+      txBuff[1] = req->reg->get(0,0xFFFF);
+      txBuff[2] = req->reg->get(16,0xFFFF);
+   }
+
+   // Read is always small
+   else {
+      txBuff[1] = 0;
+      txBuff[2] = 0;
+   }
+
+   // Checksum 
+   txBuff[3] = ((txBuff[0] + txBuff[1] + txBuff[2]) & 0xFFFF);
+
+   // Send data
+   txFrame ( txBuff, 4, req->type);
+}
+
+// Complete register transaction, requester handles timeout
+void OptoFpgaLink::regDone ( OptoFpgaRequest *req, uint status ) {
+   if ( status == 0 ) {
+      if ( ! req->write ) req->reg->setStatus(0);
+      regRespCnt_++;
+   }
+}
+
 // IO Thread
 void OptoFpgaLink::ioHandler() {
    ushort    cmdBuff[4];
@@ -196,39 +380,71 @@ void OptoFpgaLink::ioHandler() {
    uint      lastReqCnt;
    uint      lastCmdCnt;
    uint      lastRunCnt;
-   uint      txType;
    uint      cmdType;
    uint      runType;
-   bool      txPend;
+   uint      flightCount;
+   uint      doneRet;
+   uint      match;
+   uint      x;
    Data      *rxData;
    uint      maskRx;
    uint      mask;
    uint      dataSize;
    ushort    *lrxBuff;
-   ushort    *ltxBuff;
    uint      *rxBuff;
-   uint      *txBuff;
+   bool      writePend;
+   uint64_t  writeEnd;
+   uint64_t  now;
+   uint      idleWait;
+   uint      wait;
+   ushort    *frame;
+   OptoFpgaRequest flight[OPTO_FPGA_LINK_REQ_COUNT];
+   OptoFpgaRequest writeReq;
+   OptoFpgaRequest req;
+   OptoFpgaPool    *pool;
+   OptoFpgaSlot    *slot;
+   uint64_t  wakeVal;
+   struct pollfd   fds[2];
+   struct timespec timeout;
 
    // Init buffer
    rxBuff = (uint *) malloc(sizeof(uint)*maxRxTx_);
-   txBuff = (uint *) malloc(sizeof(uint)*maxRxTx_);
 
-   // Point to buffers as ushorts
+   // Point to buffer as ushorts
    lrxBuff = (ushort *)rxBuff;
-   ltxBuff = (ushort *)txBuff;
+
+   // Data frames are received into pool buffers, pool outlives this thread
+   // while frames are queued
+   pool = new OptoFpgaPool(OPTO_FPGA_LINK_POOL_COUNT,maxRxTx_);
+   slot = NULL;
 
    // While enabled
    lastReqCnt = regReqCnt_;
    lastCmdCnt = cmdReqCnt_;
    lastRunCnt = runReqCnt_;
-   txPend     = false;
+   flightCount = 0;
+   writePend  = false;
+   writeEnd   = 0;
+   idleWait   = OPTO_FPGA_LINK_BUSY_WAIT;
+
+   // Wait on device data and wake up event
+   fds[0].fd     = fd_;
+   fds[0].events = POLLIN;
+   fds[1].fd     = wakeFd_;
+   fds[1].events = POLLIN;
+
    while ( runEnable_ ) {
 
+      // Receive into a pool buffer if one is free, otherwise into local
+      // buffer. A frame in progress stays in the buffer it started in.
+      if ( slot == NULL && rxCount_ == 0 ) slot = pool->take();
+      frame = ( slot == NULL ) ? lrxBuff : (ushort *)slot->buffer;
+
       // Setup and attempt receive
-      rxRet = rxFrame(lrxBuff, maxRxTx_, &type, &err);
+      rxRet = rxFrame(frame, maxRxTx_, &type, &err);
 
       // Data is ready and large enough to be a real packet
-      if ( rxRet > 0 ) {
+      if ( rxRet > 0 || err ) {
 
          // An error occured
          if ( rxRet < 4 || err ) {
@@ -248,82 +464,121 @@ void OptoFpgaLink::ioHandler() {
             if ( (maskRx & dataSource_) != 0 ) {
                if ( (rxRet % 2) != 0 ) dataSize = (rxRet + 1) / 2;
                else dataSize = rxRet / 2;
-               rxData = new Data(rxBuff,dataSize);
-               if ( ! dataQueue_.push(rxData) ) {
-                  unexpCount_++;
-                  delete rxData;
+
+               // All pool buffers are queued
+               if ( slot == NULL ) {
+                  poolDropCount_++;
+                  if ( debug_ ) 
+                     cout << "OptoFpgaLink::ioHandler -> No receive buffer, data frame dropped" << endl;
+               }
+
+               // Frame owns slot until the consumer deletes it
+               else {
+                  rxData = pool->frame(slot,dataSize);
+                  slot   = NULL;
+                  if ( ! dataQueue_.push(rxData) ) {
+                     unexpCount_++;
+                     delete rxData;
+                  }
                }
             }
 
-            // Data matches outstanding register request
-            else if ( (rxRet == 4) && txPend && (type == ((regReqEntry_->address()>>24) & 0xF))) {
-               if ( ! regReqWrite_ ) {
-                  regReqEntry_->set(lrxBuff[1],0,0xFFFF);
-                  regReqEntry_->set(lrxBuff[2],16,0xFFFF);
+            // Register reply answers the oldest read on its lane, replies come
+            // back in request order. A reply to a read which was given up is
+            // dropped so it can not complete a newer read with stale data.
+            else if ( (rxRet == 4) && flightCount > 0 ) {
+               match = flightCount;
+               for (x=0; x < flightCount && match == flightCount; x++) 
+                  if ( flight[x].type == type ) match = x;
+
+               if ( match < flightCount ) {
+
+                  // Requester gave up if a newer request is waiting
+                  if ( lastReqCnt != regReqCnt_ ) flight[match].live = false;
+
+                  if ( flight[match].live ) {
+                     flight[match].reg->set(frame[1],0,0xFFFF);
+                     flight[match].reg->set(frame[2],16,0xFFFF);
+                     regDone(&(flight[match]),0);
+                  }
+                  else {
+                     unexpCount_++;
+                     if ( debug_ ) 
+                        cout << "OptoFpgaLink::ioHandler -> Late register reply dropped. Header=0x" << hex << flight[match].header << endl;
+                  }
+                  for (x=match+1; x < flightCount; x++) flight[x-1] = flight[x];
+                  flightCount--;
+               }
+               else {
+                  unexpCount_++;
+                  if ( debug_ ) 
+                     cout << "OptoFpgaLink::ioHandler -> Unuexpected frame received" << " Pend=" <<  flightCount << endl;
                }
-               regReqEntry_->setStatus(0);
-               txPend = false;
-               regRespCnt_++;
             }
 
             // Unexpected frame
             else {
                unexpCount_++;
                if ( debug_ ) 
-                  cout << "OptoFpgaLink::ioHandler -> Unuexpected frame received" << " Pend=" <<  txPend << endl;
+                  cout << "OptoFpgaLink::ioHandler -> Unuexpected frame received" << " Pend=" <<  flightCount << endl;
             }
          }
       }
   
-      // Register TX is pending
-      if ( lastReqCnt != regReqCnt_ ) {
+      // Register write has settled, write has no response
+      doneRet = 0;
+      if ( writePend && linkTime() >= writeEnd ) {
+         writePend = false;
+         regDone(&writeReq,0);
+         doneRet++;
+      }
 
-         // Extract lane
-         txType = (regReqEntry_->address()>>24) & 0xF;
-
-         // Setup tx buffer for kpix write
-         if ( txType == 0 ) {
-            ltxBuff[0]  = (regReqEntry_->address() & 0x007F);
-            if ( regReqWrite_ ) ltxBuff[0] |= 0x0080; // Write
-            ltxBuff[0] |= 0x0100; // Reg Access
-            ltxBuff[0] |= (regReqEntry_->address() << 1) & 0x0600; // Assign lower 2-bits of kpixAddress
-            ltxBuff[0] |= (regReqEntry_->address() << 2) & 0xF000; // Assign upper 4-bits of kpixAddress
+      // Drop reads which were not answered
+      if ( flightCount > 0 ) {
+         now = linkTime();
+         for (x=0; x < flightCount; ) {
+            if ( now >= flight[x].end ) {
+               if ( debug_ && flight[x].live ) 
+                  cout << "OptoFpgaLink::ioHandler -> Register read timeout. Header=0x" << hex << flight[x].header << endl;
+               regDone(&(flight[x]),1);
+               for (match=x+1; match < flightCount; match++) flight[match-1] = flight[match];
+               flightCount--;
+               doneRet++;
+            }
+            else x++;
          }
+      }
 
-         // Setup tx buffer for fpga write
-         else {
-            ltxBuff[0]  = (regReqEntry_->address() & 0x00FF);
-            if ( regReqWrite_ ) ltxBuff[0] |= 0x0100; // Write
-         }
+      // Send register request from CommLink, writes wait for the previous
+      // write to settle. A new request means the requester of an unanswered
+      // read gave up, the read stays until its reply or timeout. The oldest
+      // given up read makes room when the table is full.
+      txRet = 0;
+      if ( ! writePend && lastReqCnt != regReqCnt_ ) {
+         req.reg    = regReqEntry_;
+         req.write  = regReqWrite_;
+         req.live   = true;
+         lastReqCnt = regReqCnt_;
 
-         // Write has data
-         if ( regReqWrite_ ) {
-            ltxBuff[1] = regReqEntry_->get(0,0xFFFF);
-            ltxBuff[2] = regReqEntry_->get(16,0xFFFF);
-            txPend = false;
+         for (x=0; x < flightCount; x++) flight[x].live = false;
+         if ( flightCount == OPTO_FPGA_LINK_REQ_COUNT ) {
+            for (x=1; x < flightCount; x++) flight[x-1] = flight[x];
+            flightCount--;
          }
 
-         // Read is always small
-         else {
-            ltxBuff[1] = 0;
-            ltxBuff[2] = 0;
-            txPend     = true;
+         // Send data, write completes once settled
+         regSend(&req);
+         txRet++;
+         if ( req.write ) {
+            writePend = true;
+            writeEnd  = linkTime() + OPTO_FPGA_LINK_WRITE_WAIT;
+            writeReq  = req;
          }
-
-         // Checksum 
-         ltxBuff[3] = ((ltxBuff[0] + ltxBuff[1] + ltxBuff[2]) & 0xFFFF);
-
-         // Send data, write has no response
-         txRet = txFrame ( ltxBuff, 4, txType);
-         if ( regReqWrite_ ) {
-            usleep(1000);
-            regRespCnt_++;
+         else {
+            req.end = linkTime() + OPTO_FPGA_LINK_REQ_TIMEOUT;
+            flight[flightCount++] = req;
          }
-
-         // Match request count
-         lastReqCnt = regReqCnt_;
       }
-      else txRet = 0;
 
       // Command TX is pending
       if ( lastCmdCnt != cmdReqCnt_ ) {
@@ -368,23 +623,65 @@ void OptoFpgaLink::ioHandler() {
       }
       else runRet = 0;
 
-      // Pause if nothing was done
-      if ( rxRet <= 0 && txRet <= 0 && cmdRet <= 0 && runRet <= 0 ) usleep(1);
+      // Something was done or completed, check again at once
+      if ( rxRet > 0 || err || txRet > 0 || cmdRet > 0 || runRet > 0 || doneRet > 0 ) 
+         idleWait = OPTO_FPGA_LINK_BUSY_WAIT;
+
+      // Sleep until data, a wake up, the end of a register write or the
+      // idle timeout. Timeout grows only while no request is outstanding.
+      else {
+         wait = idleWait;
+         if ( writePend ) {
+            now = linkTime();
+            if ( writeEnd <= now ) wait = 0;
+            else if ( (writeEnd - now) < wait ) wait = writeEnd - now;
+         }
+         timeout.tv_sec  = wait / 1000000;
+         timeout.tv_nsec = (wait % 1000000) * 1000;
+
+         // Requester may wake the thread just before queueing, keep
+         // the next wait short
+         if ( ppoll(fds,2,&timeout,NULL) > 0 && (fds[1].revents & POLLIN) ) {
+            read(wakeFd_,&wakeVal,sizeof(wakeVal));
+            idleWait = OPTO_FPGA_LINK_BUSY_WAIT;
+         }
+         else if ( ! writePend && flightCount == 0 ) {
+            idleWait *= 2;
+            if ( idleWait > OPTO_FPGA_LINK_IDLE_WAIT ) idleWait = OPTO_FPGA_LINK_IDLE_WAIT;
+         }
+      }
    }
 
+   // Fail transactions which did not complete
+   if ( writePend ) regDone(&writeReq,0);
+   for (x=0; x < flightCount; x++) regDone(&(flight[x]),1);
+
+   // Return unused slot, pool is freed once queued frames are deleted
+   if ( slot != NULL ) pool->give(slot);
+   pool->close();
+
    free(rxBuff);
-   free(txBuff);
 }
 
 // Constructor
 OptoFpgaLink::OptoFpgaLink ( ) : CommLink() {
-   device_    = "";
-   fd_        = -1;
+   device_        = "";
+   fd_            = -1;
+   rxHead_        = 0;
+   rxTail_        = 0;
+   rxCount_       = 0;
+   rxType_        = 0;
+   poolDropCount_ = 0;
+   wakeFd_        = -1;
+
+   rxRaw_ = (unsigned char *) malloc(OPTO_FPGA_LINK_RX_SIZE);
+   if ( rxRaw_ == NULL ) throw(string("OptoFpgaLink::OptoFpgaLink -> Malloc Error"));
 }
 
 // Deconstructor
 OptoFpgaLink::~OptoFpgaLink ( ) {
    close();
+   free(rxRaw_);
 }
 
 // Open link and start threads
@@ -413,6 +710,19 @@ void OptoFpgaLink::open ( string device ) {
 
    if ( debug_ ) cout << "OptoFpgaLink::open -> Opened VCP USB device " << device << endl;
 
+   // Wake up event for IO thread
+   if ( (wakeFd_ = eventfd(0,EFD_NONBLOCK)) < 0 ) {
+      ::close(fd_);
+      fd_ = -1;
+      throw(string("OptoFpgaLink::open -> Error creating wake up event"));
+   }
+
+   // Start with empty receive buffer
+   rxHead_        = 0;
+   rxTail_        = 0;
+   rxCount_       = 0;
+   poolDropCount_ = 0;
+
    // Set device variable
    device_ = device;
    CommLink::open();
@@ -426,7 +736,45 @@ void OptoFpgaLink::close () {
       CommLink::close();
       usleep(100);
       ::close(fd_);
-      fd_ = -1;
+      ::close(wakeFd_);
+      fd_     = -1;
+      wakeFd_ = -1;
+
+      if ( poolDropCount_ > 0 ) 
+         cout << "OptoFpgaLink::close -> Dropped " << dec << poolDropCount_
+              << " data frames with no free receive buffer" << endl;
    }
 }
 
+// Wake IO thread
+void OptoFpgaLink::wake () {
+   uint64_t val;
+
+   val = 1;
+   if ( wakeFd_ >= 0 ) write(wakeFd_,&val,sizeof(val));
+}
+
+// Queue register request, requester blocks until the response so the
+// thread is woken first and looks again after a short wait
+void OptoFpgaLink::queueRegister ( uint destination, Register *reg, bool write, bool wait ) {
+   wake();
+   CommLink::queueRegister(destination,reg,write,wait);
+}
+
+// Queue command request, wake first as for registers
+void OptoFpgaLink::queueCommand ( uint destination, Command *cmd ) {
+   wake();
+   CommLink::queueCommand(destination,cmd);
+}
+
+// Queue run command request, wake once it is queued
+void OptoFpgaLink::queueRunCommand ( ) {
+   CommLink::queueRunCommand();
+   wake();
+}
+
+// Number of data frames dropped with no free receive buffer
+uint OptoFpgaLink::poolDropCount () {
+   return(poolDropCount_);
+}
+
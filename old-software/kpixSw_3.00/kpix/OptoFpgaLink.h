@@ -22,9 +22,132 @@
 #include <map>
 #include <pthread.h>
 #include <unistd.h>
+#include <stdint.h>
 #include <CommLink.h>
+#include <Data.h>
 using namespace std;
 
+// Receive buffer size in bytes
+#define OPTO_FPGA_LINK_RX_SIZE 65536
+
+// Words decoded between end of frame checks
+#define OPTO_FPGA_LINK_RX_BLOCK 48
+
+// First and longest idle wait in microseconds. Requests queued through
+// this link wake the IO thread, the longest wait bounds the latency of
+// requests queued through a CommLink pointer.
+#define OPTO_FPGA_LINK_BUSY_WAIT 10
+#define OPTO_FPGA_LINK_IDLE_WAIT 50
+
+// Settle time after a register write in microseconds
+#define OPTO_FPGA_LINK_WRITE_WAIT 1000
+
+// Number of receive buffers in frame pool
+#define OPTO_FPGA_LINK_POOL_COUNT 16
+
+// Register reads tracked until answered or timed out. CommLink holds a single
+// request and its requester blocks until the reply, so only the newest read
+// has a requester. Older reads were given up and only absorb late replies.
+#define OPTO_FPGA_LINK_REQ_COUNT 8
+
+// Register read reply timeout in microseconds
+#define OPTO_FPGA_LINK_REQ_TIMEOUT 100000
+
+//! Register transaction in flight
+class OptoFpgaRequest {
+   public:
+      Register *reg;
+      bool     write;
+      bool     live;
+      uint     type;
+      ushort   header;
+      uint64_t end;
+};
+
+class OptoFpgaPool;
+
+//! Received data frame held in a receive buffer from an OptoFpgaPool.
+/*!
+ * Frames are created in place in a pool slot. Deleting a frame, through an
+ * OptoFpgaData or Data pointer, returns the slot and its buffer to the pool.
+ */
+class OptoFpgaData : public Data {
+
+      // Buffer and size owned by base class
+      uint *baseData_;
+      uint baseSize_;
+
+   public:
+
+      //! Constructor, frame uses buffer without copying
+      OptoFpgaData ( uint *buffer, uint size );
+
+      //! Deconstructor
+      ~OptoFpgaData ( );
+
+      //! Construct in pool slot
+      static void *operator new ( size_t size, void *mem );
+
+      //! Return slot to pool
+      static void operator delete ( void *mem );
+
+      //! Return slot to pool if constructor throws
+      static void operator delete ( void *mem, void *slot );
+};
+
+//! Pool slot, frame object is constructed in mem
+class OptoFpgaSlot {
+   public:
+      OptoFpgaPool *pool;
+      OptoFpgaSlot *next;
+      uint         *buffer;
+      union {
+         char     mem[sizeof(OptoFpgaData)];
+         uint64_t align;
+      };
+};
+
+//! Fixed set of receive buffers cycled between the link thread and consumers.
+/*!
+ * The link thread takes a free slot, decodes a frame into its buffer and
+ * passes the frame to the data queue. The consumer deleting the frame
+ * returns the slot. The pool is closed by the link and frees itself once
+ * every queued frame has been deleted.
+ */
+class OptoFpgaPool {
+
+      // Slots and free list
+      OptoFpgaSlot    *slot_;
+      OptoFpgaSlot    *free_;
+      uint            count_;
+      uint            freeCount_;
+      bool            closed_;
+      pthread_mutex_t mutex_;
+
+      // Deconstructor, through close()
+      ~OptoFpgaPool ( );
+
+   public:
+
+      //! Constructor, size is buffer size in 32-bit words
+      OptoFpgaPool ( uint count, uint size );
+
+      //! Take free slot, returns NULL if all are in use
+      OptoFpgaSlot *take ( );
+
+      //! Return slot
+      void give ( OptoFpgaSlot *slot );
+
+      //! Create frame of size words in slot
+      OptoFpgaData *frame ( OptoFpgaSlot *slot, uint size );
+
+      //! Release pool, deleted when all slots are returned
+      void close ( );
+
+      //! Number of free slots
+      uint freeCount ( );
+};
+
 //! Class to contain PGP communications link
 class OptoFpgaLink : public CommLink {
 
@@ -34,12 +157,38 @@ class OptoFpgaLink : public CommLink {
       string device_;
       int    fd_;
 
-      // Receive frame
+      // Receive buffer, bytes from rxHead_ to rxTail_ are not yet decoded
+      unsigned char *rxRaw_;
+      uint          rxHead_;
+      uint          rxTail_;
+
+      // Frame in progress
+      uint rxCount_;
+      uint rxType_;
+
+      // Data frames dropped because every pool buffer was queued
+      uint poolDropCount_;
+
+      // Event used to wake the IO thread
+      int wakeFd_;
+
+      // Wake IO thread
+      void wake ();
+
+      // Receive frame, returns frame size in words once a frame is complete.
+      // A partial frame is kept in frame between calls, the caller passes the
+      // same buffer until a frame is returned or err is set.
       int rxFrame ( ushort *frame, uint size, uint *type, uint *err );
 
       // transmit frame
       int txFrame ( ushort *frame, uint size, uint type );
 
+      // Send register transaction, sets type and header of req
+      void regSend ( OptoFpgaRequest *req );
+
+      // Complete register transaction, status is 0 on success
+      void regDone ( OptoFpgaRequest *req, uint status );
+
    public:
 
       //! Constructor
@@ -61,5 +210,27 @@ class OptoFpgaLink : public CommLink {
       //! Stop threads and close link
       void close ();
 
+      //! Number of data frames dropped because every receive buffer was queued
+      uint poolDropCount ();
+
+      //! Queue register request and wake IO thread
+      /*! 
+       * \param destination Destination value
+       * \param reg         Register
+       * \param write       Set true for write
+       * \param wait        Wait for response
+      */
+      void queueRegister ( uint destination, Register *reg, bool write, bool wait );
+
+      //! Queue command request and wake IO thread
+      /*! 
+       * \param destination Destination value
+       * \param cmd         Command
+      */
+      void queueCommand ( uint destination, Command *cmd );
+
+      //! Queue run command request and wake IO thread
+      void queueRunCommand ( );
+
 };
 #endif
@@ -16,6 +16,7 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <string.h>
 #include <QObject>
 #include <QLabel>
 #include <QVBoxLayout>
@@ -113,6 +114,14 @@ CalibWindow::CalibWindow ( QWidget *parent ) : QWidget (parent) {
       }
       plot_[x]->setAutoReplot( true );
    }
+
+   // Nothing displayed
+   plotKpix_ = 32;
+   plotChan_ = 0;
+
+   memset(valid_,0,sizeof(valid_));
+   memset(gen_,0,sizeof(gen_));
+   epoch_ = 0;
    resetPlot();
 }
 
@@ -129,7 +138,7 @@ void CalibWindow::setCalibData(uint kpix, uint chan, uint bucket) {
    for (r=0; r < 2; r++) {
       count = 0;
       for (i=0; i < 256; i++) {
-         if ( valid_[kpix][chan][bucket][r][i] ) {
+         if ( valid_[kpix][chan][bucket][r][i] == epoch_ ) {
             plotX[bucket][r][count] = charge_[kpix][chan][bucket][r][i];
             plotY[bucket][r][count] = value_[kpix][chan][bucket][r][i];
             count++;
@@ -161,35 +170,37 @@ void CalibWindow::rxData (KpixEvent *event, uint calChan, uint calDac, bool calP
       if ( type == 0 && calChan == channel ) {
          charge_[kpix][calChan][bucket][range][calDac] = dacToCharge ( calDac, calPos, (calHigh && bucket==0));
          value_[kpix][calChan][bucket][range][calDac]  = value;
-         valid_[kpix][calChan][bucket][range][calDac]  = true;
+         valid_[kpix][calChan][bucket][range][calDac]  = epoch_;
+         gen_[kpix][calChan][bucket]++;
       }
    }
 }
 
 void CalibWindow::rePlot(uint kpix, uint chan) {
    uint x;
+   bool same;
 
+   same = (kpix == plotKpix_ && chan == plotChan_ && epoch_ == plotEpoch_);
+
+   // Only rebuild buckets updated since the last plot
    for (x=0; x<4; x++) {
+      if ( same && gen_[kpix][chan][x] == plotGen_[x] ) continue;
+      plotGen_[x] = gen_[kpix][chan][x];
+
       setCalibData(kpix,chan,x);
       plot_[x]->replot();
    }
+   plotKpix_  = kpix;
+   plotChan_  = chan;
+   plotEpoch_ = epoch_;
 }
 
 void CalibWindow::resetPlot() {
-   uint kpix;
-   uint chan;
-   uint buck;
-   uint x;
 
-   for (kpix=0; kpix < 32; kpix++) {
-      for (chan=0; chan < 1024; chan++) {
-         for (buck=0; buck < 4; buck++) {
-            for (x=0; x < 256; x++) {
-               valid_[kpix][chan][buck][0][x] = false;
-               valid_[kpix][chan][buck][1][x] = false;
-            }
-         }
-      }
+   // Stamps of zero are never valid, clear all when the epoch wraps
+   if ( ++epoch_ == 0 ) {
+      memset(valid_,0,sizeof(valid_));
+      epoch_ = 1;
    }
 }
 
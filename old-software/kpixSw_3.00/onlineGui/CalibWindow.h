@@ -36,7 +36,19 @@ class CalibWindow : public QWidget {
 
       double   charge_[32][1024][4][2][256];
       double   value_[32][1024][4][2][256];
-      bool     valid_[32][1024][4][2][256];
+
+      // Point is valid when its stamp matches the current epoch
+      unsigned char valid_[32][1024][4][2][256];
+      unsigned char epoch_;
+
+      // Update count per bucket
+      uint gen_[32][1024][4];
+
+      // Displayed channel, epoch and bucket generations
+      uint          plotKpix_;
+      uint          plotChan_;
+      unsigned char plotEpoch_;
+      uint          plotGen_[4];
 
       double plotX[4][2][256];
       double plotY[4][2][256];
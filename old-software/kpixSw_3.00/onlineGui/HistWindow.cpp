@@ -30,14 +30,21 @@
 using namespace std;
 
 // Constructor
-HistWindow::HistWindow ( QWidget *parent ) : QWidget (parent) {
+HistWindow::HistWindow ( QWidget *parent ) : QWidget (parent), data_(2), pool_(8) {
    QString tmp;
    uint x;
 
+   // Nothing displayed
+   plotKpix_ = 32;
+   plotChan_ = 0;
+
    QGridLayout *top = new QGridLayout;
    this->setLayout(top);
 
    for ( x=0; x < 4; x++ ) {
+      view_[x][0].setPool(&pool_);
+      view_[x][1].setPool(&pool_);
+
       plot_[x] = new QwtPlot;
       top->addWidget(plot_[x],x/2,x%2);
 
@@ -123,33 +130,38 @@ void HistWindow::rxData (KpixEvent *event) {
       range   = sample->getSampleRange();
       type    = sample->getSampleType();
 
-      if ( type == 0 ) data_[kpix][channel][bucket][range].fill(value);
+      if ( type == 0 ) data_.fill(kpix,channel,bucket,range,value);
    }
 }
 
 void HistWindow::rePlot(uint kpix, uint chan) {
    uint x;
+   uint gen;
+   uint epoch;
+   bool same;
+
+   epoch = data_.epoch();
+   same  = (kpix == plotKpix_ && chan == plotChan_ && epoch == plotEpoch_);
 
+   // Only rebuild buckets filled since the last plot
    for (x=0; x<4; x++) {
-      setHistData(x,0,&(data_[kpix][chan][x][0]));
-      setHistData(x,1,&(data_[kpix][chan][x][1]));
+      gen = data_.generation(kpix,chan,x);
+      if ( same && gen == plotGen_[x] ) continue;
+      plotGen_[x] = gen;
+
+      data_.snapshot(kpix,chan,x,0,&(view_[x][0]));
+      data_.snapshot(kpix,chan,x,1,&(view_[x][1]));
+      setHistData(x,0,&(view_[x][0]));
+      setHistData(x,1,&(view_[x][1]));
       plot_[x]->replot();
    }
+   plotKpix_  = kpix;
+   plotChan_  = chan;
+   plotEpoch_ = epoch;
 }
 
 void HistWindow::resetPlot() {
-   uint kpix;
-   uint chan;
-   uint buck;
-
-   for (kpix=0; kpix < 32; kpix++) {
-      for (chan=0; chan < 1024; chan++) {
-         for (buck=0; buck < 4; buck++) {
-            data_[kpix][chan][buck][0].init();
-            data_[kpix][chan][buck][1].init();
-         }
-      }
-   }
+   data_.reset();
 }
 
 void HistWindow::showItem( QwtPlotItem *item, bool on ) {
@@ -30,8 +30,12 @@
 using namespace std;
 
 // Constructor
-HitWindow::HitWindow ( QWidget *parent ) : QWidget (parent) {
+HitWindow::HitWindow ( QWidget *parent ) : QWidget (parent), pool_(32) {
    QString tmp;
+   uint kpix;
+
+   // One fixed range histogram per kpix
+   for (kpix=0; kpix < 32; kpix++) data_[kpix].setPool(&pool_);
 
    QGridLayout *top = new QGridLayout;
    this->setLayout(top);
@@ -37,7 +37,8 @@ class HitWindow : public QWidget {
 
       void setHistData(KpixHistogram *hits);
 
-      KpixHistogram data_[32];
+      KpixHistogramPool pool_;
+      KpixHistogram     data_[32];
 
    public:
 
@@ -0,0 +1,181 @@
+//-----------------------------------------------------------------------------
+// File          : KpixHistogramBank.cpp
+// Author        : agent  <agent@local>
+// Created       : 10/19/2026
+// Project       : KPIX Control Software
+//-----------------------------------------------------------------------------
+// Description :
+// Bank of count histograms which can be filled from several threads.
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 by SLAC. All rights reserved.
+// Proprietary and confidential to SLAC.
+//-----------------------------------------------------------------------------
+// Modification history :
+// 10/19/2026: created
+//-----------------------------------------------------------------------------
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include "KpixHistogramBank.h"
+using namespace std;
+
+// Epoch value held while an entry is cleared, epoch of a new entry
+#define KPIX_BANK_CLEARING 0xFFFFFFFF
+#define KPIX_BANK_NEW      0
+
+// Number of histograms per range
+#define KPIX_BANK_COUNT (32*1024*4)
+
+// Constructor
+KpixHistogramBank::KpixHistogramBank ( uint ranges ) {
+   ranges_    = ranges;
+   allocated_ = 0;
+   dropped_   = 0;
+   epoch_     = KPIX_BANK_NEW + 1;
+
+   chunk_      = (KpixBankEntry **) calloc((KPIX_BANK_COUNT*ranges_)/KPIX_BANK_CHUNK, sizeof(KpixBankEntry *));
+   generation_ = (uint *) calloc(KPIX_BANK_COUNT, sizeof(uint));
+   if ( chunk_ == NULL || generation_ == NULL )
+      throw(string("KpixHistogramBank::KpixHistogramBank -> Malloc Error"));
+}
+
+// DeConstructor
+KpixHistogramBank::~KpixHistogramBank ( ) {
+   uint x;
+
+   for (x=0; x < (KPIX_BANK_COUNT*ranges_)/KPIX_BANK_CHUNK; x++) free(chunk_[x]);
+   free(chunk_);
+   free(generation_);
+}
+
+// Get entry of a histogram
+KpixHistogramBank::KpixBankEntry *KpixHistogramBank::lookup ( uint idx, bool alloc ) {
+   KpixBankEntry **ptr;
+   KpixBankEntry *chunk;
+
+   ptr   = &(chunk_[idx/KPIX_BANK_CHUNK]);
+   chunk = *((KpixBankEntry * volatile *)ptr);
+
+   // Zeroed block is not touched here, entries read as new from an older epoch
+   if ( chunk == NULL && alloc ) {
+      if ( (chunk = (KpixBankEntry *) calloc(KPIX_BANK_CHUNK, sizeof(KpixBankEntry))) == NULL ) return(NULL);
+      if ( ! __sync_bool_compare_and_swap(ptr,(KpixBankEntry *)NULL,chunk) ) {
+         free(chunk);
+         chunk = *((KpixBankEntry * volatile *)ptr);
+      }
+   }
+   if ( chunk == NULL ) return(NULL);
+   __sync_synchronize();
+   return(&(chunk[idx%KPIX_BANK_CHUNK]));
+}
+
+// Clear histogram from an older epoch
+void KpixHistogramBank::clear ( KpixBankEntry *entry, uint epoch ) {
+   uint old;
+
+   // One thread clears, others wait for the new stamp
+   while ( (old = *((volatile uint *)&(entry->epoch))) != epoch ) {
+      if ( old != KPIX_BANK_CLEARING && __sync_bool_compare_and_swap(&(entry->epoch),old,KPIX_BANK_CLEARING) ) {
+         if ( old == KPIX_BANK_NEW ) __sync_fetch_and_add(&allocated_,1);
+         if ( entry->min <= entry->max ) memset(&(entry->bin[entry->min]),0,(entry->max-entry->min+1)*sizeof(uint));
+         entry->min = KPIX_HISTOGRAM_BINS;
+         entry->max = 0;
+         __sync_synchronize();
+         entry->epoch = epoch;
+         return;
+      }
+      sched_yield();
+   }
+}
+
+// Add an entry
+void KpixHistogramBank::fill ( uint kpix, uint channel, uint bucket, uint range, uint value ) {
+   KpixBankEntry *entry;
+   uint          old;
+   uint          epoch;
+
+   if ( kpix > 31 || channel > 1023 || bucket > 3 || range >= ranges_ ) return;
+
+   // Out of range or no memory for the chunk, a later fill tries again
+   if ( value >= KPIX_HISTOGRAM_BINS ||
+        (entry = lookup(((kpix*1024+channel)*4+bucket)*ranges_+range,true)) == NULL ) {
+      __sync_fetch_and_add(&dropped_,1);
+      return;
+   }
+   epoch = *((volatile uint *)&epoch_);
+   if ( *((volatile uint *)&(entry->epoch)) != epoch ) clear(entry,epoch);
+   __sync_fetch_and_add(&(entry->bin[value]),1);
+
+   // Widen range
+   while ( value < (old = *((volatile uint *)&(entry->min))) )
+      if ( __sync_bool_compare_and_swap(&(entry->min),old,value) ) break;
+   while ( value > (old = *((volatile uint *)&(entry->max))) )
+      if ( __sync_bool_compare_and_swap(&(entry->max),old,value) ) break;
+
+   __sync_fetch_and_add(&(generation_[(kpix*1024+channel)*4+bucket]),1);
+}
+
+// Copy histogram
+bool KpixHistogramBank::snapshot ( uint kpix, uint channel, uint bucket, uint range, KpixHistogram *hist ) {
+   KpixBankEntry *entry;
+   uint          bins[KPIX_HISTOGRAM_BINS];
+   uint          min;
+   uint          max;
+   uint          x;
+
+   hist->init();
+   if ( kpix > 31 || channel > 1023 || bucket > 3 || range >= ranges_ ) return(false);
+
+   entry = lookup(((kpix*1024+channel)*4+bucket)*ranges_+range,false);
+   if ( entry == NULL ) return(false);
+   if ( *((volatile uint *)&(entry->epoch)) != *((volatile uint *)&epoch_) ) return(false);
+
+   min = *((volatile uint *)&(entry->min));
+   max = *((volatile uint *)&(entry->max));
+   if ( min > max ) return(false);
+
+   // Copy and trim to copied contents
+   __sync_synchronize();
+   for (x=min; x <= max; x++) bins[x] = *((volatile uint *)&(entry->bin[x]));
+   while ( min <= max && bins[min] == 0 ) min++;
+   while ( max > min && bins[max] == 0 ) max--;
+   if ( min > max ) return(false);
+
+   hist->load(min,max-min+1,&(bins[min]));
+   return(true);
+}
+
+// Clear all histograms
+void KpixHistogramBank::reset ( ) {
+   uint epoch;
+
+   // Stamp of clearing and new entries is never current
+   epoch = epoch_ + 1;
+   if ( epoch == KPIX_BANK_CLEARING ) epoch = KPIX_BANK_NEW + 1;
+
+   __sync_synchronize();
+   epoch_   = epoch;
+   dropped_ = 0;
+}
+
+// Fill count for kpix, channel and bucket
+uint KpixHistogramBank::generation ( uint kpix, uint channel, uint bucket ) {
+   if ( kpix > 31 || channel > 1023 || bucket > 3 ) return(0);
+   return(*((volatile uint *)&(generation_[(kpix*1024+channel)*4+bucket])));
+}
+
+// Current epoch
+uint KpixHistogramBank::epoch ( ) {
+   return(*((volatile uint *)&epoch_));
+}
+
+// Histograms filled since the bank was created
+uint KpixHistogramBank::allocated ( ) {
+   return(allocated_);
+}
+
+// Number of values dropped
+uint KpixHistogramBank::dropped ( ) {
+   return(dropped_);
+}
@@ -0,0 +1,111 @@
+//-----------------------------------------------------------------------------
+// File          : KpixHistogramBank.h
+// Author        : agent  <agent@local>
+// Created       : 10/19/2026
+// Project       : KPIX Control Software
+//-----------------------------------------------------------------------------
+// Description :
+// Bank of count histograms which can be filled from several threads.
+//-----------------------------------------------------------------------------
+// Copyright (c) 2012 by SLAC. All rights reserved.
+// Proprietary and confidential to SLAC.
+//-----------------------------------------------------------------------------
+// Modification history :
+// 10/19/2026: created
+//-----------------------------------------------------------------------------
+#ifndef __KPIX_HISTOGRAM_BANK_H__
+#define __KPIX_HISTOGRAM_BANK_H__
+
+#include <sys/types.h>
+#include "KpixHistogram.h"
+
+// Histograms per allocated chunk, 512KB
+#define KPIX_BANK_CHUNK 16
+
+//! This class holds a histogram for every kpix, channel, bucket and range.
+/*!
+ * fill() may be called from any number of threads at once. Bins are updated
+ * with atomic increments, fills never take a lock.
+ * Bins are allocated in zeroed chunks of KPIX_BANK_CHUNK histograms on the
+ * first fill of a histogram in the chunk and kept until the bank is deleted,
+ * only pages of bins which were filled become resident. Values at or above
+ * KPIX_HISTOGRAM_BINS, and values for which a chunk could not be allocated,
+ * are counted in dropped() and otherwise ignored.
+ *
+ * Each kpix, channel and bucket has a generation count which changes on
+ * every fill, and reset() only advances the bank epoch. A histogram stamped
+ * with an older epoch reads as empty and is cleared on its next fill.
+ * A plot is current while both its generation and the epoch are unchanged.
+ */
+class KpixHistogramBank {
+
+      // Range and bins for one histogram, range shares a page with the low bins
+      class KpixBankEntry {
+         public:
+            uint min;
+            uint max;
+            uint epoch;
+            uint bin[KPIX_HISTOGRAM_BINS];
+      };
+
+      // Chunks of histograms, indexed by histogram / KPIX_BANK_CHUNK
+      // Histogram is ((kpix*1024+channel)*4+bucket)*ranges+range
+      KpixBankEntry **chunk_;
+
+      // Number of ranges per bucket
+      uint ranges_;
+
+      // Fill count indexed by (kpix*1024+channel)*4+bucket
+      uint *generation_;
+
+      // Current epoch
+      uint epoch_;
+
+      // Histograms filled since the bank was created
+      uint allocated_;
+
+      // Dropped values
+      uint dropped_;
+
+      // Get entry of a histogram, allocate its chunk if alloc is set
+      KpixBankEntry *lookup ( uint idx, bool alloc );
+
+      // Clear histogram from an older epoch
+      void clear ( KpixBankEntry *entry, uint epoch );
+
+   public:
+
+      //! Constructor
+      KpixHistogramBank ( uint ranges );
+
+      //! DeConstructor
+      ~KpixHistogramBank ( );
+
+      //! Add an entry, thread safe
+      void fill ( uint kpix, uint channel, uint bucket, uint range, uint value );
+
+      //! Copy histogram into hist, returns false if it is empty
+      /*!
+       * Each bin is read atomically. Fills racing with the copy may or may not
+       * be included but the copy is self consistent, its range is trimmed to
+       * the non zero bins copied.
+       */
+      bool snapshot ( uint kpix, uint channel, uint bucket, uint range, KpixHistogram *hist );
+
+      //! Clear all histograms, fills during the reset may be partially kept
+      void reset ( );
+
+      //! Fill count for kpix, channel and bucket
+      uint generation ( uint kpix, uint channel, uint bucket );
+
+      //! Current epoch, advanced by reset
+      uint epoch ( );
+
+      //! Number of histograms filled since the bank was created
+      uint allocated ( );
+
+      //! Number of values dropped, out of range or no memory
+      uint dropped ( );
+};
+
+#endif
@@ -27,11 +27,10 @@
 using namespace std;
 
 // Constructor
-MainWindow::MainWindow ( DataRead *dread, KpixEvent *event, QWidget *parent ) : QWidget (parent) {
+MainWindow::MainWindow ( SharedMem *smem, QWidget *parent ) : QWidget (parent) {
    setWindowTitle("KPIX Live Display");
  
-   dread_ = dread;
-   event_ = event;
+   smem_  = smem;
  
    QVBoxLayout *top = new QVBoxLayout; 
    this->setLayout(top);
@@ -59,6 +58,11 @@ MainWindow::MainWindow ( DataRead *dread, KpixEvent *event, QWidget *parent ) :
    hbox->addWidget(new QLabel("Events:"));
    hbox->addWidget(dText_);
 
+   dropText_ = new QLineEdit;
+   dropText_->setReadOnly(true);
+   hbox->addWidget(new QLabel("Dropped:"));
+   hbox->addWidget(dropText_);
+
    tempLine_ = new QLineEdit;
    tempLine_->setReadOnly(true);
    hbox->addWidget(new QLabel("Temperature:"));
@@ -96,47 +100,58 @@ MainWindow::MainWindow ( DataRead *dread, KpixEvent *event, QWidget *parent ) :
    kpixCalHigh_ = false;
 
    for(uint x=0; x < 32; x++) tempValues_[x] = 0;
+
+   // Histogram and timestamp windows are filled by the reader thread
+   smem_->setFill(hist_,time_);
 }
 
 // Delete
-MainWindow::~MainWindow ( ) { }
+MainWindow::~MainWindow ( ) {
+   smem_->setFill(NULL,NULL);
+}
 
 void MainWindow::event () {
-   KpixSample *sample;
-   uint       x;
-   uint       kpix;
-   uint       type;
-   uint       value;
-
-   calInject_  = (dread_->getStatus("CalState") == "Inject");
-   calChannel_ = dread_->getStatusInt("CalChannel");
-   calDac_     = dread_->getStatusInt("CalDac");
-
-   kpixCalHigh_ = ( dread_->getConfig("kpixFpga:kpixAsic:CntrlCalibHigh") == "True" );
-
-   if ( dread_->getConfig("kpixFpga:kpixAsic:CntrlPolarity") == "Negative" ) kpixPol_ = false;
-   else kpixPol_ = true;
-
-   if ( calInject_ ) calib_->rxData (event_, calChannel_, calDac_, kpixPol_, kpixCalHigh_);
-   else hist_->rxData(event_);
-   time_->rxData(event_);
-   hits_->rxData(event_);
-
-   // Extract temperatures
-   for (x=0; x < event_->count(); x++) {
-      sample  = event_->sample(x);
-      kpix    = sample->getKpixAddress();
-      type    = sample->getSampleType();
-      value   = sample->getSampleValue();
-
-      if ( type == 1 ) tempValues_[kpix] = value;
-   }
-   dCount_++;
+   SharedMemBatch *batch;
+   KpixEvent      *event;
+   KpixSample     *sample;
+   uint           x;
+   uint           y;
+   uint           kpix;
+   uint           type;
+   uint           value;
+
+   if ( (batch = smem_->takeBatch()) == NULL ) return;
+
+   // Drain all waiting batches, each carries the state its events were taken in
+   do {
+      calInject_   = batch->calInject;
+      calChannel_  = batch->calChannel;
+      calDac_      = batch->calDac;
+      kpixPol_     = batch->kpixPol;
+      kpixCalHigh_ = batch->kpixCalHigh;
+
+      for (y=0; y < batch->count; y++) {
+         event = &(batch->event[y]);
+
+         if ( calInject_ ) calib_->rxData (event, calChannel_, calDac_, kpixPol_, kpixCalHigh_);
+         hits_->rxData(event);
+
+         // Extract temperatures
+         for (x=0; x < event->count(); x++) {
+            sample  = event->sample(x);
+            kpix    = sample->getKpixAddress();
+            type    = sample->getSampleType();
+            value   = sample->getSampleValue();
+
+            if ( type == 1 ) tempValues_[kpix] = value;
+         }
+         dCount_++;
+      }
+      smem_->releaseBatch(batch);
+   } while ( (batch = smem_->takeBatch()) != NULL );
 
    if ( follow_->isChecked() && calInject_ && ((uint)chan_->value() != calChannel_ ) ) 
       chan_->setValue(calChannel_);
-
-   ack();
 }
 
 void MainWindow::selChanged() {
@@ -159,6 +174,7 @@ void MainWindow::selChanged() {
    hits_->rePlot(kpix);
 
    dText_->setText(QString().setNum(dCount_));
+   dropText_->setText(QString().setNum(smem_->drops()));
 
    // Convert temperature
    tempAdc = tempValues_[kpix];
@@ -26,7 +26,7 @@
 #include <TimeWindow.h>
 #include <HitWindow.h>
 #include <CalibWindow.h>
-#include "../generic/DataRead.h"
+#include <SharedMem.h>
 #include "../kpix/KpixEvent.h"
 using namespace std;
 
@@ -34,8 +34,7 @@ class MainWindow : public QWidget {
   
    Q_OBJECT
 
-      DataRead    *dread_;
-      KpixEvent   *event_;
+      SharedMem   *smem_;
       HistWindow  *hist_;
       CalibWindow *calib_;
       TimeWindow  *time_;
@@ -50,6 +49,7 @@ class MainWindow : public QWidget {
 
       QLineEdit   *dText_;
       uint        dCount_;
+      QLineEdit   *dropText_;
       QTimer      timer_;
 
       uint  calChannel_;
@@ -61,7 +61,7 @@ class MainWindow : public QWidget {
    public:
 
       // Window
-      MainWindow ( DataRead *dread, KpixEvent *event, QWidget *parent = NULL );
+      MainWindow ( SharedMem *smem, QWidget *parent = NULL );
 
       // Delete
       ~MainWindow ( );
@@ -71,10 +71,6 @@ class MainWindow : public QWidget {
       void selChanged();
       void resetPressed();
       void event ();
-
-   signals:
-
-      void ack ();
 };
 
 #endif
@@ -22,7 +22,6 @@
 #include <QApplication>
 #include <QErrorMessage>
 #include <QObject>
-#include "../generic/DataRead.h"
 #include "../kpix/KpixEvent.h"
 #include "MainWindow.h"
 #include "SharedMem.h"
@@ -30,23 +29,17 @@ using namespace std;
 
 // Main Function
 int main ( int argc, char **argv ) {
-   DataRead  *data  = new DataRead;
-   KpixEvent *event = new KpixEvent;
-
-   data->openShared("kpix",1);
-
    // Start application
    QApplication a( argc, argv );
 
    // Shared memory
-   SharedMem smem(data,event);
+   SharedMem smem;
 
-   MainWindow mainWin(data,event);
+   MainWindow mainWin(&smem);
    mainWin.show();
 
    // Udp signals
    QObject::connect(&smem,SIGNAL(event()),&mainWin,SLOT(event()));
-   QObject::connect(&mainWin,SIGNAL(ack()),&smem,SLOT(ack()));
 
    // Exit on window close
    QObject::connect(&a,SIGNAL(lastWindowClosed()), &a, SLOT(quit())); 
@@ -22,12 +22,21 @@
 using namespace std;
 
 // Constructor
-SharedMem::SharedMem (DataRead *dataRead, KpixEvent *event) {
-   this->dread_ = dataRead;
-   this->event_ = event;
+SharedMem::SharedMem () {
+   uint x;
 
    eventCount = 0;
-   ackCount   = 0;
+   hist_      = NULL;
+   time_      = NULL;
+
+   attached_  = false;
+   dropBase_  = 0;
+   drops_     = 0;
+
+   for (x=0; x < SHARED_MEM_BATCH_COUNT; x++) {
+      batch_[x].count = 0;
+      free_.enqueue(&(batch_[x]));
+   }
 
    runEnable = true;
    QThread::start();
@@ -35,28 +44,208 @@ SharedMem::SharedMem (DataRead *dataRead, KpixEvent *event) {
 
 // Delete
 SharedMem::~SharedMem ( ) { 
+   mutex_.lock();
    runEnable = false;
-   usleep(100);
+   wait_.wakeAll();
+   mutex_.unlock();
+   QThread::wait();
+}
+
+// Pass batch to GUI thread
+void SharedMem::post ( SharedMemBatch *batch ) {
+   bool empty;
+
+   mutex_.lock();
+   empty = full_.isEmpty();
+   full_.enqueue(batch);
+   mutex_.unlock();
+
+   // One signal per group of batches, GUI drains the queue
+   if ( empty ) event();
+}
+
+// Attach to ring
+bool SharedMem::attach () {
+   if ( attached_ ) {
+      if ( ring_.alive() ) return(true);
+      cout << "SharedMem::attach -> Server stopped, waiting for restart" << endl;
+      dropBase_ += ring_.drops();
+      ring_.close();
+      attached_ = false;
+   }
+
+   // Viewer never holds up the server
+   try {
+      ring_.attach("kpix",1,KpixSharedRing::Lossy);
+      attached_ = true;
+      cout << "SharedMem::attach -> Attached to server" << endl;
+   } catch ( string error ) { }
+   return(attached_);
+}
+
+// Get next full batch
+SharedMemBatch *SharedMem::takeBatch () {
+   SharedMemBatch *batch;
+
+   mutex_.lock();
+   batch = full_.isEmpty() ? NULL : full_.dequeue();
+   mutex_.unlock();
+   return(batch);
+}
+
+// Return batch after processing
+void SharedMem::releaseBatch (SharedMemBatch *batch) {
+   mutex_.lock();
+   batch->count = 0;
+   free_.enqueue(batch);
+   wait_.wakeAll();
+   mutex_.unlock();
+}
+
+// Set windows filled by the reader thread
+void SharedMem::setFill (HistWindow *hist, TimeWindow *time) {
+   fillMutex_.lock();
+   hist_ = hist;
+   time_ = time;
+   fillMutex_.unlock();
+}
+
+// Get status value
+string SharedMem::getStatus ( string var ) {
+   string ret;
+
+   xmlMutex_.lock();
+   ret = status_.get(var);
+   xmlMutex_.unlock();
+   return(ret);
+}
+
+// Get status value as integer
+uint SharedMem::getStatusInt ( string var ) {
+   uint ret;
+
+   xmlMutex_.lock();
+   ret = status_.getInt(var);
+   xmlMutex_.unlock();
+   return(ret);
+}
+
+// Get config value
+string SharedMem::getConfig ( string var ) {
+   string ret;
+
+   xmlMutex_.lock();
+   ret = config_.get(var);
+   xmlMutex_.unlock();
+   return(ret);
 }
 
-// Ack
-void SharedMem::ack() {
-   //cout << "Ack=" << dec << ackCount << ", event=" << dec << eventCount << endl;
-   ackCount = eventCount;
+// Events skipped because the reader fell behind the ring
+uint SharedMem::drops () {
+   return(drops_);
 }
 
 // Run
 void SharedMem::run () {
+   SharedMemBatch *batch;
+   KpixEvent      *event;
+   bool           calInject;
+   uint           calChannel;
+   uint           calDac;
+   bool           kpixPol;
+   bool           kpixCalHigh;
+   uint           flag;
+   uint           size;
+   uint           type;
+   uint8_t        *data;
+   string         xml;
+
+   batch       = NULL;
+   calInject   = false;
+   calChannel  = 0;
+   calDac      = 0;
+   kpixPol     = true;
+   kpixCalHigh = false;
    while (runEnable) {
 
-      //if ( ackCount >= eventCount ) {
-         if ( dread_->next(event_)) {
-            event();
-            eventCount++;
+      // Wait for free batch
+      if ( batch == NULL ) {
+         mutex_.lock();
+         while ( runEnable && free_.isEmpty() ) wait_.wait(&mutex_);
+         if ( runEnable ) batch = free_.dequeue();
+         mutex_.unlock();
+         if ( batch == NULL ) break;
+      }
+
+      // No ring, retry until the server starts or we are stopped
+      if ( ! attached_ && ! attach() ) {
+         mutex_.lock();
+         if ( runEnable ) wait_.wait(&mutex_,SHARED_MEM_ATTACH_WAIT);
+         mutex_.unlock();
+         continue;
+      }
+
+      // Ring read waits for new data, no data flushes partial batch and
+      // checks that the server is still running
+      if ( ! ring_.read(&flag,&data,&size,SHARED_MEM_IDLE_WAIT) ) {
+         if ( batch->count > 0 ) {
+            post(batch);
+            batch = NULL;
+         }
+         attach();
+         continue;
+      }
+      drops_ = dropBase_ + ring_.drops();
+      type = (flag >> 28) & 0xF;
+
+      // Add event to batch, pass batch on when full
+      if ( type == 0 ) {
+
+         // State only changes between batches
+         if ( batch->count == 0 ) {
+            batch->calInject   = calInject;
+            batch->calChannel  = calChannel;
+            batch->calDac      = calDac;
+            batch->kpixPol     = kpixPol;
+            batch->kpixCalHigh = kpixCalHigh;
+         }
+         event = &(batch->event[batch->count]);
+         event->copy((uint *)data,size/4);
+         eventCount++;
+
+         // Histograms are filled here, the GUI thread only plots them
+         fillMutex_.lock();
+         if ( hist_ != NULL && ! calInject ) hist_->rxData(event);
+         if ( time_ != NULL ) time_->rxData(event);
+         fillMutex_.unlock();
+
+         if ( ++batch->count == SHARED_MEM_BATCH_SIZE ) {
+            post(batch);
+            batch = NULL;
+         }
+      }
+
+      // Configuration (1) or status (2) update, events before it go out first
+      else if ( type == 1 || type == 2 ) {
+         if ( batch->count > 0 ) {
+            post(batch);
+            batch = NULL;
+         }
+         xml.assign((char *)data,size);
+         xmlMutex_.lock();
+         if ( type == 1 ) {
+            config_.parse("config",xml.c_str());
+            kpixCalHigh = (config_.get("kpixFpga:kpixAsic:CntrlCalibHigh") == "True");
+            kpixPol     = (config_.get("kpixFpga:kpixAsic:CntrlPolarity") != "Negative");
+         }
+         else {
+            status_.parse("status",xml.c_str());
+            calInject  = (status_.get("CalState") == "Inject");
+            calChannel = status_.getInt("CalChannel");
+            calDac     = status_.getInt("CalDac");
          }
-         else usleep(1);
-      //}
-      //else usleep(1);
+         xmlMutex_.unlock();
+      }
    }
 }
 
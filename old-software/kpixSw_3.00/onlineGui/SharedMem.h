@@ -17,30 +17,86 @@
 #define __SHARED_MEM_H__
 
 #include <QThread>
-#include "../generic/DataSharedMem.h"
-#include "../generic/DataRead.h"
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include "../generic/XmlVariables.h"
+#include "../kpix/KpixSharedRing.h"
 #include "../kpix/KpixEvent.h"
+#include "HistWindow.h"
+#include "TimeWindow.h"
 using namespace std;
 
+// Events per batch
+#define SHARED_MEM_BATCH_SIZE  64
+
+// Number of batches, reader blocks when all are waiting for the GUI
+#define SHARED_MEM_BATCH_COUNT 4
+
+// Idle wait for new data in milliseconds
+#define SHARED_MEM_IDLE_WAIT   1
+
+// Wait between attempts to attach to the ring in milliseconds
+#define SHARED_MEM_ATTACH_WAIT 1000
+
+// Batch of events read together, with the calibration state they were taken in
+class SharedMemBatch {
+   public:
+      KpixEvent event[SHARED_MEM_BATCH_SIZE];
+      uint      count;
+      bool      calInject;
+      uint      calChannel;
+      uint      calDac;
+      bool      kpixPol;
+      bool      kpixCalHigh;
+};
+
 class SharedMem : public QThread {
    
    Q_OBJECT
 
       // Event counters
       uint eventCount;
-      uint ackCount;
 
-      // Data reader
-      DataRead  *dread_;  
-      KpixEvent *event_;
+      // Event ring, attached as a lossy consumer by the reader thread
+      KpixSharedRing ring_;
+      bool           attached_;
+
+      // Drops from earlier attachments and total drops
+      uint dropBase_;
+      uint drops_;
+
+      // Configuration and status from the ring
+      XmlVariables config_;
+      XmlVariables status_;
+      QMutex       xmlMutex_;
+
+      // Batches, free batches are owned by the reader thread and full
+      // batches are handed to the GUI thread in order
+      SharedMemBatch          batch_[SHARED_MEM_BATCH_COUNT];
+      QQueue<SharedMemBatch*> free_;
+      QQueue<SharedMemBatch*> full_;
+      QMutex                  mutex_;
+      QWaitCondition          wait_;
+
+      // Windows filled by the reader thread
+      HistWindow *hist_;
+      TimeWindow *time_;
+      QMutex      fillMutex_;
 
       // Run enable
       bool runEnable;
 
+      // Pass batch to GUI thread
+      void post ( SharedMemBatch *batch );
+
+      // Attach to ring, detaching from a closed or exited writer first
+      bool attach ( );
+
    public:
 
       // Creation Class
-      SharedMem (DataRead *dataRead, KpixEvent *event);
+      SharedMem ();
 
       // Delete
       ~SharedMem ();
@@ -48,13 +104,28 @@ class SharedMem : public QThread {
       // Main thread
       void run ();
 
-   public slots:
-      
-      void ack();
+      // Get next full batch, returns NULL if none are waiting
+      SharedMemBatch *takeBatch ();
+
+      // Return batch after processing
+      void releaseBatch (SharedMemBatch *batch);
+
+      // Set windows filled by the reader thread, NULL to stop filling
+      void setFill (HistWindow *hist, TimeWindow *time);
+
+      // Get status value
+      string getStatus ( string var );
+      uint getStatusInt ( string var );
+
+      // Get config value
+      string getConfig ( string var );
+
+      // Events skipped because the reader fell behind the ring
+      uint drops ();
 
    signals:
 
-      // Data
+      // Batch waiting
       void event ();
 };
 
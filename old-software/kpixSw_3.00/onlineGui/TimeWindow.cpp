@@ -30,14 +30,20 @@
 using namespace std;
 
 // Constructor
-TimeWindow::TimeWindow ( QWidget *parent ) : QWidget (parent) {
+TimeWindow::TimeWindow ( QWidget *parent ) : QWidget (parent), data_(1), pool_(4) {
    QString tmp;
    uint x;
 
+   // Nothing displayed
+   plotKpix_ = 32;
+   plotChan_ = 0;
+
    QGridLayout *top = new QGridLayout;
    this->setLayout(top);
 
    for ( x=0; x < 4; x++ ) {
+      view_[x].setPool(&pool_);
+
       plot_[x] = new QwtPlot;
       top->addWidget(plot_[x],x/2,x%2);
 
@@ -109,31 +115,36 @@ void TimeWindow::rxData (KpixEvent *event) {
       time    = sample->getSampleTime();
       type    = sample->getSampleType();
 
-      if ( type == 0 ) data_[kpix][channel][bucket].fill(time);
+      if ( type == 0 ) data_.fill(kpix,channel,bucket,0,time);
    }
 }
 
 void TimeWindow::rePlot(uint kpix, uint chan) {
    uint x;
+   uint gen;
+   uint epoch;
+   bool same;
+
+   epoch = data_.epoch();
+   same  = (kpix == plotKpix_ && chan == plotChan_ && epoch == plotEpoch_);
 
+   // Only rebuild buckets filled since the last plot
    for (x=0; x<4; x++) {
-      setHistData(x,&(data_[kpix][chan][x]));
+      gen = data_.generation(kpix,chan,x);
+      if ( same && gen == plotGen_[x] ) continue;
+      plotGen_[x] = gen;
+
+      data_.snapshot(kpix,chan,x,0,&(view_[x]));
+      setHistData(x,&(view_[x]));
       plot_[x]->replot();
    }
+   plotKpix_  = kpix;
+   plotChan_  = chan;
+   plotEpoch_ = epoch;
 }
 
 void TimeWindow::resetPlot() {
-   uint kpix;
-   uint chan;
-   uint buck;
-
-   for (kpix=0; kpix < 32; kpix++) {
-      for (chan=0; chan < 1024; chan++) {
-         for (buck=0; buck < 4; buck++) {
-            data_[kpix][chan][buck].init();
-         }
-      }
-   }
+   data_.reset();
 }
 
 void TimeWindow::showItem( QwtPlotItem *item, bool on ) {
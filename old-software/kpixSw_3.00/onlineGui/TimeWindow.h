@@ -27,6 +27,7 @@
 #include <qwt_plot_histogram.h>
 #include <KpixEvent.h>
 #include "KpixHistogram.h"
+#include "KpixHistogramBank.h"
 using namespace std;
 
 class TimeWindow : public QWidget {
@@ -37,7 +38,16 @@ class TimeWindow : public QWidget {
 
       void setHistData(uint x, KpixHistogram *time);
 
-      KpixHistogram data_[32][1024][4];
+      // Filled histograms and copies of the displayed channel
+      KpixHistogramBank data_;
+      KpixHistogramPool pool_;
+      KpixHistogram     view_[4];
+
+      // Displayed channel, epoch and bucket generations
+      uint plotKpix_;
+      uint plotChan_;
+      uint plotEpoch_;
+      uint plotGen_[4];
 
    public:
 
@@ -47,6 +57,7 @@ class TimeWindow : public QWidget {
       // Delete
       ~TimeWindow ( );
 
+      // Thread safe
       void rxData (KpixEvent *event);
       void rePlot(uint kpix, uint chan);
       void resetPlot();
@@ -1,6 +1,7 @@
 #include <KpixEvent.h>
 #include <KpixSample.h>
 #include <KpixCalibRead.h>
+#include <KpixChargeTable.h>
 #include <iomanip>
 #include <fstream>
 #include <iostream>
@@ -18,21 +19,22 @@ int main (int argc, char **argv) {
    KpixSample  * sample;
    KpixCalibRead calibRead;
    KpixCalibRead calibReadB;
+   KpixChargeTable table;
    uint          x;
-   double        mean;
-   double        gain;
-   double        charge;
+   double      * charge;
+   bool        * valid;
+   uint          size;
    uint          count;
    stringstream  tmp;
    string        serialList[32];
    string        serial;
+   bool          update;
    TH1F        * hist[9];
    uint          addr;
    uint          bucket;
    uint          time;
    uint          range;
    TCanvas     * c1;
-   double        meanNn;
 
    TApplication theApp("App",NULL,NULL);
    gStyle->SetOptFit(1111);
@@ -67,60 +69,63 @@ int main (int argc, char **argv) {
    }
 
    // Process each event
-   count = 0;
+   count  = 0;
+   size   = 0;
+   charge = NULL;
+   valid  = NULL;
    while ( dataRead.next(&event) ) {
 
       // Get serial numbers after first record
       if ( count == 0 ) {
+         update = false;
          for (x=0; x < 32; x++) {
             tmp.str("");
             tmp << "cntrlFpga(0):kpixAsic(" << dec << x << "):SerialNumber";
-            serialList[x] = dataRead.getConfig(tmp.str());
+            serial = dataRead.getConfig(tmp.str());
+
+            // Extract baseline and gain when the serial number changes, only ASICs with calibration
+            if ( serial != serialList[x] ) {
+               serialList[x] = serial;
+               table.addAsic(x,&calibRead,serialList[x]);
+               update = true;
+            }
+         }
+         if ( update ) {
+            cout << "Charge table: " << dec << table.asicCount() << " ASICs, "
+                 << table.validCount() << " valid entries, "
+                 << table.memoryUsage() / 1024 << " KB" << endl;
          }
       }
 
+      // Convert event, only hits that have valid calibration
+      if ( event.count() > size ) {
+         if ( charge != NULL ) delete[] charge;
+         if ( valid  != NULL ) delete[] valid;
+         size   = event.count();
+         charge = new double[size];
+         valid  = new bool[size];
+      }
+      table.convert(&event,charge,valid);
+
       // Iterate through samples
       for (x=0; x < event.count(); x++) {
+         if ( ! valid[x] ) continue;
 
          // Get sample
          sample = event.sample(x);
 
-         // Get serial number
-         if ( sample->getKpixAddress() < 32 ) serial = serialList[sample->getKpixAddress()];
-         else serial = "";
-
          // Get sample data
-         addr   = sample->getKpixAddress();
-         bucket = sample->getKpixBucket();
-         time   = sample->getSampleTime();
-         range  = sample->getSampleRange();
-
-         // Do something if this is a data sample
-         if ( sample->getSampleType() == KpixSample::Data ) {
+         addr    = sample->getKpixAddress();
+         bucket  = sample->getKpixBucket();
+         time    = sample->getSampleTime();
+         range   = sample->getSampleRange();
 
-            // Get gain and mean for channel/bucket
-            meanNn = calibReadB.baseFitMean(serial,sample->getKpixChannel(),
-                                             sample->getKpixBucket(),
-                                             sample->getSampleRange());
-
-            mean = calibRead.baseFitMean(serial,sample->getKpixChannel(),
-                                             sample->getKpixBucket(),
-                                             sample->getSampleRange());
-
-            gain = calibRead.calibGain(serial,sample->getKpixChannel(),
-                                              sample->getKpixBucket(),
-                                              sample->getSampleRange());
-
-            // Only show hits that have valid calibration
-            if ( mean > 0 && gain > 3e-15 && calibRead.badChannel(serial,sample->getKpixChannel()) == 0 ) {
-               charge = ((double)sample->getSampleValue() - mean) / gain;
-
-               // Time cut
-               if ( range == 0 && bucket == 0 && time == 752 ) hist[addr]->Fill(charge);
-            }
-         }
+         // Time cut
+         if ( range == 0 && bucket == 0 && time == 752 ) hist[addr]->Fill(charge[x]);
       }
    }
+   if ( charge != NULL ) delete[] charge;
+   if ( valid  != NULL ) delete[] valid;
 
    c1 = new TCanvas("c1","c1");
    c1->Divide(3,3,0.01,0.01);
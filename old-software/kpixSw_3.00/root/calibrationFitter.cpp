@@ -24,7 +24,15 @@
 #include <TGraphErrors.h>
 #include <TGraph.h>
 #include <TStyle.h>
+#include <TF1.h>
+#include <TFitResult.h>
+#include <TFitResultPtr.h>
+#include <TROOT.h>
+#include <TVirtualMutex.h>
+#include <RVersion.h>
+#include <Math/MinimizerOptions.h>
 #include <stdarg.h>
+#include <pthread.h>
 #include <KpixEvent.h>
 #include <KpixSample.h>
 #include <Data.h>
@@ -32,14 +40,58 @@
 #include <math.h>
 #include <fstream>
 #include <XmlVariables.h>
+#include <vector>
+#include <map>
+#include <algorithm>
 using namespace std;
 
+// Calibration point data, kept only for injected DAC values
+class CalibPoint {
+   public:
+      double count;
+      double mean;
+      double sum;
+      double rms;
+      double error;
+      bool   final;
+
+      CalibPoint() {
+         count = 0;
+         mean  = 0;
+         sum   = 0;
+         rms   = 0;
+         error = 0;
+         final = false;
+      }
+
+      void compute(double chargeError) {
+         double tmp;
+
+         rms   = sqrt(sum / count);
+         tmp   = rms / sqrt(count);
+         error = sqrt((tmp * tmp) + (chargeError * chargeError));
+         final = true;
+      }
+};
+
+// Crosstalk data, kept only for neighbor channels that deviate from their baseline
+class NeighborPoint {
+   public:
+      double value;
+      double dac;
+
+      NeighborPoint() {
+         value = 0;
+         dac   = 0;
+      }
+};
+
 // Channel data
 class ChannelData {
    public:
 
-      // Baseline Data
-      uint         baseData[8192];
+      // Baseline Data, histogram bins cover baseMin to baseMax only
+      vector<uint> baseData;
       uint         baseMin;
       uint         baseMax;
       double       baseCount;
@@ -54,19 +106,17 @@ class ChannelData {
       double       baseFitSigmaErr;
       double       baseFitChisquare;
 
-      // Calib Data
-      double       calibCount[256];
-      double       calibMean[256];
-      double       calibSum[256];
-      double       calibRms[256];
-      double       calibError[256];
-      double       calibOtherValue[1024];
-      double       calibOtherDac[1024];
+      // Calib Data, keyed by dac and neighbor channel
+      map<uint,CalibPoint>    calib;
+      map<uint,NeighborPoint> calibOther;
 
-      ChannelData() {
-         uint x;
+      // Stage already fit and released, later samples are counted and dropped
+      bool         baseReleased;
+      bool         calibReleased;
+      uint         baseLate;
+      uint         calibLate;
 
-         for (x=0; x < 8192; x++) baseData[x] = 0;
+      ChannelData() {
          baseMin          = 8192;
          baseMax          = 0;
          baseCount        = 0;
@@ -78,24 +128,41 @@ class ChannelData {
          baseFitMeanErr   = 0;
          baseFitSigmaErr  = 0;
          baseFitChisquare = 0;
+         baseReleased     = false;
+         calibReleased    = false;
+         baseLate         = 0;
+         calibLate        = 0;
+      }
 
-         for (x=0; x < 256; x++) {
-            calibCount[x]  = 0;
-            calibMean[x]   = 0;
-            calibSum[x]    = 0;
-            calibRms[x]    = 0;
-            calibError[x]  = 0;
-         }
-         for (x=0; x < 1024; x++) {
-            calibOtherValue[x] = 0;
-            calibOtherDac[x] = 0;
-         }
+      // Histogram count at adc value
+      uint baseBin(uint data) {
+         if ( baseData.empty() || data < baseMin || data > baseMax ) return(0);
+         return(baseData[data-baseMin]);
       }
 
       void addBasePoint(uint data) {
-         baseData[data]++;
-         if ( data < baseMin ) baseMin = data;
-         if ( data > baseMax ) baseMax = data;
+
+         // Baseline already fit
+         if ( baseReleased ) {
+            baseLate++;
+            return;
+         }
+
+         // Grow histogram to cover new value
+         if ( baseData.empty() ) {
+            baseMin = data;
+            baseMax = data;
+            baseData.resize(1,0);
+         }
+         else if ( data < baseMin ) {
+            baseData.insert(baseData.begin(),baseMin-data,0);
+            baseMin = data;
+         }
+         else if ( data > baseMax ) {
+            baseData.resize(data-baseMin+1,0);
+            baseMax = data;
+         }
+         baseData[data-baseMin]++;
          baseCount++;
 
          double tmpM = baseMean;
@@ -106,19 +173,50 @@ class ChannelData {
       }
 
       void addCalibPoint(uint x, uint y) {
-         calibCount[x]++;
+         CalibPoint *pt;
+
+         // Calibration already fit
+         if ( calibReleased ) {
+            calibLate++;
+            return;
+         }
+         pt = &(calib[x]);
+
+         // Point revisited after it was finalized, recompute with new samples
+         pt->final = false;
+         pt->count++;
 
-         double tmpM = calibMean[x];
+         double tmpM = pt->mean;
          double value = y;
 
-         calibMean[x] += (value - tmpM) / calibCount[x];
-         calibSum[x]  += (value - tmpM) * (value - calibMean[x]);
+         pt->mean += (value - tmpM) / pt->count;
+         pt->sum  += (value - tmpM) * (value - pt->mean);
       }
 
-      void addNeighborPoint(uint chan, uint x, uint y) {
-         if ( y > calibOtherValue[chan] ) {
-            calibOtherValue[chan] = y;
-            calibOtherDac[chan] = x;
+      // Only values more than 10 sigma above the neighbor's baseline are kept.
+      // Baselines are complete before injection starts so this matches the
+      // crosstalk cut applied after fitting.
+      void addNeighborPoint(uint chan, uint x, uint y, ChannelData *other) {
+         map<uint,NeighborPoint>::iterator iter;
+         double diff;
+
+         if ( calibReleased ) {
+            calibLate++;
+            return;
+         }
+
+         // Neighbor without baseline samples has zero mean and rms, any
+         // value above zero deviates as in the fit time check
+         diff = (double)y - other->baseMean;
+         if ( diff <= 0 ) return;
+         if ( other->baseCount > 0 && (diff * diff) <= (100.0 * other->baseSum / other->baseCount) ) return;
+
+         iter = calibOther.find(chan);
+         if ( iter == calibOther.end() ) iter = calibOther.insert(make_pair(chan,NeighborPoint())).first;
+
+         if ( y > iter->second.value ) {
+            iter->second.value = y;
+            iter->second.dac   = x;
          }
       }
 
@@ -127,17 +225,32 @@ class ChannelData {
       }
 
       void computeCalib(double chargeError) {
-         uint   x;
-         double tmp;
+         map<uint,CalibPoint>::iterator iter;
 
-         for (x=0; x < 256; x++) {
-            if ( calibCount[x] > 0 ) {
-               calibRms[x] = sqrt(calibSum[x] / calibCount[x]);
-               tmp = calibRms[x] / sqrt(calibCount[x]);
-               calibError[x] = sqrt((tmp * tmp) + (chargeError * chargeError));
-            }
+         for (iter=calib.begin(); iter != calib.end(); iter++) {
+            if ( ! iter->second.final ) iter->second.compute(chargeError);
          }
       }
+
+      // Finalize a single calibration point once all of its samples are taken
+      void finalizePoint(uint x, double chargeError) {
+         map<uint,CalibPoint>::iterator iter;
+
+         if ( (iter = calib.find(x)) != calib.end() ) iter->second.compute(chargeError);
+      }
+
+      // Free baseline histogram once it has been fit
+      void releaseBase() {
+         vector<uint>().swap(baseData);
+         baseReleased = true;
+      }
+
+      // Free calibration accumulators once they have been fit
+      void releaseCalib() {
+         calib.clear();
+         calibOther.clear();
+         calibReleased = true;
+      }
 };
 
 // Function to compute calibration charge
@@ -156,7 +269,7 @@ double calibCharge ( uint dac, bool positive, bool highCalib ) {
    return(charge);
 }
 
-void addDoubleToXml ( ofstream *xml, uint indent, string variable, Double_t value ) {
+void addDoubleToXml ( ostream *xml, uint indent, string variable, Double_t value ) {
    uint x;
 
    if ( ! isnan(value) ) {
@@ -168,7 +281,7 @@ void addDoubleToXml ( ofstream *xml, uint indent, string variable, Double_t valu
    }
 }
 
-void addStringToXml ( ofstream *xml, uint indent, string variable, string value ) {
+void addStringToXml ( ostream *xml, uint indent, string variable, string value ) {
    uint x;
 
    for (x=0; x < indent; x++) *xml << " ";
@@ -179,6 +292,860 @@ void addStringToXml ( ofstream *xml, uint indent, string variable, string value
 }
 
 
+// Closed form weighted least squares fit of a line to points with y errors.
+// Only points inside min to max are used when max > min. Parameter errors
+// match the chisq=chisq_min+1 errors returned by minuit for the same fit.
+bool fastLineFit ( uint count, double *x, double *y, double *yErr, double min, double max,
+                   double *par, double *parErr, double *chisq, uint *ndf ) {
+   double w;
+   double sw;
+   double swx;
+   double swy;
+   double sxx;
+   double sxy;
+   double xm;
+   double ym;
+   double d;
+   uint   n;
+   uint   i;
+
+   sw  = 0;
+   swx = 0;
+   swy = 0;
+   n   = 0;
+   for (i=0; i < count; i++) {
+      if ( max > min && (x[i] < min || x[i] > max) ) continue;
+      if ( yErr[i] <= 0 ) return(false);
+      w    = 1.0 / (yErr[i] * yErr[i]);
+      sw  += w;
+      swx += w * x[i];
+      swy += w * y[i];
+      n++;
+   }
+   if ( n < 3 ) return(false);
+   xm = swx / sw;
+   ym = swy / sw;
+
+   // Centered sums to avoid cancellation with charge sized x values
+   sxx = 0;
+   sxy = 0;
+   for (i=0; i < count; i++) {
+      if ( max > min && (x[i] < min || x[i] > max) ) continue;
+      w    = 1.0 / (yErr[i] * yErr[i]);
+      sxx += w * (x[i] - xm) * (x[i] - xm);
+      sxy += w * (x[i] - xm) * (y[i] - ym);
+   }
+   if ( sxx <= 0 ) return(false);
+
+   par[1]    = sxy / sxx;
+   par[0]    = ym - par[1] * xm;
+   parErr[1] = sqrt(1.0 / sxx);
+   parErr[0] = sqrt((1.0 / sw) + (xm * xm / sxx));
+
+   *chisq = 0;
+   for (i=0; i < count; i++) {
+      if ( max > min && (x[i] < min || x[i] > max) ) continue;
+      d       = (y[i] - par[0] - par[1] * x[i]) / yErr[i];
+      *chisq += d * d;
+   }
+   *ndf = n - 2;
+   return(true);
+}
+
+// Gaussian estimate of baseline histogram from moments truncated at +/-3 sigma.
+// Values are for bin centers, matching a gaus fit to the baseline histogram.
+bool fastGausFit ( ChannelData *data, double *par, double *parErr, double *chisq, uint *ndf ) {
+   double sn;
+   double sx;
+   double sxx;
+   double mean;
+   double var;
+   double lo;
+   double hi;
+   double xc;
+   double n;
+   double f;
+   uint   nbins;
+   uint   iter;
+   uint   x;
+
+   if ( data->baseData.empty() ) return(false);
+
+   // First pass full range, then two truncated passes
+   lo   = data->baseMin;
+   hi   = data->baseMax + 1;
+   mean = 0;
+   var  = 0;
+   sn   = 0;
+   for (iter=0; iter < 3; iter++) {
+      sn  = 0;
+      sx  = 0;
+      sxx = 0;
+      for (x=data->baseMin; x <= data->baseMax; x++) {
+         xc = x + 0.5;
+         if ( xc < lo || xc > hi ) continue;
+         n    = data->baseBin(x);
+         sn  += n;
+         sx  += n * xc;
+         sxx += n * xc * xc;
+      }
+      if ( sn == 0 ) return(false);
+      mean = sx / sn;
+      var  = (sxx / sn) - (mean * mean);
+
+      // Correct for +/-3 sigma truncation
+      if ( iter > 0 ) {
+         var /= 0.973337;
+         sn  /= 0.997300;
+      }
+      if ( var <= 0 ) return(false);
+      lo = mean - 3.0 * sqrt(var);
+      hi = mean + 3.0 * sqrt(var);
+   }
+
+   // Sheppard correction for bin width
+   var -= (1.0 / 12.0);
+   if ( var <= 0 ) return(false);
+
+   par[2]    = sqrt(var);
+   par[1]    = mean;
+   par[0]    = sn / (par[2] * sqrt(2.0 * M_PI));
+   parErr[2] = par[2] / sqrt(2.0 * sn);
+   parErr[1] = par[2] / sqrt(sn);
+   parErr[0] = par[0] * sqrt(1.5 / sn);
+
+   // Chisq against non-empty bins, as used by the histogram fit
+   *chisq = 0;
+   nbins  = 0;
+   for (x=data->baseMin; x <= data->baseMax; x++) {
+      n = data->baseBin(x);
+      if ( n == 0 ) continue;
+      xc      = x + 0.5;
+      f       = par[0] * exp(-0.5 * (xc - par[1]) * (xc - par[1]) / var);
+      *chisq += (n - f) * (n - f) / n;
+      nbins++;
+   }
+   if ( nbins < 4 ) return(false);
+   *ndf = nbins - 3;
+   return(true);
+}
+
+// Settings shared by all fit threads, read only during fitting
+class FitSettings {
+   public:
+      ChannelData *(*chanData)[1024][4][2];
+      double       fitMin[2];
+      double       fitMax[2];
+      double       chargeError[2];
+      bool         positive;
+      bool         b0CalibHigh;
+
+      // Fast fit settings and quality cuts
+      bool         fastFit;
+      bool         fastVerify;
+      double       fastMaxChisq;
+      double       meanMin[2];
+      double       meanMax[2];
+      double       gainMin[2];
+      double       gainMax[2];
+};
+
+// Create fit function named after its formula and kept out of the global
+// function list, so it neither shadows the built in formula nor races
+// with other fit threads
+TF1 *newFitFunc ( const char *formula, double min, double max ) {
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,10,0)
+   return(new TF1(formula,formula,min,max,TF1::EAddToList::kNo));
+#else
+   static uint  count = 0;
+   stringstream tmp;
+   TF1          *func;
+
+   // Older root always adds to the list, use a unique name and remove it
+   tmp.str("");
+   tmp << formula << "_fast_" << dec << __sync_fetch_and_add(&count,1);
+   func = new TF1(tmp.str().c_str(),formula,min,max);
+   {
+      R__LOCKGUARD2(gROOTMutex);
+      gROOT->GetListOfFunctions()->Remove(func);
+   }
+   func->SetName(formula);
+   return(func);
+#endif
+}
+
+// Fit work item, one per kpix/channel/bucket/range
+class FitItem {
+   public:
+      uint          kpix;
+      uint          channel;
+      uint          bucket;
+      uint          range;
+      string        serial;
+      ChannelData   *data;
+      bool          done;
+      bool          baseDone;
+      bool          calibDone;
+
+      // Baseline results
+      TH1F          *hist;
+      bool          baseFitOk;
+      bool          baseFast;
+
+      // Calibration results
+      TGraphErrors  *grCalib;
+      TGraph        *grResid;
+      string        crossString;
+      string        crossStringCsv;
+      bool          gainFast;
+
+      // Calibration output, written in order once all channels are done
+      string        xmlText;
+      string        csvText;
+
+      // Fast fit minus minuit fit, when verifying
+      bool          baseVerified;
+      bool          gainVerified;
+      double        diffMean;
+      double        diffSigma;
+      double        diffGain;
+      double        diffIntercept;
+
+      FitItem ( uint kpix, uint channel, uint bucket, uint range, string serial, ChannelData *data ) {
+         this->kpix    = kpix;
+         this->channel = channel;
+         this->bucket  = bucket;
+         this->range   = range;
+         this->serial  = serial;
+         this->data    = data;
+         done          = false;
+         baseDone      = false;
+         calibDone     = false;
+         hist          = NULL;
+         baseFitOk     = false;
+         baseFast      = false;
+         grCalib       = NULL;
+         grResid       = NULL;
+         gainFast      = false;
+         baseVerified  = false;
+         gainVerified  = false;
+         diffMean      = 0;
+         diffSigma     = 0;
+         diffGain      = 0;
+         diffIntercept = 0;
+      }
+};
+
+// Compute and fit baseline histogram
+void fitBase ( FitItem *item, FitSettings *set ) {
+   stringstream tmp;
+   ChannelData  *data = item->data;
+   TF1          *func;
+   TFitResultPtr res;
+   double       par[3];
+   double       parErr[3];
+   double       chisq;
+   uint         ndf;
+   uint         x;
+
+   data->computeBase();
+
+   // Create histogram
+   tmp.str("");
+   tmp << "hist_" << item->serial << "_c" << dec << setw(4) << setfill('0') << item->channel;
+   tmp << "_b" << dec << item->bucket;
+   tmp << "_r" << dec << item->range;
+   item->hist = new TH1F(tmp.str().c_str(),tmp.str().c_str(),8192,0,8192);
+
+   // Fill histogram
+   for (x=data->baseMin; x <= data->baseMax; x++) item->hist->SetBinContent(x+1,data->baseBin(x));
+   item->hist->GetXaxis()->SetRangeUser(data->baseMin,data->baseMax);
+
+   // Use moment estimate if it passes quality cuts, otherwise fit with minuit
+   if ( set->fastFit && fastGausFit(data,par,parErr,&chisq,&ndf) &&
+        ((chisq / ndf) <= set->fastMaxChisq) &&
+        (par[1] >= set->meanMin[item->range]) && (par[1] <= set->meanMax[item->range]) ) {
+      func = newFitFunc("gaus",data->baseMin,data->baseMax+1);
+      func->SetParameters(par[0],par[1],par[2]);
+      func->SetParErrors(parErr);
+      func->SetChisquare(chisq);
+      func->SetNDF(ndf);
+      func->SetNumberFitPoints(ndf+3);
+      item->hist->GetListOfFunctions()->Add(func);
+      item->baseFast = true;
+
+      // Compare against minuit fit
+      if ( set->fastVerify ) {
+         res = item->hist->Fit("gaus","qNS");
+         if ( (int)res == 0 ) {
+            item->baseVerified = true;
+            item->diffMean     = par[1] - res->Parameter(1);
+            item->diffSigma    = par[2] - res->Parameter(2);
+         }
+      }
+   }
+   else item->hist->Fit("gaus","q");
+
+   if ( (func = item->hist->GetFunction("gaus")) != NULL ) {
+      item->baseFitOk        = true;
+      data->baseFitMean      = func->GetParameter(1);
+      data->baseFitSigma     = func->GetParameter(2);
+      data->baseFitMeanErr   = func->GetParError(1);
+      data->baseFitSigmaErr  = func->GetParError(2);
+
+      if ( func->GetNDF() == 0 ) data->baseFitChisquare = 0;
+      else data->baseFitChisquare = (func->GetChisquare() / func->GetNDF());
+   }
+}
+
+// Compute calibration graph, crosstalk and fit
+void fitCalib ( FitItem *item, FitSettings *set ) {
+   ChannelData                       *data = item->data;
+   ChannelData                       *other;
+   map<uint,CalibPoint>::iterator    calIter;
+   map<uint,NeighborPoint>::iterator crIter;
+   stringstream                      crossString;
+   stringstream                      crossStringCsv;
+   double                            crossDiff;
+   uint                              crChan;
+   vector< pair<uint,uint> >         cross;
+   uint                              x;
+   double                            grX[256];
+   double                            grY[256];
+   double                            grYErr[256];
+   double                            grXErr[256];
+   double                            grRes[256];
+   uint                              grCount;
+   TF1                               *func;
+   TFitResultPtr                     res;
+   double                            par[2];
+   double                            parErr[2];
+   double                            chisq;
+   double                            min;
+   double                            max;
+   uint                              ndf;
+
+   data->computeCalib(set->chargeError[item->range]);
+
+   // Create calibration graph
+   grCount = 0;
+   crossString.str("");
+   crossStringCsv.str("");
+   for (calIter=data->calib.begin(); calIter != data->calib.end(); calIter++) {
+      x = calIter->first;
+
+      // Add calibration point
+      grX[grCount]    = calibCharge ( x, set->positive, ((item->bucket==0)?set->b0CalibHigh:false));
+      grY[grCount]    = calIter->second.mean;
+      grYErr[grCount] = calIter->second.error;
+      grXErr[grCount] = 0;
+      grCount++;
+   }
+
+   // Find crosstalk, value - base > 10 * sigma at a dac point that was fit.
+   // Only deviating neighbors are stored, report them ordered by dac then channel.
+   cross.clear();
+   for (crIter=data->calibOther.begin(); crIter != data->calibOther.end(); crIter++) {
+      crChan = crIter->first;
+      other  = set->chanData[item->kpix][crChan][item->bucket][item->range];
+
+      if ( other != NULL && crChan != item->channel && 
+           data->calib.find((uint)crIter->second.dac) != data->calib.end() ) {
+         crossDiff = crIter->second.value - other->baseMean;
+         if ( crossDiff > (10.0 * other->baseRms) ) cross.push_back(make_pair((uint)crIter->second.dac,crChan));
+      }
+   }
+   sort(cross.begin(),cross.end());
+
+   for (x=0; x < cross.size(); x++) {
+      crChan    = cross[x].second;
+      other     = set->chanData[item->kpix][crChan][item->bucket][item->range];
+      crossDiff = data->calibOther[crChan].value - other->baseMean;
+
+      if ( crossString.str() != "" ) crossString << " ";
+      crossString << dec << crChan << ":" << dec << (uint)crossDiff;
+      crossStringCsv << "," << dec << crChan << "," << dec << (uint)crossDiff;
+   }
+   item->crossString    = crossString.str();
+   item->crossStringCsv = crossStringCsv.str();
+
+   // Create graph
+   if ( grCount > 0 ) {
+      item->grCalib = new TGraphErrors(grCount,grX,grY,grXErr,grYErr);
+
+      // Use weighted least squares if it passes quality cuts, otherwise fit with minuit
+      if ( set->fastFit &&
+           fastLineFit(grCount,grX,grY,grYErr,set->fitMin[item->range],set->fitMax[item->range],par,parErr,&chisq,&ndf) &&
+           ((chisq / ndf) <= set->fastMaxChisq) &&
+           (par[1] >= set->gainMin[item->range]) && (par[1] <= set->gainMax[item->range]) ) {
+
+         // Function range matches the range used by minuit
+         min = set->fitMin[item->range];
+         max = set->fitMax[item->range];
+         if ( max <= min ) {
+            min = grX[0];
+            max = grX[0];
+            for (x=1; x < grCount; x++) {
+               if ( grX[x] < min ) min = grX[x];
+               if ( grX[x] > max ) max = grX[x];
+            }
+         }
+         func = newFitFunc("pol1",min,max);
+         func->SetParameters(par[0],par[1]);
+         func->SetParErrors(parErr);
+         func->SetChisquare(chisq);
+         func->SetNDF(ndf);
+         func->SetNumberFitPoints(ndf+2);
+         item->grCalib->GetListOfFunctions()->Add(func);
+         item->gainFast = true;
+
+         // Compare against minuit fit
+         if ( set->fastVerify ) {
+            res = item->grCalib->Fit("pol1","eqNS","",set->fitMin[item->range],set->fitMax[item->range]);
+            if ( (int)res == 0 ) {
+               item->gainVerified  = true;
+               item->diffGain      = par[1] - res->Parameter(1);
+               item->diffIntercept = par[0] - res->Parameter(0);
+            }
+         }
+      }
+      else item->grCalib->Fit("pol1","eq","",set->fitMin[item->range],set->fitMax[item->range]);
+      item->grCalib->GetFunction("pol1")->SetLineWidth(1);
+
+      // Create residual plot
+      for (x=0; x < grCount; x++) grRes[x] = (grY[x] - item->grCalib->GetFunction("pol1")->Eval(grX[x]));
+      item->grResid = new TGraph(grCount,grX,grRes);
+   }
+}
+
+// Fit thread pool. Items are fit by the worker threads in any order, at most
+// window items ahead of the reader, and are returned by next() in the order
+// they were added. With zero threads items are fit in next() by the caller.
+class FitPool {
+      FitSettings       *settings_;
+      vector<FitItem *> *items_;
+      pthread_t         *threads_;
+      uint              threadCount_;
+      pthread_mutex_t   mutex_;
+      pthread_cond_t    cond_;
+      uint              fitIdx_;
+      uint              readIdx_;
+      uint              window_;
+      bool              calib_;
+
+      static void *runStatic ( void *p ) {
+         ((FitPool *)p)->run();
+         pthread_exit(NULL);
+         return(NULL);
+      }
+
+      void fit ( FitItem *item ) {
+         if ( calib_ ) fitCalib(item,settings_);
+         else fitBase(item,settings_);
+      }
+
+      void run ( ) {
+         FitItem *item;
+
+         pthread_mutex_lock(&mutex_);
+         while ( fitIdx_ < items_->size() ) {
+
+            // Too far ahead of reader
+            if ( fitIdx_ >= (readIdx_ + window_) ) {
+               pthread_cond_wait(&cond_,&mutex_);
+               continue;
+            }
+            item = (*items_)[fitIdx_++];
+            pthread_mutex_unlock(&mutex_);
+
+            fit(item);
+
+            pthread_mutex_lock(&mutex_);
+            item->done = true;
+            pthread_cond_broadcast(&cond_);
+         }
+         pthread_mutex_unlock(&mutex_);
+      }
+
+   public:
+
+      FitPool ( uint threadCount, FitSettings *settings ) {
+         settings_    = settings;
+         items_       = NULL;
+         threadCount_ = threadCount;
+         threads_     = new pthread_t[threadCount+1];
+         window_      = threadCount * 4;
+         fitIdx_      = 0;
+         readIdx_     = 0;
+         calib_       = false;
+         pthread_mutex_init(&mutex_,NULL);
+         pthread_cond_init(&cond_,NULL);
+      }
+
+      ~FitPool ( ) {
+         pthread_cond_destroy(&cond_);
+         pthread_mutex_destroy(&mutex_);
+         delete[] threads_;
+      }
+
+      // Start fitting a list of items
+      void start ( vector<FitItem *> *items, bool calib ) {
+         uint x;
+
+         items_   = items;
+         calib_   = calib;
+         fitIdx_  = 0;
+         readIdx_ = 0;
+         for (x=0; x < items_->size(); x++) (*items_)[x]->done = false;
+
+         for (x=0; x < threadCount_; x++) {
+            if ( pthread_create(&threads_[x],NULL,runStatic,this) ) {
+               cout << "FitPool::start -> Failed to create fit thread" << endl;
+               threadCount_ = x;
+               break;
+            }
+         }
+      }
+
+      // Get next item in order, waits for it to be fit
+      FitItem *next ( ) {
+         FitItem *item;
+
+         if ( readIdx_ >= items_->size() ) return(NULL);
+
+         // Fit locally
+         if ( threadCount_ == 0 ) {
+            item = (*items_)[readIdx_++];
+            fit(item);
+            return(item);
+         }
+
+         pthread_mutex_lock(&mutex_);
+         item = (*items_)[readIdx_];
+         while ( ! item->done ) pthread_cond_wait(&cond_,&mutex_);
+         readIdx_++;
+         pthread_cond_broadcast(&cond_);
+         pthread_mutex_unlock(&mutex_);
+         return(item);
+      }
+
+      // Wait for threads to exit
+      void stop ( ) {
+         uint x;
+         for (x=0; x < threadCount_; x++) pthread_join(threads_[x],NULL);
+      }
+};
+
+// Output state for the baseline and calibration stages, used from the main thread only
+class FitOutput {
+   public:
+      FitPool     *pool;
+      FitSettings *set;
+      DataRead    *dataRead;
+      ofstream    *debug;
+      ChannelData *(*chanData)[1024][4][2];
+      FitItem     *(*fitItem)[1024][4][2];
+      bool        (*badMean)[1024];
+      bool        (*badGain)[1024];
+      uint        maxChan;
+
+      // Bad channel selection
+      bool        findBadMeanHist;
+      bool        findBadMeanFit;
+      bool        findBadMeanChisq;
+      bool        findBadGainFit;
+      bool        findBadGainChisq;
+      double      meanChisq;
+      double      gainChisq;
+
+      // Counters
+      uint        badMeanFitCnt;
+      uint        badMeanHistCnt;
+      uint        badMeanChisqCnt;
+      uint        badGainFitCnt;
+      uint        badGainChisqCnt;
+      uint        failedGainFit;
+      uint        failedMeanFit;
+      uint        fastMeanCnt;
+      uint        fastGainCnt;
+      double      maxDiffMean;
+      double      maxDiffSigma;
+      double      maxDiffGain;
+      double      maxDiffIntercept;
+
+      FitOutput() {
+         badMeanFitCnt    = 0;
+         badMeanHistCnt   = 0;
+         badMeanChisqCnt  = 0;
+         badGainFitCnt    = 0;
+         badGainChisqCnt  = 0;
+         failedGainFit    = 0;
+         failedMeanFit    = 0;
+         fastMeanCnt      = 0;
+         fastGainCnt      = 0;
+         maxDiffMean      = 0;
+         maxDiffSigma     = 0;
+         maxDiffGain      = 0;
+         maxDiffIntercept = 0;
+      }
+};
+
+// Write baseline histogram and check for bad mean
+void writeBase ( FitItem *item, FitOutput *out ) {
+   ChannelData *data    = item->data;
+   uint        kpix     = item->kpix;
+   uint        channel  = item->channel;
+   uint        bucket   = item->bucket;
+   uint        range    = item->range;
+   ofstream    &debug   = *(out->debug);
+
+   // Show progress
+   cout << "\rProcessing baseline kpix " << dec << kpix
+        << ", Channel " << channel << " / " << dec << out->maxChan
+        << "                 " << flush;
+
+   item->hist->Write();
+   delete item->hist;
+   item->hist = NULL;
+
+   // Fast fit statistics
+   if ( item->baseFast ) out->fastMeanCnt++;
+   if ( item->baseVerified ) {
+      debug << "Kpix=" << dec << kpix << " Channel=" << dec << channel << " Bucket=" << dec << bucket
+            << " Range=" << dec << range
+            << " Fast fit mean diff=" << item->diffMean
+            << " sigma diff=" << item->diffSigma << endl;
+      if ( fabs(item->diffMean)  > out->maxDiffMean  ) out->maxDiffMean  = fabs(item->diffMean);
+      if ( fabs(item->diffSigma) > out->maxDiffSigma ) out->maxDiffSigma = fabs(item->diffSigma);
+   }
+
+   if ( item->baseFitOk ) {
+
+      // Determine bad channel from fitted chisq
+      if ( out->findBadMeanChisq && (data->baseFitChisquare > out->meanChisq) ) {
+         debug << "Kpix=" << dec << kpix << " Channel=" << dec << channel << " Bucket=" << dec << bucket
+               << " Range=" << dec << range 
+               << " Bad fit mean chisq=" << data->baseFitChisquare << endl;
+         out->badMean[kpix][channel] = true;
+         out->badMeanChisqCnt++;
+      }
+
+      // Determine bad channel from fitted mean
+      if ( out->findBadMeanFit &&
+            ( (data->baseFitMean > out->set->meanMax[range]) ||  
+              (data->baseFitMean < out->set->meanMin[range]) ) ) {
+         debug << "Kpix=" << dec << kpix << " Channel=" << dec << channel << " Bucket=" << dec << bucket
+               << " Range=" << dec << range 
+               << " Bad fit mean value=" << data->baseFitMean << endl;
+         out->badMean[kpix][channel] = true;
+         out->badMeanFitCnt++;
+      }
+   }
+   else if ( out->findBadMeanFit || out->findBadMeanChisq ) {
+      debug << "Kpix=" << dec << kpix << " Channel=" << dec << channel 
+            << " Bucket=" << dec << bucket << " Range=" << dec << range
+            << " Failed to fit mean" << endl;
+      out->badMean[kpix][channel] = true;
+      out->failedMeanFit++;
+   }
+
+   // Determine bad channel from histogram mean
+   if ( out->findBadMeanHist && 
+         ( (data->baseMean > out->set->meanMax[range]) ||
+           (data->baseMean < out->set->meanMin[range]) ) ) {
+      debug << "Kpix=" << dec << kpix << " Channel=" << dec << channel << " Bucket=" << dec << bucket
+            << " Range=" << dec << range
+            << " Bad hist mean value=" << data->baseMean << endl;
+      out->badMeanHistCnt++;
+      out->badMean[kpix][channel] = true;
+   }
+
+   data->releaseBase();
+   item->baseDone = true;
+}
+
+// Write calibration graphs, generate xml and csv output and check for bad gain
+void writeCalib ( FitItem *item, FitOutput *out ) {
+   ChannelData  *data    = item->data;
+   uint         kpix     = item->kpix;
+   uint         channel  = item->channel;
+   uint         bucket   = item->bucket;
+   uint         range    = item->range;
+   ofstream     &debug   = *(out->debug);
+   TGraphErrors *grCalib = item->grCalib;
+   TGraph       *grResid = item->grResid;
+   stringstream xml;
+   stringstream csv;
+   stringstream tmp;
+   double       chisqNdf;
+
+   // Show progress
+   cout << "\rProcessing calibration kpix " << dec << kpix
+        << ", Channel " << channel << " / " << dec << out->maxChan
+        << "                 " << flush;
+
+   xml << "            <Range id=\"" << range << "\">" << endl;
+   csv << item->serial << "," << dec << channel << "," << dec << bucket << "," << dec << range;
+
+   // Fast fit statistics
+   if ( item->gainFast ) out->fastGainCnt++;
+   if ( item->gainVerified ) {
+      debug << "Kpix=" << dec << kpix << " Channel=" << dec << channel << " Bucket=" << dec << bucket
+            << " Range=" << dec << range
+            << " Fast fit gain diff=" << item->diffGain
+            << " intercept diff=" << item->diffIntercept << endl;
+      if ( fabs(item->diffGain)      > out->maxDiffGain      ) out->maxDiffGain      = fabs(item->diffGain);
+      if ( fabs(item->diffIntercept) > out->maxDiffIntercept ) out->maxDiffIntercept = fabs(item->diffIntercept);
+   }
+
+   // Add baseline data to xml
+   addDoubleToXml(&xml,15,"BaseMean",data->baseMean);
+   addDoubleToXml(&xml,15,"BaseRms",data->baseRms);
+   if ( data->baseFitMean != 0 ) {
+      addDoubleToXml(&xml,15,"BaseFitMean",data->baseFitMean);
+      addDoubleToXml(&xml,15,"BaseFitSigma",data->baseFitSigma);
+      addDoubleToXml(&xml,15,"BaseFitMeanErr",data->baseFitMeanErr);
+      addDoubleToXml(&xml,15,"BaseFitSigmaErr",data->baseFitSigmaErr);
+      addDoubleToXml(&xml,15,"BaseFitChisquare",data->baseFitChisquare);
+   }
+
+   // Add baseline data to excel file
+   csv << "," << data->baseMean;
+   csv << "," << data->baseRms;
+   csv << "," << data->baseFitMean;
+   csv << "," << data->baseFitSigma;
+   csv << "," << data->baseFitMeanErr;
+   csv << "," << data->baseFitSigmaErr;
+   csv << "," << data->baseFitChisquare;
+
+   // Graph is valid
+   if ( grCalib != NULL ) {
+      grCalib->Draw("Ap");
+
+      // Create name and write
+      tmp.str("");
+      tmp << "calib_" << item->serial << "_c" << dec << setw(4) << setfill('0') << channel;
+      tmp << "_b" << dec << bucket;
+      tmp << "_r" << dec << range;
+      grCalib->SetTitle(tmp.str().c_str());
+      grCalib->Write(tmp.str().c_str());
+
+      // Store residual plot
+      grResid->Draw("Ap");
+
+      // Create name and write
+      tmp.str("");
+      tmp << "resid_" << item->serial << "_c" << dec << setw(4) << setfill('0') << channel;
+      tmp << "_b" << dec << bucket;
+      tmp << "_r" << dec << range;
+      grResid->SetTitle(tmp.str().c_str());
+      grResid->Write(tmp.str().c_str());
+
+      // Add to xml
+      if ( grCalib->GetFunction("pol1") ) {
+         chisqNdf = (grCalib->GetFunction("pol1")->GetChisquare() / grCalib->GetFunction("pol1")->GetNDF());
+
+         addDoubleToXml(&xml,15,"CalibGain",grCalib->GetFunction("pol1")->GetParameter(1));
+         addDoubleToXml(&xml,15,"CalibIntercept",grCalib->GetFunction("pol1")->GetParameter(0));
+         addDoubleToXml(&xml,15,"CalibGainErr",grCalib->GetFunction("pol1")->GetParError(1));
+         addDoubleToXml(&xml,15,"CalibInterceptErr",grCalib->GetFunction("pol1")->GetParError(0));
+         addDoubleToXml(&xml,15,"CalibChisquare",chisqNdf);
+         csv << "," << grCalib->GetFunction("pol1")->GetParameter(1);
+         csv << "," << grCalib->GetFunction("pol1")->GetParameter(0);
+         csv << "," << grCalib->GetFunction("pol1")->GetParError(1);
+         csv << "," << grCalib->GetFunction("pol1")->GetParError(0);
+         csv << "," << chisqNdf;
+
+         // Determine bad channel from fitted gain
+         if ( out->findBadGainFit && 
+               ( (grCalib->GetFunction("pol1")->GetParameter(1) > out->set->gainMax[range]) ||
+                 (grCalib->GetFunction("pol1")->GetParameter(1) < out->set->gainMin[range]) ) ) {
+            debug << "Kpix=" << dec << kpix << " Channel=" << dec << channel << " Bucket=" << dec << bucket
+                  << " Range=" << dec << range
+                  << " Bad gain value=" << grCalib->GetFunction("pol1")->GetParameter(1) << endl;
+            out->badGain[kpix][channel] = true;
+            out->badGainFitCnt++;
+         }
+
+         // Determine bad channel from fitted chisq
+         if ( out->findBadGainChisq && (chisqNdf > out->gainChisq) ) {
+            debug << "Kpix=" << dec << kpix << " Channel=" << dec << channel << " Bucket=" << dec << bucket
+                  << " Range=" << dec << range
+                  << " Bad gain chisq=" << out->gainChisq << endl;
+            out->badGain[kpix][channel] = true;
+            out->badGainChisqCnt++;
+         }
+      }
+      else {
+         csv << ",0,0,0,0,0";
+         if ( out->findBadGainFit || out->findBadGainChisq ) {
+            debug << "Kpix=" << dec << kpix << " Channel=" << dec << channel << " Bucket=" << dec << bucket
+                  << " Range=" << dec << range
+                  << " Failed to fit gain" << endl;
+            out->badGain[kpix][channel] = true;
+            out->failedGainFit++;
+         }
+      }
+
+      addDoubleToXml(&xml,15,"CalibGainRms",grCalib->GetRMS(2));
+      csv << "," << grCalib->GetRMS(2);
+
+      if ( item->crossString != "" ) addStringToXml(&xml,15,"CalibCrossTalk",item->crossString);
+      csv << item->crossStringCsv;
+
+      delete grCalib;
+      delete grResid;
+      item->grCalib = NULL;
+      item->grResid = NULL;
+   }
+   csv << endl; 
+   xml << "            </Range>" << endl;
+
+   item->xmlText = xml.str();
+   item->csvText = csv.str();
+   data->releaseCalib();
+   item->calibDone = true;
+}
+
+// Add items for a kpix channel to a list in output order, skipping those whose stage is done
+void addFitItems ( vector<FitItem *> *list, bool calib, FitOutput *out, uint kpix, uint channel ) {
+   stringstream tmp;
+   ChannelData  *data;
+   FitItem      *item;
+   uint         bucket;
+   uint         range;
+
+   for (bucket = 0; bucket < 4; bucket++) {
+      for (range = 0; range < 2; range++) {
+         if ( (data = out->chanData[kpix][channel][bucket][range]) == NULL ) continue;
+
+         // Create item
+         if ( (item = out->fitItem[kpix][channel][bucket][range]) == NULL ) {
+            tmp.str("");
+            tmp << "cntrlFpga(0):kpixAsic(" << dec << kpix << "):SerialNumber";
+            item = new FitItem(kpix,channel,bucket,range,out->dataRead->getConfig(tmp.str()),data);
+            out->fitItem[kpix][channel][bucket][range] = item;
+         }
+
+         if ( calib ? !item->calibDone : !item->baseDone ) list->push_back(item);
+      }
+   }
+}
+
+// Fit a list of items on the pool and write them in order
+void runStage ( vector<FitItem *> *list, bool calib, FitOutput *out ) {
+   FitItem *item;
+
+   if ( list->empty() ) return;
+
+   out->pool->start(list,calib);
+   while ( (item = out->pool->next()) != NULL ) {
+      if ( calib ) writeCalib(item,out);
+      else writeBase(item,out);
+   }
+   out->pool->stop();
+}
+
 // Process the data
 int main ( int argc, char **argv ) {
    DataRead               dataRead;
@@ -189,14 +1156,18 @@ int main ( int argc, char **argv ) {
    string                 calState;
    uint                   calChannel;
    uint                   calDac;
+   string                 lastState;
+   uint                   lastChannel;
+   uint                   lastDac;
    uint                   lastPct;
    uint                   currPct;
    bool                   chanFound[32][1024];
    ChannelData            *chanData[32][1024][4][2];
+   ChannelData            *data;
+   FitItem                *fitItem[32][1024][4][2];
    bool                   badMean[32][1024];
    bool                   badGain[32][1024];
    bool                   kpixFound[32];
-   uint                   kpixMax;
    uint                   minDac;
    uint                   minChan;
    uint                   maxChan;
@@ -209,20 +1180,9 @@ int main ( int argc, char **argv ) {
    uint                   tstamp;
    string                 serial;
    KpixSample::SampleType type;
-   TH1F                   *hist;
    stringstream           tmp;
    ofstream               xml;
    ofstream               csv;
-   double                 grX[256];
-   double                 grY[256];
-   double                 grYErr[256];
-   double                 grXErr[256];
-   double                 grRes[256];
-   uint                   grCount;
-   TGraphErrors           *grCalib;
-   TGraph                 *grResid;
-   bool                   positive;
-   bool                   b0CalibHigh;
    uint                   injectTime[5];
    uint                   eventCount;
    string                 outRoot;
@@ -233,37 +1193,18 @@ int main ( int argc, char **argv ) {
    char                   tstr[200];
    struct tm              *timeinfo;
    time_t                 tme;
-   uint                   crChan;
-   stringstream           crossString;
-   stringstream           crossStringCsv;
-   double                 crossDiff;
    uint                   badValue;
    XmlVariables           config;
-   bool                   findBadMeanHist;
-   bool                   findBadMeanFit;
-   bool                   findBadMeanChisq;
-   bool                   findBadGainFit;
-   bool                   findBadGainChisq;
-   double                 meanMin[2];
-   double                 meanMax[2];
-   double                 meanChisq;
-   double                 gainMin[2];
-   double                 gainMax[2];
    double                 chargeError[2];
-   double                 gainChisq;
-   double                 fitMin[2];
-   double                 fitMax[2];
-   double                 chisqNdf;
    ofstream               debug;
    uint                   badTimes;
-   uint                   badMeanFitCnt;
-   uint                   badMeanHistCnt;
-   uint                   badMeanChisqCnt;
-   uint                   badGainFitCnt;
-   uint                   badGainChisqCnt;
-   uint                   failedGainFit;
-   uint                   failedMeanFit;
    uint                   badChannelCnt;
+   uint                   lateCount;
+   uint                   fitThreads;
+   bool                   streamFit;
+   FitSettings            fitSettings;
+   FitOutput              fitOutput;
+   vector<FitItem *>      fitList;
 
    // Init structure
    for (kpix=0; kpix < 32; kpix++) {
@@ -271,6 +1212,8 @@ int main ( int argc, char **argv ) {
          for (bucket=0; bucket < 4; bucket++) {
             chanData[kpix][channel][bucket][0] = NULL;
             chanData[kpix][channel][bucket][1] = NULL;
+            fitItem[kpix][channel][bucket][0]  = NULL;
+            fitItem[kpix][channel][bucket][1]  = NULL;
          }
          chanFound[kpix][channel] = false;
          badGain[kpix][channel] = false;
@@ -294,27 +1237,59 @@ int main ( int argc, char **argv ) {
    }
 
    // Extract configuration values
-   findBadMeanHist  = config.getInt("FindBadMeanHist");
-   findBadMeanFit   = config.getInt("FindBadMeanFit");
-   meanMin[0]       = config.getDouble("GoodMeanMinR0");
-   meanMax[0]       = config.getDouble("GoodMeanMaxR0");
-   meanMin[1]       = config.getDouble("GoodMeanMinR1");
-   meanMax[1]       = config.getDouble("GoodMeanMaxR1");
-   findBadMeanChisq = config.getInt("FindBadMeanChisq");
-   meanChisq        = config.getInt("GoodMeanChisqMax");
-   findBadGainFit   = config.getInt("FindBadGainFit");
-   gainMin[0]       = config.getDouble("GoodGainMinR0");
-   gainMax[0]       = config.getDouble("GoodGainMaxR0");
-   gainMin[1]       = config.getDouble("GoodGainMinR1");
-   gainMax[1]       = config.getDouble("GoodGainMaxR1");
-   findBadGainChisq = config.getInt("FindBadGainChisq");
-   gainChisq        = config.getInt("GoodGainChisqMax");
-   fitMin[0]        = config.getDouble("GainFitMinR0");
-   fitMax[0]        = config.getDouble("GainFitMaxR0");
-   fitMin[1]        = config.getDouble("GainFitMinR1");
-   fitMax[1]        = config.getDouble("GainFitMaxR1");
-   chargeError[0]   = config.getDouble("GainChargeErrorR0");
-   chargeError[1]   = config.getDouble("GainChargeErrorR1");
+   fitOutput.findBadMeanHist  = config.getInt("FindBadMeanHist");
+   fitOutput.findBadMeanFit   = config.getInt("FindBadMeanFit");
+   fitSettings.meanMin[0]     = config.getDouble("GoodMeanMinR0");
+   fitSettings.meanMax[0]     = config.getDouble("GoodMeanMaxR0");
+   fitSettings.meanMin[1]     = config.getDouble("GoodMeanMinR1");
+   fitSettings.meanMax[1]     = config.getDouble("GoodMeanMaxR1");
+   fitOutput.findBadMeanChisq = config.getInt("FindBadMeanChisq");
+   fitOutput.meanChisq        = config.getInt("GoodMeanChisqMax");
+   fitOutput.findBadGainFit   = config.getInt("FindBadGainFit");
+   fitSettings.gainMin[0]     = config.getDouble("GoodGainMinR0");
+   fitSettings.gainMax[0]     = config.getDouble("GoodGainMaxR0");
+   fitSettings.gainMin[1]     = config.getDouble("GoodGainMinR1");
+   fitSettings.gainMax[1]     = config.getDouble("GoodGainMaxR1");
+   fitOutput.findBadGainChisq = config.getInt("FindBadGainChisq");
+   fitOutput.gainChisq        = config.getInt("GoodGainChisqMax");
+   fitSettings.fitMin[0]      = config.getDouble("GainFitMinR0");
+   fitSettings.fitMax[0]      = config.getDouble("GainFitMaxR0");
+   fitSettings.fitMin[1]      = config.getDouble("GainFitMinR1");
+   fitSettings.fitMax[1]      = config.getDouble("GainFitMaxR1");
+   chargeError[0]             = config.getDouble("GainChargeErrorR0");
+   chargeError[1]             = config.getDouble("GainChargeErrorR1");
+   fitThreads                 = config.getInt("FitThreads");
+   fitSettings.fastFit        = config.getInt("FastFit");
+   fitSettings.fastVerify     = config.getInt("FastFitVerify");
+   fitSettings.fastMaxChisq   = config.getDouble("FastFitChisqMax");
+   streamFit                  = config.getInt("StreamFit");
+
+   // Fit threads require a thread safe root, a reentrant minimizer and
+   // histograms which are not attached to the current directory. Serial
+   // fits keep the default minimizer.
+   if ( fitThreads > 0 ) {
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+      ROOT::EnableThreadSafety();
+      ROOT::Math::MinimizerOptions::SetDefaultMinimizer("Minuit2");
+      TH1::AddDirectory(kFALSE);
+#else
+      cout << "FitThreads requires root 6 or later, fitting in main thread" << endl;
+      fitThreads = 0;
+#endif
+   }
+
+   // Fit settings and output state
+   fitSettings.chanData       = chanData;
+   fitSettings.chargeError[0] = chargeError[0];
+   fitSettings.chargeError[1] = chargeError[1];
+   fitOutput.pool             = new FitPool(fitThreads,&fitSettings);
+   fitOutput.set              = &fitSettings;
+   fitOutput.dataRead         = &dataRead;
+   fitOutput.debug            = &debug;
+   fitOutput.chanData         = chanData;
+   fitOutput.fitItem          = fitItem;
+   fitOutput.badMean          = badMean;
+   fitOutput.badGain          = badGain;
 
    // Open data file
    if ( ! dataRead.open(argv[2]) ) {
@@ -333,6 +1308,16 @@ int main ( int argc, char **argv ) {
    tmp << argv[2] << ".csv";
    outCsv = tmp.str();
 
+   // Plots are written while reading in streaming mode
+   gStyle->SetOptFit(1111);
+   gStyle->SetOptStat(111111111);
+
+   // Default canvas
+   c1 = new TCanvas("c1","c1");
+
+   // Open root file
+   rFile = new TFile(outRoot.c_str(),"recreate");
+
    //////////////////////////////////////////
    // Read Data
    //////////////////////////////////////////
@@ -347,14 +1332,11 @@ int main ( int argc, char **argv ) {
    minChan          = 0;
    maxChan          = 0;
    badTimes         = 0;
-   badMeanFitCnt    = 0;
-   badMeanHistCnt   = 0;
-   badMeanChisqCnt  = 0;
-   badGainFitCnt    = 0;
-   badGainChisqCnt  = 0;
-   failedGainFit    = 0;
-   failedMeanFit    = 0;
    badChannelCnt    = 0;
+   lateCount        = 0;
+   lastState        = "";
+   lastChannel      = 0;
+   lastDac          = 0;
 
    cout << "\rReading File: 0 %" << flush;
 
@@ -376,7 +1358,57 @@ int main ( int argc, char **argv ) {
          injectTime[2] = dataRead.getConfigInt("cntrlFpga:kpixAsic:Cal2Delay") + injectTime[1] + 4;
          injectTime[3] = dataRead.getConfigInt("cntrlFpga:kpixAsic:Cal3Delay") + injectTime[2] + 4;
          injectTime[4] = 8192;
+
+         // get calibration mode variables for charge computation
+         fitSettings.positive    = (dataRead.getConfig("cntrlFpga:kpixAsic:CntrlPolarity") == "Positive");
+         fitSettings.b0CalibHigh = (dataRead.getConfig("cntrlFpga:kpixAsic:CntrlCalibHigh") == "True");
+         fitOutput.maxChan       = maxChan;
+      }
+
+      // Streaming mode, fit baselines and channels as soon as their data is complete
+      if ( streamFit ) {
+
+         // Baselines are complete once injection starts
+         if ( calState == "Inject" && lastState == "Baseline" ) {
+            fitList.clear();
+            for (kpix=0; kpix<32; kpix++) {
+               if ( kpixFound[kpix] ) {
+                  for (channel=minChan; channel <= maxChan; channel++) 
+                     if ( chanFound[kpix][channel] ) addFitItems(&fitList,false,&fitOutput,kpix,channel);
+               }
+            }
+            runStage(&fitList,false,&fitOutput);
+         }
+
+         // Injection point is complete
+         if ( lastState == "Inject" && (calState != "Inject" || calChannel != lastChannel || calDac != lastDac) ) {
+            for (kpix=0; kpix<32; kpix++) {
+               for (bucket=0; bucket < 4; bucket++) {
+                  for (range=0; range < 2; range++) {
+                     if ( chanData[kpix][lastChannel][bucket][range] != NULL ) 
+                        chanData[kpix][lastChannel][bucket][range]->finalizePoint(lastDac,chargeError[range]);
+                  }
+               }
+            }
+         }
+
+         // Injection channel is complete
+         if ( lastState == "Inject" && (calState != "Inject" || calChannel != lastChannel) &&
+              lastChannel >= minChan && lastChannel <= maxChan ) {
+            fitList.clear();
+            for (kpix=0; kpix<32; kpix++) 
+               if ( chanFound[kpix][lastChannel] ) addFitItems(&fitList,false,&fitOutput,kpix,lastChannel);
+            runStage(&fitList,false,&fitOutput);
+
+            fitList.clear();
+            for (kpix=0; kpix<32; kpix++) 
+               if ( chanFound[kpix][lastChannel] ) addFitItems(&fitList,true,&fitOutput,kpix,lastChannel);
+            runStage(&fitList,true,&fitOutput);
+         }
       }
+      lastState   = calState;
+      lastChannel = calChannel;
+      lastDac     = calDac;
 
       // get each sample
       for (x=0; x < event.count(); x++) {
@@ -412,7 +1444,8 @@ int main ( int argc, char **argv ) {
                else if ( calState == "Inject" && calDac != minDac ) {
                   if ( channel == calChannel ) chanData[kpix][channel][bucket][range]->addCalibPoint(calDac, value);
                   else if ( chanData[kpix][calChannel][bucket][range] != NULL ) 
-                     chanData[kpix][calChannel][bucket][range]->addNeighborPoint(channel, calDac, value);
+                     chanData[kpix][calChannel][bucket][range]->addNeighborPoint(channel, calDac, value,
+                                                                                 chanData[kpix][channel][bucket][range]);
                }
             }
             else badTimes++;
@@ -431,16 +1464,34 @@ int main ( int argc, char **argv ) {
    cout << "\rReading File: Done.               " << endl;
 
    //////////////////////////////////////////
-   // Process Data
+   // Process Baselines 
    //////////////////////////////////////////
-   gStyle->SetOptFit(1111);
-   gStyle->SetOptStat(111111111);
+   fitList.clear();
+   for (kpix=0; kpix<32; kpix++) {
+      if ( kpixFound[kpix] ) {
+         for (channel=minChan; channel <= maxChan; channel++) 
+            if ( chanFound[kpix][channel] ) addFitItems(&fitList,false,&fitOutput,kpix,channel);
+      }
+   }
+   runStage(&fitList,false,&fitOutput);
+   cout << endl;
 
-   // Default canvas
-   c1 = new TCanvas("c1","c1");
+   //////////////////////////////////////////
+   // Process Calibration
+   //////////////////////////////////////////
+   fitList.clear();
+   for (kpix=0; kpix<32; kpix++) {
+      if ( kpixFound[kpix] ) {
+         for (channel=minChan; channel <= maxChan; channel++) 
+            if ( chanFound[kpix][channel] ) addFitItems(&fitList,true,&fitOutput,kpix,channel);
+      }
+   }
+   runStage(&fitList,true,&fitOutput);
+   cout << endl;
 
-   // Open root file
-   rFile = new TFile(outRoot.c_str(),"recreate");
+   //////////////////////////////////////////
+   // Write Results
+   //////////////////////////////////////////
 
    // Open xml file
    xml.open(outXml.c_str(),ios::out | ios::trunc);
@@ -475,129 +1526,6 @@ int main ( int argc, char **argv ) {
    xml << config.getXml();
    xml << "   </config>"<< endl;
 
-   // get calibration mode variables for charge computation
-   positive    = (dataRead.getConfig("cntrlFpga:kpixAsic:CntrlPolarity") == "Positive");
-   b0CalibHigh = (dataRead.getConfig("cntrlFpga:kpixAsic:CntrlCalibHigh") == "True");
-
-   // Kpix count;
-   for (kpix=0; kpix<32; kpix++) if ( kpixFound[kpix] ) kpixMax=kpix;
-
-   //////////////////////////////////////////
-   // Process Baselines 
-   //////////////////////////////////////////
-
-   // Process each kpix device
-   for (kpix=0; kpix<32; kpix++) {
-      if ( kpixFound[kpix] ) {
-
-         // Get serial number
-         tmp.str("");
-         tmp << "cntrlFpga(0):kpixAsic(" << dec << kpix << "):SerialNumber";
-         serial = dataRead.getConfig(tmp.str());
-
-         // Process each channel
-         for (channel=minChan; channel <= maxChan; channel++) {
-
-            // Show progress
-            cout << "\rProcessing baseline kpix " << dec << kpix << " / " << dec << kpixMax
-                 << ", Channel " << channel << " / " << dec << maxChan
-                 << "                 " << flush;
-
-            // Channel is valid
-            if ( chanFound[kpix][channel] ) {
-
-               // Each bucket
-               for (bucket = 0; bucket < 4; bucket++) {
-
-                  // Bucket is valid
-                  if ( chanData[kpix][channel][bucket][0] != NULL || chanData[kpix][channel][bucket][1] != NULL ) {
-
-                     // Each range
-                     for (range = 0; range < 2; range++) {
- 
-                        // Range is valid
-                        if ( chanData[kpix][channel][bucket][range] != NULL ) {
-                           chanData[kpix][channel][bucket][range]->computeBase();
-
-                           // Create histogram
-                           tmp.str("");
-                           tmp << "hist_" << serial << "_c" << dec << setw(4) << setfill('0') << channel;
-                           tmp << "_b" << dec << bucket;
-                           tmp << "_r" << dec << range;
-                           hist = new TH1F(tmp.str().c_str(),tmp.str().c_str(),8192,0,8192);
-
-                           // Fill histogram
-                           for (x=0; x < 8192; x++) hist->SetBinContent(x+1,chanData[kpix][channel][bucket][range]->baseData[x]);
-                           hist->GetXaxis()->SetRangeUser(chanData[kpix][channel][bucket][range]->baseMin,
-                                                          chanData[kpix][channel][bucket][range]->baseMax);
-                           hist->Fit("gaus","q");
-                           hist->Write();
-
-                           if ( hist->GetFunction("gaus") ) {
-                              chanData[kpix][channel][bucket][range]->baseFitMean      = hist->GetFunction("gaus")->GetParameter(1);
-                              chanData[kpix][channel][bucket][range]->baseFitSigma     = hist->GetFunction("gaus")->GetParameter(2);
-                              chanData[kpix][channel][bucket][range]->baseFitMeanErr   = hist->GetFunction("gaus")->GetParError(1);
-                              chanData[kpix][channel][bucket][range]->baseFitSigmaErr  = hist->GetFunction("gaus")->GetParError(2);
-
-                              if ( hist->GetFunction("gaus")->GetNDF() == 0 ) {
-                                 chanData[kpix][channel][bucket][range]->baseFitChisquare = 0;
-                              } else {
-                                 chanData[kpix][channel][bucket][range]->baseFitChisquare = 
-                                    (hist->GetFunction("gaus")->GetChisquare() / hist->GetFunction("gaus")->GetNDF() );
-                              }
-
-                              // Determine bad channel from fitted chisq
-                              if ( findBadMeanChisq && (chanData[kpix][channel][bucket][range]->baseFitChisquare >  meanChisq) ) {
-                                 debug << "Kpix=" << dec << kpix << " Channel=" << dec << channel << " Bucket=" << dec << bucket
-                                       << " Range=" << dec << range 
-                                       << " Bad fit mean chisq=" << chanData[kpix][channel][bucket][range]->baseFitChisquare << endl;
-                                 badMean[kpix][channel] = true;
-                                 badMeanChisqCnt++;
-                              }
-
-                              // Determine bad channel from fitted mean
-                              if ( findBadMeanFit &&
-                                    ( (chanData[kpix][channel][bucket][range]->baseFitMean > meanMax[range]) ||  
-                                      (chanData[kpix][channel][bucket][range]->baseFitMean < meanMin[range]) ) ) {
-                                 debug << "Kpix=" << dec << kpix << " Channel=" << dec << channel << " Bucket=" << dec << bucket
-                                       << " Range=" << dec << range 
-                                       << " Bad fit mean value=" << chanData[kpix][channel][bucket][range]->baseFitMean << endl;
-                                 badMean[kpix][channel] = true;
-                                 badMeanFitCnt++;
-                              }
-                           }
-                           else if ( findBadMeanFit || findBadMeanChisq ) {
-                              debug << "Kpix=" << dec << kpix << " Channel=" << dec << channel 
-                                    << " Bucket=" << dec << bucket << " Range=" << dec << range
-                                    << " Failed to fit mean" << endl;
-                              badMean[kpix][channel] = true;
-                              failedMeanFit++;
-                           }
-
-                           // Determine bad channel from histogram mean
-                           if ( findBadMeanHist && 
-                                 ( (chanData[kpix][channel][bucket][range]->baseMean > meanMax[range]) ||
-                                   (chanData[kpix][channel][bucket][range]->baseMean < meanMin[range]) ) ) {
-                              debug << "Kpix=" << dec << kpix << " Channel=" << dec << channel << " Bucket=" << dec << bucket
-                                    << " Range=" << dec << range
-                                    << " Bad hist mean value=" << chanData[kpix][channel][bucket][range]->baseMean << endl;
-                              badMeanHistCnt++;
-                              badMean[kpix][channel] = true;
-                           }
-                        }
-                     }
-                  }
-               }
-            }
-         }
-      }
-   }
-   cout << endl;
-
-   //////////////////////////////////////////
-   // Process Calibration
-   //////////////////////////////////////////
-
    // Process each kpix device
    for (kpix=0; kpix<32; kpix++) {
       if ( kpixFound[kpix] ) {
@@ -611,11 +1539,6 @@ int main ( int argc, char **argv ) {
          // Process each channel
          for (channel=minChan; channel <= maxChan; channel++) {
 
-            // Show progress
-            cout << "\rProcessing calibration kpix " << dec << kpix << " / " << dec << kpixMax
-                 << ", Channel " << channel << " / " << dec << maxChan 
-                 << "                 " << flush;
-
             // Channel is valid
             if ( chanFound[kpix][channel] ) {
 
@@ -634,156 +1557,18 @@ int main ( int argc, char **argv ) {
  
                         // Range is valid
                         if ( chanData[kpix][channel][bucket][range] != NULL ) {
-                           xml << "            <Range id=\"" << range << "\">" << endl;
-                           chanData[kpix][channel][bucket][range]->computeCalib(chargeError[range]);
-                           csv << serial << "," << dec << channel << "," << dec << bucket << "," << dec << range;
-
-                           // Add baseline data to xml
-                           addDoubleToXml(&xml,15,"BaseMean",chanData[kpix][channel][bucket][range]->baseMean);
-                           addDoubleToXml(&xml,15,"BaseRms",chanData[kpix][channel][bucket][range]->baseRms);
-                           if ( chanData[kpix][channel][bucket][range]->baseFitMean != 0 ) {
-                              addDoubleToXml(&xml,15,"BaseFitMean",chanData[kpix][channel][bucket][range]->baseFitMean);
-                              addDoubleToXml(&xml,15,"BaseFitSigma",chanData[kpix][channel][bucket][range]->baseFitSigma);
-                              addDoubleToXml(&xml,15,"BaseFitMeanErr",chanData[kpix][channel][bucket][range]->baseFitMeanErr);
-                              addDoubleToXml(&xml,15,"BaseFitSigmaErr",chanData[kpix][channel][bucket][range]->baseFitSigmaErr);
-                              addDoubleToXml(&xml,15,"BaseFitChisquare",chanData[kpix][channel][bucket][range]->baseFitChisquare);
-                           }
-
-                           // Add baseline data to excel file
-                           csv << "," << chanData[kpix][channel][bucket][range]->baseMean;
-                           csv << "," << chanData[kpix][channel][bucket][range]->baseRms;
-                           csv << "," << chanData[kpix][channel][bucket][range]->baseFitMean;
-                           csv << "," << chanData[kpix][channel][bucket][range]->baseFitSigma;
-                           csv << "," << chanData[kpix][channel][bucket][range]->baseFitMeanErr;
-                           csv << "," << chanData[kpix][channel][bucket][range]->baseFitSigmaErr;
-                           csv << "," << chanData[kpix][channel][bucket][range]->baseFitChisquare;
-
-                           // Create calibration graph
-                           grCount = 0;
-                           crossString.str("");
-                           crossStringCsv.str("");
-                           for (x=0; x < 256; x++) {
-                           
-                              // Calibration point is valid
-                              if ( chanData[kpix][channel][bucket][range]->calibCount[x] > 0 ) {
-                                 grX[grCount]    = calibCharge ( x, positive, ((bucket==0)?b0CalibHigh:false));
-                                 grY[grCount]    = chanData[kpix][channel][bucket][range]->calibMean[x];
-                                 grYErr[grCount] = chanData[kpix][channel][bucket][range]->calibError[x];
-                                 grXErr[grCount] = 0;
-
-#if 0
-                                 debug << "Kpix=" << dec << kpix << " Channel=" << dec << channel << " Bucket=" << dec << bucket
-                                       << " Range=" << dec << range
-                                       << " Adding point x=" << grX[grCount] 
-                                       << " Rms=" << chanData[kpix][channel][bucket][range]->calibRms[x]
-                                       << " Error=" << chanData[kpix][channel][bucket][range]->calibError[x] << endl;
-#endif
-                                 grCount++;
-
-                                 // Find crosstalk, value - base > 3 * sigma
-                                 for (crChan=0; crChan < 1024; crChan++ ) {
-
-                                    if ( chanData[kpix][crChan][bucket][range] != NULL ) {
-
-                                       crossDiff = chanData[kpix][channel][bucket][range]->calibOtherValue[crChan] - 
-                                                   chanData[kpix][crChan][bucket][range]->baseMean;
-
-                                       if ( (chanData[kpix][channel][bucket][range]->calibOtherDac[crChan] == x)  && 
-                                            (crChan != channel) && 
-                                            (chanData[kpix][channel][bucket][range] != NULL ) &&
-                                            (crossDiff > (10.0 * chanData[kpix][crChan][bucket][range]->baseRms))) {
-
-                                          if ( crossString.str() != "" ) crossString << " ";
-                                          crossString << dec << crChan << ":" << dec << (uint)crossDiff;
-                                          crossStringCsv << "," << dec << crChan << "," << dec << (uint)crossDiff;
-                                       }
-                                    }
-                                 }
-                              }
-                           }
+                           xml << fitItem[kpix][channel][bucket][range]->xmlText;
+                           csv << fitItem[kpix][channel][bucket][range]->csvText;
 
-                           // Create graph
-                           if ( grCount > 0 ) {
-                              grCalib = new TGraphErrors(grCount,grX,grY,grXErr,grYErr);
-                              grCalib->Draw("Ap");
-                              grCalib->Fit("pol1","eq","",fitMin[range],fitMax[range]);
-                              grCalib->GetFunction("pol1")->SetLineWidth(1);
-
-                              // Create name and write
-                              tmp.str("");
-                              tmp << "calib_" << serial << "_c" << dec << setw(4) << setfill('0') << channel;
-                              tmp << "_b" << dec << bucket;
-                              tmp << "_r" << dec << range;
-                              grCalib->SetTitle(tmp.str().c_str());
-                              grCalib->Write(tmp.str().c_str());
-
-                              // Create and store residual plot
-                              for (x=0; x < grCount; x++) grRes[x] = (grY[x] - grCalib->GetFunction("pol1")->Eval(grX[x]));
-                              grResid = new TGraph(grCount,grX,grRes);
-                              grResid->Draw("Ap");
-
-                              // Create name and write
-                              tmp.str("");
-                              tmp << "resid_" << serial << "_c" << dec << setw(4) << setfill('0') << channel;
-                              tmp << "_b" << dec << bucket;
-                              tmp << "_r" << dec << range;
-                              grResid->SetTitle(tmp.str().c_str());
-                              grResid->Write(tmp.str().c_str());
-
-                              // Add to xml
-                              if ( grCalib->GetFunction("pol1") ) {
-                                 chisqNdf = (grCalib->GetFunction("pol1")->GetChisquare() / grCalib->GetFunction("pol1")->GetNDF());
-
-                                 addDoubleToXml(&xml,15,"CalibGain",grCalib->GetFunction("pol1")->GetParameter(1));
-                                 addDoubleToXml(&xml,15,"CalibIntercept",grCalib->GetFunction("pol1")->GetParameter(0));
-                                 addDoubleToXml(&xml,15,"CalibGainErr",grCalib->GetFunction("pol1")->GetParError(1));
-                                 addDoubleToXml(&xml,15,"CalibInterceptErr",grCalib->GetFunction("pol1")->GetParError(0));
-                                 addDoubleToXml(&xml,15,"CalibChisquare",chisqNdf);
-                                 csv << "," << grCalib->GetFunction("pol1")->GetParameter(1);
-                                 csv << "," << grCalib->GetFunction("pol1")->GetParameter(0);
-                                 csv << "," << grCalib->GetFunction("pol1")->GetParError(1);
-                                 csv << "," << grCalib->GetFunction("pol1")->GetParError(0);
-                                 csv << "," << chisqNdf;
-
-                                 // Determine bad channel from fitted gain
-                                 if ( findBadGainFit && 
-                                       ( (grCalib->GetFunction("pol1")->GetParameter(1) > gainMax[range]) ||
-                                         (grCalib->GetFunction("pol1")->GetParameter(1) < gainMin[range]) ) ) {
-                                    debug << "Kpix=" << dec << kpix << " Channel=" << dec << channel << " Bucket=" << dec << bucket
-                                          << " Range=" << dec << range
-                                          << " Bad gain value=" << grCalib->GetFunction("pol1")->GetParameter(1) << endl;
-                                    badGain[kpix][channel] = true;
-                                    badGainFitCnt++;
-                                 }
-
-                                 // Determine bad channel from fitted chisq
-                                 if ( findBadGainChisq && (chisqNdf >  gainChisq) ) {
-                                    debug << "Kpix=" << dec << kpix << " Channel=" << dec << channel << " Bucket=" << dec << bucket
-                                          << " Range=" << dec << range
-                                          << " Bad gain chisq=" << gainChisq << endl;
-                                    badGain[kpix][channel] = true;
-                                    badGainChisqCnt++;
-                                 }
-                              }
-                              else {
-                                 csv << ",0,0,0,0,0";
-                                 if ( findBadGainFit || findBadGainChisq ) {
-                                    debug << "Kpix=" << dec << kpix << " Channel=" << dec << channel << " Bucket=" << dec << bucket
-                                          << " Range=" << dec << range
-                                          << " Failed to fit gain" << endl;
-                                    badGain[kpix][channel] = true;
-                                    failedGainFit++;
-                                 }
-                              }
-
-                              addDoubleToXml(&xml,15,"CalibGainRms",grCalib->GetRMS(2));
-                              csv << "," << grCalib->GetRMS(2);
-
-                              if ( crossString.str() != "" ) addStringToXml(&xml,15,"CalibCrossTalk",crossString.str());
-                              csv << crossStringCsv.str();
+                           // Samples which arrived after a streaming fit
+                           data = chanData[kpix][channel][bucket][range];
+                           if ( data->baseLate > 0 || data->calibLate > 0 ) {
+                              debug << "Kpix=" << dec << kpix << " Channel=" << dec << channel 
+                                    << " Bucket=" << dec << bucket << " Range=" << dec << range
+                                    << " Dropped " << dec << data->baseLate << " baseline and "
+                                    << dec << data->calibLate << " calibration samples after fit" << endl;
+                              lateCount += data->baseLate + data->calibLate;
                            }
-                           csv << endl; 
-                           xml << "            </Range>" << endl;
                         }
                      }
                      xml << "         </Bucket>" << endl;
@@ -809,21 +1594,38 @@ int main ( int argc, char **argv ) {
          xml << "   </kpixAsic>" << endl;
       }
    }
-   cout << endl;
    cout << "Wrote root plots to " << outRoot << endl;
    cout << "Wrote xml data to " << outXml << endl;
    cout << "Wrote csv data to " << outCsv << endl;
    cout << endl;
 
-   cout << "Found " << dec << setw(10) << setfill(' ') << badTimes        << " events with bad times" << endl;
-   cout << "Found " << dec << setw(10) << setfill(' ') << badMeanFitCnt   << " bad mean fit values" << endl;
-   cout << "Found " << dec << setw(10) << setfill(' ') << badMeanChisqCnt << " bad mean fit chisq"  << endl;
-   cout << "Found " << dec << setw(10) << setfill(' ') << badMeanHistCnt  << " bad mean hist values" << endl;
-   cout << "Found " << dec << setw(10) << setfill(' ') << failedMeanFit   << " failed mean fits" << endl;
-   cout << "Found " << dec << setw(10) << setfill(' ') << badGainFitCnt   << " bad gain fit values" << endl;
-   cout << "Found " << dec << setw(10) << setfill(' ') << badGainChisqCnt << " bad gain fit chisq" << endl;
-   cout << "Found " << dec << setw(10) << setfill(' ') << failedGainFit   << " failed gain fits" << endl;
-   cout << "Found " << dec << setw(10) << setfill(' ') << badChannelCnt   << " bad channels" << endl;
+   cout << "Found " << dec << setw(10) << setfill(' ') << badTimes                  << " events with bad times" << endl;
+   cout << "Found " << dec << setw(10) << setfill(' ') << fitOutput.badMeanFitCnt   << " bad mean fit values" << endl;
+   cout << "Found " << dec << setw(10) << setfill(' ') << fitOutput.badMeanChisqCnt << " bad mean fit chisq"  << endl;
+   cout << "Found " << dec << setw(10) << setfill(' ') << fitOutput.badMeanHistCnt  << " bad mean hist values" << endl;
+   cout << "Found " << dec << setw(10) << setfill(' ') << fitOutput.failedMeanFit   << " failed mean fits" << endl;
+   cout << "Found " << dec << setw(10) << setfill(' ') << fitOutput.badGainFitCnt   << " bad gain fit values" << endl;
+   cout << "Found " << dec << setw(10) << setfill(' ') << fitOutput.badGainChisqCnt << " bad gain fit chisq" << endl;
+   cout << "Found " << dec << setw(10) << setfill(' ') << fitOutput.failedGainFit   << " failed gain fits" << endl;
+   cout << "Found " << dec << setw(10) << setfill(' ') << badChannelCnt             << " bad channels" << endl;
+
+   if ( lateCount > 0 ) {
+      cout << endl;
+      cout << "Warning: dropped " << dec << lateCount << " samples which arrived after their channel was fit." << endl;
+      cout << "Warning: see debug output for channels, run with StreamFit=0 to fit every sample." << endl;
+   }
+
+   if ( fitSettings.fastFit ) {
+      cout << endl;
+      cout << "Used  " << dec << setw(10) << setfill(' ') << fitOutput.fastMeanCnt << " fast mean fits" << endl;
+      cout << "Used  " << dec << setw(10) << setfill(' ') << fitOutput.fastGainCnt << " fast gain fits" << endl;
+      if ( fitSettings.fastVerify ) {
+         cout << "Max fast fit mean diff      = " << fitOutput.maxDiffMean      << endl;
+         cout << "Max fast fit sigma diff     = " << fitOutput.maxDiffSigma     << endl;
+         cout << "Max fast fit gain diff      = " << fitOutput.maxDiffGain      << endl;
+         cout << "Max fast fit intercept diff = " << fitOutput.maxDiffIntercept << endl;
+      }
+   }
 
    xml << "</calibrationData>" << endl;
    xml.close();
@@ -833,14 +1635,16 @@ int main ( int argc, char **argv ) {
    for (kpix=0; kpix < 32; kpix++) {
       for (channel=0; channel < 1024; channel++) {
          for (bucket=0; bucket < 4; bucket++) {
-            if ( chanData[kpix][channel][bucket][0] != NULL ) delete chanData[kpix][channel][bucket][0];
-            if ( chanData[kpix][channel][bucket][1] != NULL ) delete chanData[kpix][channel][bucket][1];
+            for (range=0; range < 2; range++) {
+               if ( chanData[kpix][channel][bucket][range] != NULL ) delete chanData[kpix][channel][bucket][range];
+               if ( fitItem[kpix][channel][bucket][range]  != NULL ) delete fitItem[kpix][channel][bucket][range];
+            }
          }
       }
    }
 
    // Close file
+   delete fitOutput.pool;
    dataRead.close();
    return(0);
 }
-
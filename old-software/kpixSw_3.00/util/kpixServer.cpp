@@ -17,12 +17,23 @@
 #include <KpixControl.h>
 #include <ControlServer.h>
 #include <Device.h>
+#include <DataSharedMem.h>
+#include <KpixSharedRing.h>
 #include <iomanip>
 #include <fstream>
 #include <iostream>
 #include <signal.h>
+#include <pthread.h>
+#include <time.h>
 using namespace std;
 
+// Consumer ring size
+#define RING_SIZE (64*1024*1024)
+
+// Longest wait for a stalled lossless consumer in milliseconds, the server
+// shared memory keeps filling while the relay waits
+#define RING_WAIT 10
+
 // Run flag for sig catch
 bool stop;
 
@@ -32,10 +43,66 @@ void sigTerm (int) {
    stop = true; 
 }
 
+// Copy records from the server shared memory into the consumer ring, data
+// records wake the kpix run thread
+void *relayRun (void *arg) {
+   KpixControl      *kpix;
+   DataSharedMemory *smem;
+   KpixSharedRing   ring;
+   uint8_t          *data;
+   uint32_t         flag;
+   uint32_t         rdAddr;
+   uint32_t         rdCount;
+   uint64_t         overruns;
+   time_t           curr;
+   time_t           last;
+
+   if ( dataSharedOpenAndMap ( &smem, "kpix" , 1 ) < 0 ) {
+      cout << "Relay failed to open shared memory" << endl;
+      return(NULL);
+   }
+
+   try {
+      ring.create("kpix",1,RING_SIZE);
+   } catch ( string error ) {
+      cout << error << endl;
+      return(NULL);
+   }
+
+   kpix     = (KpixControl *)arg;
+   rdAddr   = 0;
+   rdCount  = 0;
+   overruns = 0;
+   time(&last);
+   while ( ! stop ) {
+
+      // Low 28 bits of flag hold the record size in bytes, upper 4 bits
+      // the record type, data is type 0
+      if ( dataSharedRead(smem,&rdAddr,&rdCount,&flag,&data) ) {
+         if ( ((flag >> 28) & 0xF) == 0 ) kpix->dataReceived();
+         ring.write(flag,data,flag & 0x0FFFFFFF,RING_WAIT);
+      }
+      else usleep(100);
+
+      // Report records lost by stalled lossless consumers once a second
+      time(&curr);
+      if ( curr != last ) {
+         if ( ring.overruns() != overruns ) {
+            cout << "Relay overwrote " << dec << (ring.overruns() - overruns)
+                 << " records not yet read by stalled lossless consumers" << endl;
+            overruns = ring.overruns();
+         }
+         last = curr;
+      }
+   }
+   return(NULL);
+}
+
 int main (int argc, char **argv) {
    ControlServer cntrlServer;
    string        defFile;
    int           port;
+   pthread_t     relay;
 
    if ( argc > 1 ) defFile = argv[1];
    else defFile = "";
@@ -60,6 +127,7 @@ int main (int argc, char **argv) {
       // Setup control server
       //cntrlServer.setDebug(true);
       cntrlServer.enableSharedMemory("kpix",1);
+      pthread_create(&relay,NULL,relayRun,&kpix);
       port = cntrlServer.startListen(0);
       cntrlServer.setSystem(&kpix);
       cout << "Control id = 1" << endl;
@@ -67,6 +135,7 @@ int main (int argc, char **argv) {
       cout << "Starting server at port " << dec << port << endl;
       while ( ! stop ) cntrlServer.receive(100);
       cntrlServer.stopListen();
+      pthread_join(relay,NULL);
       cout << "Stopped server" << endl;
 
    } catch ( string error ) {
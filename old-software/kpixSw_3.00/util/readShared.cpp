@@ -16,22 +16,23 @@
 #include <KpixEvent.h>
 #include <KpixSample.h>
 #include <KpixCalibRead.h>
+#include <KpixSharedRing.h>
 #include <iomanip>
 #include <fstream>
 #include <iostream>
 #include <Data.h>
-#include <DataRead.h>
 using namespace std;
 
 int main (int argc, char **argv) {
-   DataRead      dataRead;
+   KpixSharedRing       ring;
+   KpixSharedRing::Mode mode;
    KpixEvent     event;
    KpixSample    *sample;
    uint          x;
    uint          count;
-   stringstream  tmp;
-   string        serialList[32];
-   string        serial;
+   uint          flag;
+   uint          size;
+   uint8_t       *data;
    uint          sampleCnt[9];
    uint          minTime[9];
    uint          maxTime[9];
@@ -40,21 +41,24 @@ int main (int argc, char **argv) {
    uint          chan;
    uint          buck;
    uint          range;
-   int           uid;
    time_t        curr, last;
 
    // Check args
-   if ( argc < 1 ) {
-      cout << "Usage: readShared [uid]" << endl;
+   if ( argc > 2 || (argc == 2 && string(argv[1]) != "-l") ) {
+      cout << "Usage: readShared [-l]" << endl;
+      cout << "   -l : lossless, server waits for this reader" << endl;
       return(1);
    }
 
-   if ( argc == 2 ) uid = atoi(argv[1]);
-   else uid = -1;
+   if ( argc == 2 ) mode = KpixSharedRing::Lossless;
+   else mode = KpixSharedRing::Lossy;
 
-   cout << "Id=" << dec << uid << endl;
-
-   dataRead.openShared("kpix",1,uid);
+   try {
+      ring.attach("kpix",1,mode);
+   } catch ( string error ) {
+      cout << error << endl;
+      return(1);
+   }
 
    // Process each event
    time(&curr);
@@ -72,7 +76,7 @@ int main (int argc, char **argv) {
 
       time(&curr);
       if ( last != curr ) {
-         cout << "Got " << dec << setw(4) << count << " events, ";
+         cout << "Got " << dec << setw(4) << count << " events, " << ring.drops() << " dropped, ";
 
          for (x=0; x < 9; x++) cout << dec << setw(12) << setfill(' ') << sampleCnt[x];
          cout << endl;
@@ -101,20 +105,9 @@ int main (int argc, char **argv) {
          }
       }
 
-      if ( dataRead.next(&event) ) {
-
-         //if ( dataRead.sawRunStop()  ) dataRead.dumpRunStop();
-         //if ( dataRead.sawRunStart() ) dataRead.dumpRunStart();
-         //if ( dataRead.sawRunTime()  ) dataRead.dumpRunTime();
-
-         // Extract kpix serial numbers after reading first event
-         if ( count == 0 ) {
-            for (x=0; x < 32; x++) {
-               tmp.str("");
-               tmp << "cntrlFpga(0):kpixAsic(" << dec << x << "):SerialNumber";
-               serialList[x] = dataRead.getConfig(tmp.str());
-            }
-         }
+      // Wait up to 100ms for a record, only raw data records (type 0) are processed
+      if ( ring.read(&flag,&data,&size,100) && ((flag >> 28) & 0xF) == 0 ) {
+         event.copy((uint *)data,size/4);
 
          for (x=0; x < event.count(); x++) {
             sample = event.sample(x);
@@ -133,7 +126,6 @@ int main (int argc, char **argv) {
 
          count++;
       }
-      else usleep(100);
    }
 
    return(0);
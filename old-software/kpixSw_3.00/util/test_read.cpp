@@ -1,11 +1,11 @@
-#include "DataSharedMem.h"
+#include "KpixSharedRing.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <time.h>
 #include <string.h>
 
 int main ( int argc, char **argv ) {
-   DataSharedMemory *smem;
+   KpixSharedRing ring;
    uint8_t * data;
    uint32_t  size;
    uint32_t  flag;
@@ -13,10 +13,11 @@ int main ( int argc, char **argv ) {
    time_t    curr;
    time_t    last;
    uint32_t  count;
-   uint32_t  rdCount;
-   uint32_t  rdAddr;
 
-   if ( dataSharedOpenAndMap ( &smem, "kpix" , 1 ) < 0 ) {
+   try {
+      if ( argc > 1 && strcmp(argv[1],"-l") == 0 ) ring.attach("kpix",1,KpixSharedRing::Lossless);
+      else ring.attach("kpix",1,KpixSharedRing::Lossy);
+   } catch ( string error ) {
       printf("Failed to open shared memory\n");
       return(-1);
    }
@@ -27,14 +28,13 @@ int main ( int argc, char **argv ) {
    firstFlag = 0;
 
    while (1) {
-      if ( dataSharedRead(smem,&rdAddr,&rdCount,&flag,&data) ) {
+      if ( ring.read(&flag,&data,&size,100) ) {
          count++;
          if ( firstFlag == 0 ) firstFlag = flag;
       }
-      usleep(100);
       time(&curr);
       if ( curr != last ) {
-         printf("Got %i frames. Flag diff=%i\n",count,(flag-firstFlag));
+         printf("Got %i frames. Flag diff=%i, dropped=%llu\n",count,(flag-firstFlag),(unsigned long long)ring.drops());
          last = curr;
       }
    }
@@ -1,11 +1,12 @@
-#include "DataSharedMem.h"
+#include "KpixSharedRing.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <time.h>
 #include <string.h>
+#include <unistd.h>
 
 int main ( int argc, char **argv ) {
-   DataSharedMemory *smem;
+   KpixSharedRing ring;
    uint8_t * data;
    uint32_t  size;
    uint32_t  flag;
@@ -17,11 +18,12 @@ int main ( int argc, char **argv ) {
    data  = (uint8_t *)malloc(1024*1024);
    flag  = 0;
 
-   if ( dataSharedOpenAndMap ( &smem, "kpix" , 1 ) < 0 ) {
+   try {
+      ring.create("kpix",1,64*1024*1024);
+   } catch ( string error ) {
       printf("Failed to open shared memory\n");
       return(-1);
    }
-   dataSharedInit(smem);
 
    time(&curr);
    last = curr;
@@ -29,12 +31,12 @@ int main ( int argc, char **argv ) {
 
    while (1) {
       flag = size & 0x0FFFFFFF;
-      dataSharedWrite(smem,flag,data,size);
+      ring.write(flag,data,size);
       usleep(10000);
       time(&curr);
       count ++;
       if ( curr != last ) {
-         printf("Send %i frames\n",count);
+         printf("Send %i frames, %i readers\n",count,ring.consumerCount());
          last = curr;
          count = 0;
       }